@@ -0,0 +1,61 @@
+#ifndef BIGNUM_COUNT_ALLOCATIONS
+#define BIGNUM_COUNT_ALLOCATIONS
+#endif
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "../common/bignum.h"
+using namespace std;
+
+// Heap allocations across a warm MontContext::powInto: once the first call
+// has grown the thread's scratch arena, repeating it on the same modulus must
+// allocate nothing, on every kernel (fixed-width, vector, NTT, montMul). The
+// global operator new is counted (scratch_arena.h); the exit status is 1 if
+// any call allocated.
+//   g++ -O2 -std=c++17 -DBIGNUM_COUNT_ALLOCATIONS bench/allocations.cpp -o bench_allocations
+//   ./bench_allocations
+
+BigNum randomBits(int bits, mt19937_64 &rng)
+{
+    vector<limb_t> limbs((bits + 31) / 32);
+    for (limb_t &l : limbs)
+        l = (limb_t)rng();
+    if (bits % 32)
+        limbs.back() &= (limb_t(1) << (bits % 32)) - 1;
+    limbs.back() |= limb_t(1) << ((bits - 1) % 32);
+    return BigNum::fromLimbs(limbs.data(), limbs.size());
+}
+
+int main()
+{
+    const int CALLS = 8;
+    mt19937_64 rng(1);
+    bool allocated = false;
+
+    printf("%6s %-8s %12s %12s\n", "bits", "kernel", "allocations", "arena blocks");
+    for (int bits : {256, 512, 1024, 2048, 3072, 4096, 8192})
+    {
+        BigNum p = randomBits(bits, rng) + BigNum(1);
+        if (!p.isOdd())
+            p = p + BigNum(1);
+        BigNum base = randomBits(bits - 1, rng), e = randomBits(bits, rng);
+        MontContext mont(p);
+        size_t n = mont.size();
+        vector<limb_t> baseM(n), out(n);
+        mont.toMont(base, baseM.data());
+        mont.powInto(out.data(), baseM.data(), e);
+
+        size_t before = heapAllocationCount(), blocks = ScratchArena::local().getHeapAllocations();
+        for (int i = 0; i < CALLS; i++)
+            mont.powInto(out.data(), baseM.data(), e);
+        size_t count = heapAllocationCount() - before;
+        blocks = ScratchArena::local().getHeapAllocations() - blocks;
+
+        string kernel = mont.vector() ? simdKernelName(mont.vector()->getKind())
+                                      : mont.fixedWidth() ? "fixed" + to_string(mont.fixedWidth()) : "montMul";
+        printf("%6d %-8s %12zu %12zu\n", bits, kernel.c_str(), count, blocks);
+        allocated |= count != 0;
+    }
+    return allocated ? 1 : 0;
+}
@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "../common/bignum.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+using namespace std;
+
+// BigNum primitives across operand sizes: add, mul, sqr, divmod (a 2n-bit
+// dividend by an n-bit divisor), modInverse and modPow (odd n-bit modulus,
+// full-width exponent), and reversed-hex encode / decode. Each measurement
+// warms up, then takes samples of a batch of calls sized to at least 20 us
+// (at least 5 samples, at most 1000) and reports the median and 99th
+// percentile per call, and median TSC cycles per 32-bit limb of operand.
+// The kernel column names the path the operands took; run with
+// $BIGNUM_KERNEL=scalar|avx2|ifma to compare SIMD kernels on one machine.
+//   g++ -O2 -std=c++17 bench/bignum.cpp -o bench_bignum
+//   ./bench_bignum [--json] [--seconds S] [--sizes 256,1024,...] [--ops mul,sqr,...]
+// CSV on stdout by default, one row per (op, bits); --json prints an array.
+
+struct Result
+{
+    string op;
+    int bits;
+    string kernel;
+    size_t samples;
+    double medianNs, p99Ns, cyclesPerLimb;
+};
+
+uint64_t cycles()
+{
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+BigNum randomBits(int bits, mt19937_64 &rng)
+{
+    vector<limb_t> limbs((bits + 31) / 32);
+    for (limb_t &l : limbs)
+        l = (limb_t)rng();
+    if (bits % 32)
+        limbs.back() &= (limb_t(1) << (bits % 32)) - 1;
+    limbs.back() |= limb_t(1) << ((bits - 1) % 32);
+    return BigNum::fromLimbs(limbs.data(), limbs.size());
+}
+
+// Warms f up for a tenth of `seconds`, then samples it for the rest
+template <class F>
+void measure(Result &r, int limbs, F f, double seconds)
+{
+    using clock = chrono::steady_clock;
+    auto elapsed = [](clock::time_point since) { return chrono::duration<double>(clock::now() - since).count(); };
+
+    // warm-up, which also sizes the batch
+    size_t batch = 1;
+    auto start = clock::now();
+    for (;;)
+    {
+        auto t = clock::now();
+        for (size_t i = 0; i < batch; i++)
+            f();
+        if (elapsed(t) >= 20e-6 && elapsed(start) >= seconds / 10)
+            break;
+        if (elapsed(t) < 20e-6)
+            batch *= 2;
+    }
+
+    vector<double> ns;
+    vector<uint64_t> cyc;
+    start = clock::now();
+    while (ns.size() < 5 || (ns.size() < 1000 && elapsed(start) < seconds))
+    {
+        auto t = clock::now();
+        uint64_t c = cycles();
+        for (size_t i = 0; i < batch; i++)
+            f();
+        cyc.push_back((cycles() - c) / batch);
+        ns.push_back(chrono::duration<double, nano>(clock::now() - t).count() / batch);
+    }
+    sort(ns.begin(), ns.end());
+    sort(cyc.begin(), cyc.end());
+    r.samples = ns.size();
+    r.medianNs = ns[ns.size() / 2];
+    r.p99Ns = ns[min(ns.size() - 1, ns.size() * 99 / 100)];
+    r.cyclesPerLimb = (double)cyc[cyc.size() / 2] / limbs;
+}
+
+string mulKernel(size_t limbs)
+{
+#ifdef NTT_AVAILABLE
+    if (limbs >= tuning().nttMulLimbs)
+        return "ntt";
+#endif
+    (void)limbs;
+    return "schoolbook";
+}
+
+// The path MontContext gives exponentiations modulo m
+string powKernel(const MontContext &mont)
+{
+    if (mont.vector())
+        return simdKernelName(mont.vector()->getKind());
+    if (mont.isSpecialForm())
+        return "fold";
+    if (mont.fixedWidth())
+        return "fixed" + to_string(mont.fixedWidth());
+    return mont.size() >= tuning().nttMontLimbs ? "ntt" : "montMul";
+}
+
+vector<int> parseList(const char *s)
+{
+    vector<int> out;
+    for (const char *p = s; *p; p++)
+        if (p == s || p[-1] == ',')
+            out.push_back(atoi(p));
+    return out;
+}
+
+bool wanted(const vector<string> &ops, const string &op)
+{
+    return ops.empty() || find(ops.begin(), ops.end(), op) != ops.end();
+}
+
+int main(int argc, char *argv[])
+{
+    bool json = false;
+    double seconds = 0.2;
+    vector<int> sizes = {256, 512, 1024, 2048, 3072, 4096, 8192};
+    vector<string> ops;
+    for (int i = 1; i < argc; i++)
+    {
+        string opt = argv[i];
+        if (opt == "--json")
+            json = true;
+        else if (opt == "--seconds" && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else if (opt == "--sizes" && i + 1 < argc)
+            sizes = parseList(argv[++i]);
+        else if (opt == "--ops" && i + 1 < argc)
+        {
+            for (char *tok = strtok(argv[++i], ","); tok; tok = strtok(nullptr, ","))
+                ops.push_back(tok);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--json] [--seconds S] [--sizes 256,1024,...] [--ops add,mul,...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    mt19937_64 rng(1);
+    vector<Result> results;
+    auto run = [&](const string &op, int bits, const string &kernel, auto f) {
+        if (!wanted(ops, op))
+            return;
+        Result r{op, bits, kernel, 0, 0, 0, 0};
+        measure(r, (bits + 31) / 32, f, seconds);
+        results.push_back(r);
+        if (!json)
+            printf("%s,%d,%s,%zu,%.1f,%.1f,%.2f\n", r.op.c_str(), r.bits, r.kernel.c_str(), r.samples, r.medianNs,
+                   r.p99Ns, r.cyclesPerLimb);
+        fflush(stdout);
+    };
+
+    if (!json)
+        printf("op,bits,kernel,samples,median_ns,p99_ns,cycles_per_limb\n");
+    for (int bits : sizes)
+    {
+        if (bits < 64)
+            continue;
+        size_t limbs = (bits + 31) / 32;
+        BigNum a = randomBits(bits, rng), b = randomBits(bits, rng), wide = randomBits(2 * bits, rng);
+        BigNum m = randomBits(bits, rng);
+        if (!m.isOdd())
+            m = m + BigNum(1);
+        BigNum e = randomBits(bits, rng), x = a % m;
+        BigNum out, quot, rem;
+        string hex = a.toReversedHex();
+        MontContext mont(m);
+
+        run("add", bits, "bytes", [&] { out = a + b; });
+        run("mul", bits, mulKernel(limbs), [&] { BigNum::mulTo(out, a, b); });
+        run("sqr", bits, mulKernel(limbs), [&] { BigNum::sqrTo(out, a); });
+        run("divmod", bits, limbs * 4 >= tuning().newtonDivDigits ? "newton" : "schoolbook",
+            [&] { wide.divideInto(quot, rem, m); });
+        run("modInverse", bits, "odd", [&] { out = BigNum::modInverse(x, m); });
+        run("modPow", bits, powKernel(mont), [&] { out = BigNum::modPow(x, e, m); });
+        run("hexEncode", bits, "-", [&] { hex = a.toReversedHex(); });
+        run("hexDecode", bits, "-", [&] { out.parseReversedHex(hex); });
+    }
+
+    if (json)
+    {
+        printf("{\"simd\":\"%s\",\"results\":[", simdKernelName(simdKernel()));
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result &r = results[i];
+            printf("%s\n {\"op\":\"%s\",\"bits\":%d,\"kernel\":\"%s\",\"samples\":%zu,\"median_ns\":%.1f,"
+                   "\"p99_ns\":%.1f,\"cycles_per_limb\":%.2f}",
+                   i ? "," : "", r.op.c_str(), r.bits, r.kernel.c_str(), r.samples, r.medianNs, r.p99Ns,
+                   r.cyclesPerLimb);
+        }
+        printf("\n]}\n");
+    }
+    return 0;
+}
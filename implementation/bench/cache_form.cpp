@@ -0,0 +1,58 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include "../common/group_context.h"
+using namespace std;
+
+// Regression check for cached tables across a tuning change. A special-form
+// modulus (p = 2^6144 - 569) gets a table of plain values, marked by R^2 = 1
+// in its cache file; once a profile moves ntt_mont_limbs below p's size the
+// context takes Montgomery form instead, and must rebuild that table rather
+// than run it as Montgomery values. Each step compares powG with a plain
+// Montgomery exponentiation; the exit status is 1 on any mismatch. Runs in a
+// fresh cache directory under $TMPDIR (or /tmp), removed afterwards.
+//   g++ -O2 -std=c++17 bench/cache_form.cpp -o bench_cache_form
+//   ./bench_cache_form
+
+int main()
+{
+    const char *tmp = getenv("TMPDIR");
+    string dir = string(tmp && *tmp ? tmp : "/tmp") + "/bignum-cache-form-XXXXXX";
+    if (!mkdtemp(&dir[0]))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    setenv("BIGNUM_CACHE_DIR", dir.c_str(), 1);
+
+    BigNum two(2), p = two, g(5), e = BigNum(0x123456789abcdefLL);
+    for (int i = 1; i < 6144; i++)
+        p = p + p;
+    p = p - BigNum(569);
+    for (int i = 0; i < 12; i++)
+        e = e * BigNum(0x1f2e3d4c5b6a7988LL) + BigNum(i);
+    BigNum expected = MontContext(p, false).pow(g, e);
+
+    bool failed = false;
+    auto step = [&](const char *what) {
+        GroupContext group(p, g, GroupContext::BUILD_TABLE);
+        bool ok = group.powG(e).cmp(expected) == 0;
+        printf("%-34s %-7s table %-3s %s\n", what, group.getMont()->isSpecialForm() ? "special" : "mont",
+               group.hasTable() ? "yes" : "no", ok ? "OK" : "WRONG");
+        failed |= !ok || !group.hasTable();
+    };
+    step("build, default profile");
+    step("load, default profile");
+    size_t defaultLimbs = tuning().nttMontLimbs;
+    Tuning::current().nttMontLimbs = 160;
+    step("load, ntt_mont_limbs 160");
+    step("reload, ntt_mont_limbs 160");
+    Tuning::current().nttMontLimbs = defaultLimbs;
+    step("load, default profile again");
+
+    string cmd = "rm -rf '" + dir + "'";
+    if (system(cmd.c_str()) != 0)
+        fprintf(stderr, "could not remove %s\n", dir.c_str());
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "../common/group_context.h"
+using namespace std;
+
+// Cost of the constant-time exponentiations over the variable-time ones they
+// stand in for, on random full-width odd moduli and exponents: pow against
+// MontContext::powConstTime, and a fixed-base table's pow against its
+// powConstTime. The exit status is 1 if powConstTime costs more than the 25%
+// budget at some size; the table path scans 15 entries per 4-bit window, so
+// its relative cost is higher and only reported. The last two columns time
+// powConstTime on the sparsest and the densest exponent of the width, which
+// should agree to within noise.
+//   g++ -O2 -std=c++17 bench/constant_time.cpp -o bench_constant_time
+//   ./bench_constant_time [seconds per measurement, default 0.2]
+
+const double BUDGET = 0.25;
+
+BigNum randomBits(int bits, mt19937_64 &rng)
+{
+    vector<limb_t> limbs((bits + 31) / 32);
+    for (limb_t &l : limbs)
+        l = (limb_t)rng();
+    if (bits % 32)
+        limbs.back() &= (limb_t(1) << (bits % 32)) - 1;
+    limbs.back() |= limb_t(1) << ((bits - 1) % 32);
+    return BigNum::fromLimbs(limbs.data(), limbs.size());
+}
+
+// 2^(bits-1) and 2^bits - 1
+BigNum sparse(int bits)
+{
+    vector<limb_t> limbs((bits + 31) / 32, 0);
+    limbs.back() = limb_t(1) << ((bits - 1) % 32);
+    return BigNum::fromLimbs(limbs.data(), limbs.size());
+}
+
+BigNum dense(int bits)
+{
+    vector<limb_t> limbs((bits + 31) / 32, ~limb_t(0));
+    if (bits % 32)
+        limbs.back() = (limb_t(1) << (bits % 32)) - 1;
+    return BigNum::fromLimbs(limbs.data(), limbs.size());
+}
+
+// Runs f repeatedly for about `seconds`; microseconds per call
+template <class F>
+double timePerCall(F f, double seconds)
+{
+    using clock = chrono::steady_clock;
+    size_t calls = 0, batch = 1;
+    auto start = clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds)
+    {
+        for (size_t i = 0; i < batch; i++)
+            f();
+        calls += batch;
+        batch *= 2;
+        elapsed = chrono::duration<double>(clock::now() - start).count();
+    }
+    return elapsed * 1e6 / calls;
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 0.2;
+    mt19937_64 rng(1);
+    bool over = false;
+
+    printf("%6s %-8s %10s %10s %8s %10s %10s %8s %10s %10s\n", "bits", "kernel", "pow", "ct", "cost", "powG",
+           "ct", "cost", "ct sparse", "ct dense");
+    for (int bits : {256, 512, 1024, 1536, 2048, 3072, 4096})
+    {
+        BigNum p = randomBits(bits, rng) + BigNum(1);
+        if (!p.isOdd())
+            p = p + BigNum(1);
+        BigNum g = randomBits(bits - 1, rng), base = randomBits(bits - 1, rng), e = randomBits(bits, rng);
+
+        MontContext mont(p);
+        GroupContext group(p, g, GroupContext::NO_TABLE);
+        if (mont.powConstTime(base, e, bits).cmp(mont.pow(base, e)) != 0 ||
+            group.powGConstTime(e, bits).cmp(group.powG(e)) != 0)
+        {
+            printf("%6d results differ\n", bits);
+            return 1;
+        }
+
+        double pow = timePerCall([&] { mont.pow(base, e); }, seconds);
+        double ct = timePerCall([&] { mont.powConstTime(base, e, bits); }, seconds);
+        double ctSparse = timePerCall([&] { mont.powConstTime(base, sparse(bits), bits); }, seconds);
+        double ctDense = timePerCall([&] { mont.powConstTime(base, dense(bits), bits); }, seconds);
+
+        // the fixed-base table, as the tools have it once the cache holds it
+        FixedBaseTable table;
+        table.build(mont, g, bits);
+        double powG = timePerCall([&] { table.pow(e); }, seconds);
+        double ctG = timePerCall([&] { table.powConstTime(e, bits); }, seconds);
+
+        string kernel = mont.vector() ? simdKernelName(mont.vector()->getKind())
+                                      : mont.fixedWidth() ? "fixed" + to_string(mont.fixedWidth()) : "montMul";
+        printf("%6d %-8s %10.1f %10.1f %7.1f%% %10.1f %10.1f %7.1f%% %10.1f %10.1f\n", bits, kernel.c_str(), pow, ct,
+               100 * (ct / pow - 1), powG, ctG, 100 * (ctG / powG - 1), ctSparse, ctDense);
+        over |= ct > pow * (1 + BUDGET);
+    }
+    return over ? 1 : 0;
+}
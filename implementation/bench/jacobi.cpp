@@ -0,0 +1,111 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "../common/bignum.h"
+using namespace std;
+
+// The Jacobi symbol against the exponentiation it replaces in the subgroup
+// tests, Y^q mod p with q = (p-1)/2, on random full-width odd moduli. The
+// "bignum" column is the previous BigNum-per-step loop, kept here as the
+// reference the limb version must agree with. The exit status is 1 if the
+// results disagree, or if jacobi is not at least 10x faster than Y^q from
+// 1024 bits up.
+//   g++ -O2 -std=c++17 bench/jacobi.cpp -o bench_jacobi
+//   ./bench_jacobi [seconds per measurement, default 0.2]
+
+const double SPEEDUP = 10;
+
+BigNum randomBits(int bits, mt19937_64 &rng)
+{
+    vector<limb_t> limbs((bits + 31) / 32);
+    for (limb_t &l : limbs)
+        l = (limb_t)rng();
+    if (bits % 32)
+        limbs.back() &= (limb_t(1) << (bits % 32)) - 1;
+    limbs.back() |= limb_t(1) << ((bits - 1) % 32);
+    return BigNum::fromLimbs(limbs.data(), limbs.size());
+}
+
+int referenceJacobi(BigNum a, BigNum n)
+{
+    int t = 1;
+    a = a % n;
+    while (!a.isZero())
+    {
+        while (!a.isOdd())
+        {
+            a = a.div2();
+            int r = n.getDigits()[0] & 7;
+            if (r == 3 || r == 5)
+                t = -t;
+        }
+        if (a.cmp(n) < 0)
+        {
+            swap(a, n);
+            if ((a.getDigits()[0] & 3) == 3 && (n.getDigits()[0] & 3) == 3)
+                t = -t;
+        }
+        a -= n;
+    }
+    return n.cmp(BigNum(1)) == 0 ? t : 0;
+}
+
+// Runs f repeatedly for about `seconds`; microseconds per call
+template <class F>
+double timePerCall(F f, double seconds)
+{
+    using clock = chrono::steady_clock;
+    size_t calls = 0, batch = 1;
+    auto start = clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds)
+    {
+        for (size_t i = 0; i < batch; i++)
+            f();
+        calls += batch;
+        batch *= 2;
+        elapsed = chrono::duration<double>(clock::now() - start).count();
+    }
+    return elapsed * 1e6 / calls;
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 0.2;
+    mt19937_64 rng(1);
+    bool slow = false;
+
+    // agreement, including small moduli, multiples and values above n
+    for (int i = 0; i < 20000; i++)
+    {
+        int bits = 2 + i % 300;
+        BigNum n = randomBits(bits, rng);
+        if (!n.isOdd())
+            n = n + BigNum(1);
+        BigNum a = i % 7 == 0 ? n * randomBits(1 + i % 40, rng) : randomBits(1 + (int)(rng() % (bits + 40)), rng);
+        if (BigNum::jacobi(a, n) != referenceJacobi(a, n))
+        {
+            printf("jacobi differs at %d bits\n", bits);
+            return 1;
+        }
+    }
+
+    printf("%6s %10s %10s %10s %8s\n", "bits", "Y^q", "bignum", "jacobi", "speedup");
+    for (int bits : {256, 512, 1024, 2048, 3072, 4096})
+    {
+        BigNum p = randomBits(bits, rng);
+        if (!p.isOdd())
+            p = p + BigNum(1);
+        BigNum y = randomBits(bits - 1, rng), q = (p - BigNum(1)).div2();
+        MontContext mont(p);
+
+        double pow = timePerCall([&] { mont.pow(y, q); }, seconds);
+        double reference = timePerCall([&] { referenceJacobi(y, p); }, seconds);
+        double jacobi = timePerCall([&] { BigNum::jacobi(y, p); }, seconds);
+        printf("%6d %10.1f %10.1f %10.1f %7.1fx\n", bits, pow, reference, jacobi, pow / jacobi);
+        slow |= bits >= 1024 && pow < jacobi * SPEEDUP;
+    }
+    return slow ? 1 : 0;
+}
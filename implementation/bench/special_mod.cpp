@@ -0,0 +1,123 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include "../common/bignum.h"
+using namespace std;
+
+// Special-form reduction (common/special_mod.h) against the generic path the
+// same modulus would otherwise get: one modular multiplication (ns) and one
+// full-width exponentiation (us) per prime, with the kernel each ran on.
+//   g++ -O2 -std=c++17 bench/special_mod.cpp -o bench_special_mod
+//   ./bench_special_mod [seconds per measurement, default 0.2]
+
+BigNum powerOfTwo(int k)
+{
+    vector<limb_t> limbs(k / 32 + 1, 0);
+    limbs.back() = limb_t(1) << (k % 32);
+    return BigNum::fromLimbs(limbs.data(), limbs.size());
+}
+
+BigNum randomBelow(const BigNum &m, mt19937_64 &rng)
+{
+    vector<limb_t> limbs(m.limbCount());
+    for (limb_t &l : limbs)
+        l = (limb_t)rng();
+    return BigNum::fromLimbs(limbs.data(), limbs.size()) % m;
+}
+
+// Runs f repeatedly for about `seconds`; nanoseconds per call
+template <class F>
+double timePerCall(F f, double seconds)
+{
+    using clock = chrono::steady_clock;
+    size_t calls = 0, batch = 1;
+    auto start = clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds)
+    {
+        for (size_t i = 0; i < batch; i++)
+            f();
+        calls += batch;
+        batch *= 2;
+        elapsed = chrono::duration<double>(clock::now() - start).count();
+    }
+    return elapsed * 1e9 / calls;
+}
+
+// Kernel behind MontContext::mul, and the one running its exponentiations
+string mulKernel(const MontContext &ctx)
+{
+    if (ctx.isSpecialForm())
+        return "fold";
+    if (ctx.fixedWidth())
+        return "fixed" + to_string(ctx.fixedWidth());
+    return ctx.size() >= tuning().nttMontLimbs ? "ntt" : "montMul";
+}
+
+string powKernel(const MontContext &ctx)
+{
+    return ctx.vector() ? "simd" : mulKernel(ctx);
+}
+
+int main(int argc, char *argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 0.2;
+
+    // 2^k - c primes with the smallest c, and the usual named special forms
+    struct Prime
+    {
+        const char *name;
+        BigNum p;
+    };
+    vector<Prime> primes = {
+        {"2^255-19", powerOfTwo(255) - BigNum(19)},
+        {"secp256k1", powerOfTwo(256) - powerOfTwo(32) - BigNum(977)},
+        {"P-384", powerOfTwo(384) + powerOfTwo(32) - powerOfTwo(128) - powerOfTwo(96) - BigNum(1)},
+        {"2^512-569", powerOfTwo(512) - BigNum(569)},
+        {"P-521", powerOfTwo(521) - BigNum(1)},
+        {"2^1024-105", powerOfTwo(1024) - BigNum(105)},
+        {"2^2048-1557", powerOfTwo(2048) - BigNum(1557)},
+        {"2^3072-47", powerOfTwo(3072) - BigNum(47)},
+        {"2^4096-2549", powerOfTwo(4096) - BigNum(2549)},
+    };
+
+    mt19937_64 rng(1);
+    printf("%-12s %-32s %-15s %9s %9s %6s  %-10s %10s %10s %6s\n", "prime", "form", "mul", "generic", "special",
+           "gain", "modPow", "generic", "special", "gain");
+    for (const Prime &prime : primes)
+    {
+        MontContext generic(prime.p, false), special(prime.p);
+        if (!special.isSpecialForm())
+        {
+            printf("%-12s not detected\n", prime.name);
+            return 1;
+        }
+
+        size_t n = generic.size();
+        BigNum a = randomBelow(prime.p, rng), b = randomBelow(prime.p, rng), e = randomBelow(prime.p, rng);
+        vector<limb_t> x(n), y(n), t(n + 2), gx(n), gy(n);
+        a.toLimbs(x.data(), n);
+        b.toLimbs(y.data(), n);
+        generic.toMont(a, gx.data());
+        generic.toMont(b, gy.data());
+
+        if (special.pow(a, e).cmp(generic.pow(a, e)) != 0 || special.mulMod(a, b).cmp(generic.mulMod(a, b)) != 0)
+        {
+            printf("%-12s results differ\n", prime.name);
+            return 1;
+        }
+
+        double mulGeneric = timePerCall([&] { generic.mul(gx.data(), gx.data(), gy.data(), t.data()); }, seconds);
+        double mulSpecial = timePerCall([&] { special.mul(x.data(), x.data(), y.data(), t.data()); }, seconds);
+        double powGeneric = timePerCall([&] { generic.pow(a, e); }, seconds) / 1000;
+        double powSpecial = timePerCall([&] { special.pow(a, e); }, seconds) / 1000;
+        string mulKernels = mulKernel(generic) + "/" + mulKernel(special);
+        string powKernels = powKernel(generic) + "/" + powKernel(special);
+        printf("%-12s %-32s %-15s %9.1f %9.1f %5.2fx  %-10s %10.1f %10.1f %5.2fx\n", prime.name,
+               special.specialForm()->describe().c_str(), mulKernels.c_str(), mulGeneric, mulSpecial,
+               mulGeneric / mulSpecial, powKernels.c_str(), powGeneric, powSpecial, powGeneric / powSpecial);
+    }
+    return 0;
+}
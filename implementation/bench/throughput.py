@@ -0,0 +1,230 @@
+"""
+End-to-end throughput of the four tools on seeded workloads, checked against
+a stored baseline. For each group size a prime p = 2kq + 1 (q prime, k small,
+so p - 1 factors) is drawn from the seed, and each tool gets a workload in it:
+
+    project1  one primitive-root check per run
+    project2  --batch N key exchanges (--exp-bits 256) per run
+    project3  one decryption per run
+    project4  N signature verifications over a few signers per run
+
+Every workload gets one untimed warm-up run (which also fills its own
+precomputation cache), then --runs timed runs. Reported per workload: ops/sec
+over the timed runs, p50 / p90 / p99 wall time per run in ms, and the peak RSS
+of the tool in KiB (from its --stats line: getrusage on a child charges it
+the parent's resident set at fork, which here is all of Python's). A run that fails or answers with the wrong number of
+results stops the suite.
+
+    g++ -O2 -std=c++17 projectN/main.cpp -o projectN/main -lpthread   (N = 1..4)
+    python3 bench/throughput.py [--bits 512,1024,2048] [--seed 1] [--runs 10]
+        [--save-baseline bench/throughput_baseline.json]
+        [--baseline bench/throughput_baseline.json] [--threshold 0.10] [--rss-threshold 0.25]
+
+With --baseline the exit status is 1 if some workload's ops/sec fell, or its
+p50 run time or peak RSS rose, by more than the threshold. Baselines only
+mean something on the machine and build flags they were recorded with.
+"""
+import argparse
+import json
+import math
+import os
+import platform
+import random
+import subprocess
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(HERE)
+
+SMALL_PRIMES = [d for d in range(3, 2000) if all(d % k for k in range(2, int(d ** 0.5) + 1))]
+
+
+def rh(n):
+    return format(n, "X")[::-1]
+
+
+def is_probable_prime(n, rng, rounds=20):
+    if n < 4:
+        return n in (2, 3)
+    for d in SMALL_PRIMES:
+        if n % d == 0:
+            return n == d
+    d, s = n - 1, 0
+    while d % 2 == 0:
+        d, s = d // 2, s + 1
+    for _ in range(rounds):
+        x = pow(rng.randrange(2, n - 1), d, n)
+        if x in (1, n - 1):
+            continue
+        for _ in range(s - 1):
+            x = x * x % n
+            if x == n - 1:
+                break
+        else:
+            return False
+    return True
+
+
+def random_prime(bits, rng):
+    while True:
+        p = rng.getrandbits(bits) | (1 << (bits - 1)) | 1
+        if is_probable_prime(p, rng):
+            return p
+
+
+def prime_factors(n):
+    f, d = [], 2
+    while d * d <= n:
+        if n % d == 0:
+            f.append(d)
+            while n % d == 0:
+                n //= d
+        d += 1
+    if n > 1:
+        f.append(n)
+    return f
+
+
+def group(bits, rng):
+    """A bits-bit prime p = 2kq + 1 and the distinct prime factors of p - 1"""
+    q = random_prime(bits - 20, rng)
+    while True:
+        k = rng.randrange(1 << 18, 1 << 19)
+        p = 2 * k * q + 1
+        if p.bit_length() == bits and is_probable_prime(p, rng):
+            return p, sorted(set(prime_factors(2 * k)) | {q})
+
+
+def signatures(p, g, count, rng):
+    keys = [rng.randrange(2, p - 1) for _ in range(4)]
+    recs = []
+    while len(recs) < count:
+        x = rng.choice(keys)
+        m = rng.randrange(1, p - 1)
+        while True:
+            k = rng.randrange(2, p - 1)
+            if math.gcd(k, p - 1) == 1:
+                break
+        r = pow(g, k, p)
+        s = (m - x * r) * pow(k, -1, p - 1) % (p - 1)
+        if s:
+            recs.append((pow(g, x, p), m, r, s))
+    return "".join(f"{rh(p)}\n{rh(g)}\n{rh(y)}\n{rh(m)}\n{rh(r)}\n{rh(s)}\n" for y, m, r, s in recs)
+
+
+def workloads(bits, rng, batch):
+    """(name, tool, input text, extra args, ops per run, result lines per run)"""
+    p, factors = group(bits, rng)
+    g = rng.randrange(2, p - 1)
+    return [
+        (f"project1-{bits}", 1, f"{rh(p)}\n{len(factors)}\n{' '.join(map(rh, factors))}\n{rh(g)}\n", [], 1, 1),
+        (f"project2-{bits}", 2, f"{rh(p)}\n{rh(g)}\n1\n1\n", ["--batch", str(batch), "--exp-bits", "256"], batch,
+         5 * batch),
+        (f"project3-{bits}", 3, f"{rh(p)}\n{rh(g)}\n" + "".join(f"{rh(rng.randrange(2, p - 1))}\n" for _ in range(3)),
+         [], 1, 2),
+        (f"project4-{bits}", 4, signatures(p, g, batch, rng), [], batch, batch),
+    ]
+
+
+def run_once(exe, inp, out, extra, env):
+    """Wall seconds and peak RSS (KiB) of one run"""
+    start = time.perf_counter()
+    proc = subprocess.run([exe, inp, out] + extra + ["--stats"], stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+                          env=env, text=True)
+    elapsed = time.perf_counter() - start
+    if proc.returncode != 0:
+        raise RuntimeError(f"{exe} exited with {proc.returncode}: {proc.stderr.strip()}")
+    stats = json.loads(proc.stderr.strip().splitlines()[-1])
+    return elapsed, stats["peak_rss_kb"]
+
+
+def percentile(sorted_values, q):
+    return sorted_values[min(len(sorted_values) - 1, int(len(sorted_values) * q))]
+
+
+def measure(name, tool, text, extra, ops, lines, runs, work):
+    exe = os.path.join(ROOT, f"project{tool}", "main")
+    inp, out = os.path.join(work, f"{name}.in"), os.path.join(work, f"{name}.out")
+    with open(inp, "w") as f:
+        f.write(text)
+    env = dict(os.environ, BIGNUM_CACHE_DIR=os.path.join(work, f"{name}.cache"))
+
+    times, rss = [], 0
+    for i in range(runs + 1):
+        elapsed, peak = run_once(exe, inp, out, extra, env)
+        with open(out) as f:
+            got = len(f.read().split())
+        if got != lines:
+            raise RuntimeError(f"{name}: {got} results, expected {lines}")
+        if i:
+            times.append(elapsed)
+            rss = max(rss, peak)
+    times.sort()
+    return {
+        "ops_per_sec": ops * runs / sum(times),
+        "p50_ms": percentile(times, 0.50) * 1e3,
+        "p90_ms": percentile(times, 0.90) * 1e3,
+        "p99_ms": percentile(times, 0.99) * 1e3,
+        "peak_rss_kb": rss,
+    }
+
+
+def regressions(name, now, base, threshold, rss_threshold):
+    out = []
+    if now["ops_per_sec"] < base["ops_per_sec"] * (1 - threshold):
+        out.append(f"ops/sec {base['ops_per_sec']:.1f} -> {now['ops_per_sec']:.1f}")
+    if now["p50_ms"] > base["p50_ms"] * (1 + threshold):
+        out.append(f"p50 {base['p50_ms']:.2f} -> {now['p50_ms']:.2f} ms")
+    if now["peak_rss_kb"] > base["peak_rss_kb"] * (1 + rss_threshold):
+        out.append(f"peak RSS {base['peak_rss_kb']} -> {now['peak_rss_kb']} KiB")
+    return [f"{name}: {r}" for r in out]
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--bits", default="512,1024,2048", help="group sizes, comma-separated")
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--runs", type=int, default=10, help="timed runs per workload")
+    ap.add_argument("--batch", type=int, default=64, help="operations per run of project2 and project4")
+    ap.add_argument("--baseline", help="baseline JSON to compare against")
+    ap.add_argument("--save-baseline", help="write this run's results as a baseline")
+    ap.add_argument("--threshold", type=float, default=0.10, help="allowed ops/sec and p50 regression")
+    ap.add_argument("--rss-threshold", type=float, default=0.25, help="allowed peak RSS growth")
+    args = ap.parse_args()
+
+    rng = random.Random(args.seed)
+    results = {}
+    print(f"{'workload':16s} {'ops/sec':>10s} {'p50 ms':>9s} {'p90 ms':>9s} {'p99 ms':>9s} {'RSS KiB':>9s}")
+    with tempfile.TemporaryDirectory() as work:
+        for bits in (int(b) for b in args.bits.split(",")):
+            for name, tool, text, extra, ops, lines in workloads(bits, rng, args.batch):
+                r = measure(name, tool, text, extra, ops, lines, args.runs, work)
+                results[name] = r
+                print(f"{name:16s} {r['ops_per_sec']:10.1f} {r['p50_ms']:9.2f} {r['p90_ms']:9.2f} "
+                      f"{r['p99_ms']:9.2f} {r['peak_rss_kb']:9d}", flush=True)
+
+    if args.save_baseline:
+        with open(args.save_baseline, "w") as f:
+            json.dump({"machine": platform.platform(), "seed": args.seed, "runs": args.runs, "batch": args.batch,
+                       "results": results}, f, indent=1, sort_keys=True)
+            f.write("\n")
+
+    if not args.baseline:
+        return 0
+    with open(args.baseline) as f:
+        base = json.load(f)["results"]
+    failed = []
+    for name, now in results.items():
+        if name in base:
+            failed += regressions(name, now, base[name], args.threshold, args.rss_threshold)
+        else:
+            print(f"{name}: not in the baseline")
+    for line in failed:
+        print("REGRESSION", line)
+    print("FAILED" if failed else "OK")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,105 @@
+"""
+In-process access to the tools' code paths through libbignum.so
+(capi/bignum_capi.cpp), for scripts that would otherwise write an input
+file, run a tool and read its output file for every case.
+
+    import bignum
+    bignum.mod_pow(3, 10**40, p)
+    h, m = bignum.decrypt(p, g, x, c1, c2)
+    ok = bignum.verify(p, g, y, m, r, s)
+    oks = bignum.verify_many([(p, g, y, m, r, s), ...])   # threaded
+    bignum.check_primitive_root(p, factors, g)
+    bignum.set_constant_time(True)   # decrypt's powers of x in fixed time
+
+The library is looked for in $BIGNUM_LIB, then next to this file. The GIL is
+released while the C++ code runs.
+"""
+import ctypes
+import os
+
+
+class BigNumError(ValueError):
+    pass
+
+
+class _In(ctypes.Structure):
+    _fields_ = [("bytes", ctypes.c_char_p), ("size", ctypes.c_size_t)]
+
+
+class _Out(ctypes.Structure):
+    _fields_ = [("bytes", ctypes.c_void_p), ("size", ctypes.c_size_t)]
+
+
+_lib = ctypes.CDLL(os.environ.get("BIGNUM_LIB") or os.path.join(os.path.dirname(os.path.abspath(__file__)), "libbignum.so"))
+_lib.bignum_last_error.restype = ctypes.c_char_p
+_lib.bignum_mod_pow.argtypes = [ctypes.POINTER(_In), ctypes.POINTER(_In), ctypes.POINTER(_In), ctypes.POINTER(_Out)]
+_lib.bignum_set_constant_time.argtypes = [ctypes.c_int]
+_lib.bignum_decrypt.argtypes = [ctypes.POINTER(_In), ctypes.POINTER(_Out)]
+_lib.bignum_verify.argtypes = [ctypes.POINTER(_In)]
+_lib.bignum_verify_batch.argtypes = [ctypes.POINTER(_In), ctypes.c_size_t, ctypes.POINTER(ctypes.c_int), ctypes.c_uint]
+_lib.bignum_check_primitive_root.argtypes = [ctypes.POINTER(_In), ctypes.POINTER(_In), ctypes.c_size_t, ctypes.POINTER(_In)]
+
+
+def _fill(slot, x):
+    if x < 0:
+        raise BigNumError("negative value")
+    data = x.to_bytes((x.bit_length() + 7) // 8, "little")
+    slot.bytes, slot.size = data, len(data)
+
+
+def _values(*xs):
+    arr = (_In * len(xs))()
+    for slot, x in zip(arr, xs):
+        _fill(slot, x)
+    return arr
+
+
+def _buffers(count, size):
+    raw = [ctypes.create_string_buffer(size) for _ in range(count)]
+    out = (_Out * count)()
+    for slot, buf in zip(out, raw):
+        slot.bytes, slot.size = ctypes.addressof(buf), size
+    return out, raw
+
+
+def _check(status):
+    if status < 0:
+        raise BigNumError(_lib.bignum_last_error().decode())
+    return status
+
+
+def set_constant_time(on=True):
+    _lib.bignum_set_constant_time(1 if on else 0)
+
+
+def mod_pow(base, exp, mod):
+    v = _values(base, exp, mod)
+    out, raw = _buffers(1, (mod.bit_length() + 7) // 8)
+    _check(_lib.bignum_mod_pow(v, ctypes.byref(v[1]), ctypes.byref(v[2]), out))
+    return int.from_bytes(raw[0].raw, "little")
+
+
+def decrypt(p, g, x, c1, c2):
+    v = _values(p, g, x, c1, c2)
+    out, raw = _buffers(2, (p.bit_length() + 7) // 8)
+    _check(_lib.bignum_decrypt(v, out))
+    return int.from_bytes(raw[0].raw, "little"), int.from_bytes(raw[1].raw, "little")
+
+
+def verify(p, g, y, m, r, s):
+    return _check(_lib.bignum_verify(_values(p, g, y, m, r, s))) == 1
+
+
+def verify_many(records, threads=0):
+    """One bool per (p, g, y, m, r, s) record; a rejected record gives a
+    BigNumError instance in its place. threads=0 uses every core."""
+    v = _values(*(x for rec in records for x in rec))
+    results = (ctypes.c_int * len(records))()
+    _lib.bignum_verify_batch(v, len(records), results, threads)
+    return [BigNumError("record rejected") if r < 0 else r == 1 for r in results]
+
+
+def check_primitive_root(p, factors, g):
+    v = _values(p, g)
+    f = _values(*factors) if factors else (_In * 1)()
+    return _check(_lib.bignum_check_primitive_root(v, f, len(factors), ctypes.byref(v[1]))) == 1
@@ -0,0 +1,168 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../common/operations.h"
+using namespace std;
+
+// C ABI over the tools' code paths, for in-process callers such as the Python
+// scripts (capi/bignum.py loads it with ctypes, which releases the GIL for
+// the duration of each call). Build:
+//   g++ -O2 -std=c++17 -shared -fPIC capi/bignum_capi.cpp -o capi/libbignum.so -lpthread
+//
+// Values are little-endian byte strings. Results are written zero-padded into
+// caller buffers; the modulus size always suffices. Functions return -1 on an
+// invalid input or a too small buffer, with the reason in bignum_last_error().
+// Each calling thread has its own warm group and signer caches.
+// bignum_set_constant_time(1) switches every thread's private-key
+// exponentiations (decrypt) to the constant-time path.
+
+extern "C"
+{
+    typedef struct
+    {
+        const uint8_t *bytes;
+        size_t size;
+    } bignum_in;
+
+    typedef struct
+    {
+        uint8_t *bytes;
+        size_t size;
+    } bignum_out;
+
+    const char *bignum_last_error(void);
+    void bignum_set_constant_time(int on);
+    int bignum_mod_pow(const bignum_in *base, const bignum_in *exp, const bignum_in *mod, bignum_out *result);
+    int bignum_decrypt(const bignum_in *in, bignum_out *out);
+    int bignum_verify(const bignum_in *in);
+    int bignum_verify_batch(const bignum_in *in, size_t count, int *results, unsigned threads);
+    int bignum_check_primitive_root(const bignum_in *p, const bignum_in *factors, size_t count, const bignum_in *g);
+}
+
+static thread_local string lastError;
+static atomic<bool> constantTime{false};
+
+static Operations &operations()
+{
+    static thread_local Operations ops;
+    ops.setConstantTime(constantTime.load(memory_order_relaxed));
+    return ops;
+}
+
+static BigNum load(const bignum_in &v)
+{
+    return BigNum::fromBytes(v.bytes, v.size);
+}
+
+static void store(const BigNum &x, bignum_out &out)
+{
+    const vector<int> &d = x.getDigits();
+    size_t n = x.isZero() ? 0 : d.size();
+    if (n > out.size)
+        throw invalid_argument("Result does not fit its buffer");
+    for (size_t i = 0; i < n; i++)
+        out.bytes[i] = uint8_t(d[i]);
+    fill(out.bytes + n, out.bytes + out.size, 0);
+}
+
+// Runs f, turning any std::exception into -1 and the thread's last error: none
+// may cross the C boundary
+template <class F>
+static int guarded(F f)
+{
+    try
+    {
+        return f();
+    }
+    catch (const exception &e)
+    {
+        lastError = e.what();
+        return -1;
+    }
+}
+
+static int verifyOne(const bignum_in *v)
+{
+    return operations().verify(load(v[0]), load(v[1]), load(v[2]), load(v[3]), load(v[4]), load(v[5])) ? 1 : 0;
+}
+
+const char *bignum_last_error(void)
+{
+    return lastError.c_str();
+}
+
+void bignum_set_constant_time(int on)
+{
+    constantTime = on != 0;
+}
+
+int bignum_mod_pow(const bignum_in *base, const bignum_in *exp, const bignum_in *mod, bignum_out *result)
+{
+    return guarded([&] {
+        BigNum m = load(*mod);
+        if (m.isZero())
+            throw invalid_argument("Modulus is 0");
+        store(BigNum::modPow(load(*base), load(*exp), m), *result);
+        return 0;
+    });
+}
+
+// in: p, g, x, c1, c2; out: h, m
+int bignum_decrypt(const bignum_in *in, bignum_out *out)
+{
+    return guarded([&] {
+        BigNum h, m;
+        operations().decrypt(load(in[0]), load(in[1]), load(in[2]), load(in[3]), load(in[4]), h, m);
+        store(h, out[0]);
+        store(m, out[1]);
+        return 0;
+    });
+}
+
+// in: p, g, y, m, r, s; 1 if the signature holds, 0 if not
+int bignum_verify(const bignum_in *in)
+{
+    return guarded([&] { return verifyOne(in); });
+}
+
+// count records of six values each, spread over `threads` threads (0: one
+// per core). results[i] is 1, 0, or -1 for a rejected record; the return
+// value is -1 if any record was rejected.
+int bignum_verify_batch(const bignum_in *in, size_t count, int *results, unsigned threads)
+{
+    if (threads == 0)
+        threads = max(1u, thread::hardware_concurrency());
+    threads = (unsigned)min<size_t>(threads, max<size_t>(count, 1));
+
+    atomic<size_t> next(0);
+    atomic<bool> failed(false);
+    auto work = [&] {
+        TaskPool::Busy busy;
+        for (size_t i; (i = next++) < count;)
+        {
+            results[i] = guarded([&] { return verifyOne(in + 6 * i); });
+            if (results[i] < 0)
+                failed = true;
+        }
+    };
+    vector<thread> pool;
+    for (unsigned t = 1; t < threads; t++)
+        pool.emplace_back(work);
+    work();
+    for (thread &t : pool)
+        t.join();
+    if (failed)
+        lastError = "Some records were rejected";
+    return failed ? -1 : 0;
+}
+
+int bignum_check_primitive_root(const bignum_in *p, const bignum_in *factors, size_t count, const bignum_in *g)
+{
+    return guarded([&] {
+        vector<BigNum> U;
+        for (size_t i = 0; i < count; i++)
+            U.push_back(load(factors[i]));
+        return operations().primitiveRoot(load(*p), U, load(*g)) ? 1 : 0;
+    });
+}
@@ -0,0 +1,131 @@
+"""
+Differential test of the in-process library against Python's own arithmetic:
+random mod_pow, decrypt, verify and check_primitive_root cases, no files and
+no subprocesses.
+
+    g++ -O2 -std=c++17 -shared -fPIC capi/bignum_capi.cpp -o capi/libbignum.so -lpthread
+    python3 capi/differential_test.py [--cases 100000] [--bits 256] [--seed 1]
+"""
+import argparse
+import math
+import random
+import time
+
+import bignum
+
+
+def is_probable_prime(n, rounds=20):
+    if n < 4:
+        return n in (2, 3)
+    if n % 2 == 0:
+        return False
+    d, s = n - 1, 0
+    while d % 2 == 0:
+        d, s = d // 2, s + 1
+    for _ in range(rounds):
+        x = pow(random.randrange(2, n - 1), d, n)
+        if x in (1, n - 1):
+            continue
+        for _ in range(s - 1):
+            x = x * x % n
+            if x == n - 1:
+                break
+        else:
+            return False
+    return True
+
+
+def random_prime(bits):
+    while True:
+        p = random.getrandbits(bits) | (1 << (bits - 1)) | 1
+        if is_probable_prime(p):
+            return p
+
+
+def prime_factors(n):
+    f, d = [], 2
+    while d * d <= n:
+        if n % d == 0:
+            f.append(d)
+            while n % d == 0:
+                n //= d
+        d += 1
+    if n > 1:
+        f.append(n)
+    return f
+
+
+def signature(p, g):
+    x = random.randrange(2, p - 1)
+    y = pow(g, x, p)
+    m = random.randrange(1, p - 1)
+    while True:
+        k = random.randrange(2, p - 1)
+        if math.gcd(k, p - 1) == 1:
+            break
+    r = pow(g, k, p)
+    s = (m - x * r) * pow(k, -1, p - 1) % (p - 1)
+    if random.random() < 0.25:
+        m = (m + 1) % (p - 1)  # a forged message
+    return (p, g, y, m, r, s)
+
+
+def expected_verify(p, g, y, m, r, s):
+    if not (0 < r < p and 0 < s < p - 1):
+        return False
+    return pow(g, m, p) == pow(y, r, p) * pow(r, s, p) % p
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--cases", type=int, default=100000, help="cases per operation")
+    ap.add_argument("--bits", type=int, default=256)
+    ap.add_argument("--groups", type=int, default=16, help="distinct primes to draw from")
+    ap.add_argument("--seed", type=int, default=1)
+    args = ap.parse_args()
+    random.seed(args.seed)
+
+    primes = [random_prime(args.bits) for _ in range(args.groups)]
+    failures = 0
+
+    def report(name, bad, start):
+        nonlocal failures
+        failures += bad
+        print(f"{name:22s} {args.cases} cases, {bad} mismatches, {time.time() - start:.2f}s")
+
+    start, bad = time.time(), 0
+    for _ in range(args.cases):
+        mod = random.choice(primes) if random.random() < 0.5 else random.getrandbits(args.bits) | 1
+        base, exp = random.getrandbits(args.bits + 8), random.getrandbits(args.bits)
+        bad += bignum.mod_pow(base, exp, mod) != pow(base, exp, mod)
+    report("mod_pow", bad, start)
+
+    start, bad = time.time(), 0
+    for _ in range(args.cases):
+        p = random.choice(primes)
+        g, x, c1, c2 = (random.randrange(2, p) for _ in range(4))
+        bad += bignum.decrypt(p, g, x, c1, c2) != (pow(g, x, p), c2 * pow(pow(c1, x, p), -1, p) % p)
+    report("decrypt", bad, start)
+
+    records = [signature(p, random.randrange(2, p)) for p in (random.choice(primes) for _ in range(args.cases))]
+    start = time.time()
+    got = bignum.verify_many(records)
+    bad = sum(g != expected_verify(*rec) for g, rec in zip(got, records))
+    report("verify_many", bad, start)
+
+    small = [random_prime(random.randrange(16, 41)) for _ in range(64)]
+    factors = {p: prime_factors(p - 1) for p in small}
+    start, bad = time.time(), 0
+    for _ in range(args.cases):
+        p = random.choice(small)
+        g = random.randrange(2, p)
+        want = all(pow(g, (p - 1) // k, p) != 1 for k in factors[p])
+        bad += bignum.check_primitive_root(p, factors[p], g) != want
+    report("check_primitive_root", bad, start)
+
+    print("FAILED" if failures else "OK")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
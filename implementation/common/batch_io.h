@@ -0,0 +1,383 @@
+#ifndef BATCH_IO_H
+#define BATCH_IO_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BATCH_IO_MMAP 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "bignum.h"
+
+// Input and output for the tools' text formats. The input file is mapped
+// and split into lines and tokens in place, so values go from the page cache
+// to the hex decoder as string_views without a copy; output is collected in
+// a large buffer and written in few system calls.
+
+inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; }
+
+// Offset of the first blank in p[i .. n), or n. Sixteen bytes at a time:
+// blanks are all <= 0x20, and the few other bytes flagged by the signed
+// compare (control characters, bytes >= 0x80) are rejected one by one.
+inline size_t findBlank(const char *p, size_t i, size_t n)
+{
+#if defined(__SSE2__)
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        for (int mask = _mm_movemask_epi8(_mm_cmplt_epi8(c, _mm_set1_epi8(0x21))); mask; mask &= mask - 1)
+            if (isBlank(p[i + __builtin_ctz(mask)]))
+                return i + __builtin_ctz(mask);
+    }
+#endif
+    while (i < n && !isBlank(p[i]))
+        i++;
+    return i;
+}
+
+// Next whitespace-separated token of text, which is advanced past it
+inline bool splitToken(std::string_view &text, std::string_view &token)
+{
+    size_t i = 0;
+    while (i < text.size() && isBlank(text[i]))
+        i++;
+    size_t j = findBlank(text.data(), i, text.size());
+    token = text.substr(i, j - i);
+    text.remove_prefix(j);
+    return j > i;
+}
+
+// ========================== CLASS InputReader ==========================
+
+// Whole input file, mapped read-only with a sequential-access hint (read
+// into memory where mmap is unavailable). Views stay valid while the reader
+// is alive.
+class InputReader
+{
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+    size_t pos = 0;
+    bool mapped = false;
+    std::string buffer;
+
+public:
+    InputReader() {}
+    InputReader(const InputReader &) = delete;
+    InputReader &operator=(const InputReader &) = delete;
+    ~InputReader() { close(); }
+
+    bool open(const std::string &path);
+    void close();
+
+    bool atEnd() const { return pos >= size; }
+    // The whole file, for formats read in place (binary records)
+    std::string_view contents() const { return std::string_view(data, size); }
+    // Next line without its terminator; false at the end of the file
+    bool nextLine(std::string_view &line);
+    // Next whitespace-separated token, across lines
+    bool nextToken(std::string_view &token);
+};
+
+inline bool InputReader::open(const std::string &path)
+{
+    close();
+#ifdef BATCH_IO_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size > 0)
+    {
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+            data = static_cast<const char *>(p);
+            size = st.st_size;
+            mapped = true;
+        }
+    }
+    ::close(fd);
+    if (mapped || st.st_size == 0)
+        return true;
+#endif
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    char chunk[1 << 16];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        buffer.append(chunk, got);
+    fclose(f);
+    data = buffer.data();
+    size = buffer.size();
+    return true;
+}
+
+inline void InputReader::close()
+{
+#ifdef BATCH_IO_MMAP
+    if (mapped)
+        munmap(const_cast<char *>(data), size);
+#endif
+    mapped = false;
+    buffer.clear();
+    data = nullptr;
+    size = pos = 0;
+}
+
+inline bool InputReader::nextLine(std::string_view &line)
+{
+    if (atEnd())
+    {
+        line = std::string_view();
+        return false;
+    }
+    const char *start = data + pos;
+    const char *nl = static_cast<const char *>(memchr(start, '\n', size - pos));
+    size_t len = nl ? nl - start : size - pos;
+    line = std::string_view(start, len);
+    pos += len + (nl ? 1 : 0);
+    return true;
+}
+
+inline bool InputReader::nextToken(std::string_view &token)
+{
+    std::string_view rest(data + pos, size - pos);
+    bool found = splitToken(rest, token);
+    pos = size - rest.size();
+    return found;
+}
+
+// ========================== CLASS StreamReader ==========================
+
+// Whitespace-separated tokens of a stream that may never end (stdin, a
+// pipe), read a chunk at a time as data arrives. Memory is one chunk and one
+// token: a token split across chunks is assembled in a buffer, and one
+// longer than maxToken is consumed but reported as oversized instead of
+// stored.
+class StreamReader
+{
+private:
+    FILE *file;
+    std::vector<char> chunk;
+    size_t pos = 0, len = 0;
+    std::string pending;
+    size_t maxToken;
+    bool ended = false;
+    bool failed = false;
+
+    bool refill();
+
+public:
+    explicit StreamReader(FILE *file, size_t maxToken = 1 << 16, size_t chunkSize = 1 << 16)
+        : file(file), chunk(chunkSize), maxToken(maxToken)
+    {
+    }
+
+    // Next token, valid until the next call; false at the end of the stream
+    bool nextToken(std::string_view &token, bool &oversized);
+    // A token can start without waiting for the stream
+    bool ready()
+    {
+        while (pos < len && isBlank(chunk[pos]))
+            pos++;
+        return pos < len;
+    }
+    // A read failed (rather than the stream ending)
+    bool error() const { return failed; }
+};
+
+// Whatever is available, up to a chunk; blocks only while nothing is
+inline bool StreamReader::refill()
+{
+    if (ended)
+        return false;
+    pos = 0;
+#ifdef BATCH_IO_MMAP
+    ssize_t got;
+    do
+        got = ::read(fileno(file), chunk.data(), chunk.size());
+    while (got < 0 && errno == EINTR);
+    failed = got < 0;
+    len = got > 0 ? (size_t)got : 0;
+#else
+    len = fread(chunk.data(), 1, chunk.size(), file);
+    failed = ferror(file) != 0;
+#endif
+    ended = len == 0;
+    return !ended;
+}
+
+inline bool StreamReader::nextToken(std::string_view &token, bool &oversized)
+{
+    oversized = false;
+    for (;;)
+    {
+        while (pos < len && isBlank(chunk[pos]))
+            pos++;
+        if (pos < len)
+            break;
+        if (!refill())
+            return false;
+    }
+
+    // In one chunk: a view of it, no copy
+    size_t end = findBlank(chunk.data(), pos, len);
+    if (end < len)
+    {
+        token = std::string_view(chunk.data() + pos, end - pos);
+        pos = end;
+        oversized = token.size() > maxToken;
+        if (oversized)
+            token = std::string_view();
+        return true;
+    }
+
+    // Across chunks: assembled, up to maxToken
+    pending.clear();
+    for (;;)
+    {
+        if (pending.size() + (end - pos) > maxToken)
+            oversized = true;
+        else
+            pending.append(chunk.data() + pos, end - pos);
+        pos = end;
+        if (end < len || !refill())
+            break;
+        end = findBlank(chunk.data(), 0, len);
+    }
+    token = oversized ? std::string_view() : std::string_view(pending);
+    return true;
+}
+
+// ========================== CLASS OutputWriter ==========================
+
+// Buffered output file; values are encoded straight into the buffer
+class OutputWriter
+{
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    FILE *file = nullptr;
+    bool owned = true;
+    std::vector<char> buffer;
+    size_t used = 0;
+    bool failed = false;
+
+public:
+    OutputWriter() {}
+    OutputWriter(const OutputWriter &) = delete;
+    OutputWriter &operator=(const OutputWriter &) = delete;
+    ~OutputWriter() { close(); }
+
+    bool open(const std::string &path);
+    // Writes to a stream already open (stdout); close() leaves it open
+    void attach(FILE *stream);
+    // Flushes and closes; false if any write failed
+    bool close();
+    void flush();
+
+    // Room for n more bytes, filled in by the caller
+    char *reserve(size_t n);
+    void write(std::string_view text);
+    void put(char c) { *reserve(1) = c; }
+    // x in reversed hex, the tools' format ("00" for zero)
+    void writeHex(const BigNum &x);
+};
+
+inline bool OutputWriter::open(const std::string &path)
+{
+    close();
+    file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    owned = true;
+    buffer.resize(BUFFER_SIZE);
+    used = 0;
+    failed = false;
+    return true;
+}
+
+inline void OutputWriter::attach(FILE *stream)
+{
+    close();
+    file = stream;
+    owned = false;
+    buffer.resize(BUFFER_SIZE);
+    used = 0;
+    failed = false;
+}
+
+inline bool OutputWriter::close()
+{
+    if (!file)
+        return !failed;
+    flush();
+    if ((owned ? fclose(file) : fflush(file)) != 0)
+        failed = true;
+    file = nullptr;
+    return !failed;
+}
+
+inline void OutputWriter::flush()
+{
+    if (file && used && fwrite(buffer.data(), 1, used, file) != used)
+        failed = true;
+    used = 0;
+}
+
+// Room for n more bytes, growing the buffer for values larger than it
+inline char *OutputWriter::reserve(size_t n)
+{
+    if (used + n > buffer.size())
+    {
+        flush();
+        if (n > buffer.size())
+            buffer.resize(n);
+    }
+    char *p = buffer.data() + used;
+    used += n;
+    return p;
+}
+
+inline void OutputWriter::write(std::string_view text)
+{
+    if (!text.empty())
+        memcpy(reserve(text.size()), text.data(), text.size());
+}
+
+inline void OutputWriter::writeHex(const BigNum &x)
+{
+    const std::vector<int> &d = x.getDigits();
+    size_t n = d.size();
+    while (n > 1 && d[n - 1] == 0)
+        n--;
+    if (n == 0 || (n == 1 && d[0] == 0))
+    {
+        write("00");
+        return;
+    }
+    bool odd = d[n - 1] < 16; // top nibble is a leading zero
+    char *p = reserve(2 * n);
+    hexEncodeReversed(d.data(), n, p);
+    if (odd)
+        used--;
+}
+
+#endif
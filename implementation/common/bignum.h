@@ -0,0 +1,1332 @@
+#ifndef BIGNUM_H
+#define BIGNUM_H
+
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "const_time.h"
+#include "fixed_bignum.h"
+#include "hex_codec.h"
+#include "ntt.h"
+#include "scratch_arena.h"
+#include "simd_mont.h"
+#include "special_mod.h"
+#include "stats.h"
+#include "tuning.h"
+
+// Shared arithmetic core for the four tools. Header-only so every tool still
+// builds as a single translation unit: g++ main.cpp -o main
+
+typedef uint32_t limb_t;
+typedef uint64_t dlimb_t;
+
+// ========================== Limb multiplication ==========================
+
+// out[0 .. na + nb) = a * b; out must not alias an operand
+inline void limbsMul(limb_t *out, const limb_t *a, size_t na, const limb_t *b, size_t nb)
+{
+    STATS_COUNT(MUL);
+#ifdef NTT_AVAILABLE
+    if (std::min(na, nb) >= tuning().nttMulLimbs)
+    {
+        nttMultiply(out, a, na, b, nb);
+        return;
+    }
+#endif
+    std::fill(out, out + na + nb, 0);
+    for (size_t i = 0; i < na; i++)
+    {
+        dlimb_t carry = 0;
+        for (size_t j = 0; j < nb; j++)
+        {
+            dlimb_t cur = (dlimb_t)a[i] * b[j] + out[i + j] + carry;
+            out[i + j] = (limb_t)cur;
+            carry = cur >> 32;
+        }
+        out[i + nb] = (limb_t)carry;
+    }
+}
+
+// out[0 .. 2n) = a^2: each cross product a[i] * a[j] (i < j) is computed
+// once and doubled, then the squares are added
+inline void limbsSqr(limb_t *out, const limb_t *a, size_t n)
+{
+    STATS_COUNT(SQR);
+#ifdef NTT_AVAILABLE
+    if (n >= tuning().nttMulLimbs)
+    {
+        nttMultiply(out, a, n, a, n);
+        return;
+    }
+#endif
+    std::fill(out, out + 2 * n, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        dlimb_t carry = 0;
+        for (size_t j = i + 1; j < n; j++)
+        {
+            dlimb_t cur = (dlimb_t)a[i] * a[j] + out[i + j] + carry;
+            out[i + j] = (limb_t)cur;
+            carry = cur >> 32;
+        }
+        out[i + n] = (limb_t)carry;
+    }
+
+    limb_t carry = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        dlimb_t sq = (dlimb_t)a[i] * a[i];
+        dlimb_t lo = ((dlimb_t)out[2 * i] << 1) + (limb_t)sq + carry;
+        dlimb_t hi = ((dlimb_t)out[2 * i + 1] << 1) + (sq >> 32) + (lo >> 32);
+        out[2 * i] = (limb_t)lo;
+        out[2 * i + 1] = (limb_t)hi;
+        carry = (limb_t)(hi >> 32);
+    }
+}
+
+
+// ========================== CLASS BigNum ==========================
+
+class BigNum
+{
+private:
+    std::vector<int> digits;
+
+    void trim();
+    void assignLimbs(const limb_t *limbs, size_t n);
+    void divMod(const BigNum &m, BigNum *quot, BigNum &rem) const;
+    void divModNewton(const BigNum &m, BigNum *quot, BigNum &rem) const;
+    static void reciprocal(BigNum &v, const BigNum &m, size_t k);
+    static BigNum modInverseOdd(const BigNum &a, const BigNum &m);
+
+public:
+    BigNum();
+    BigNum(long long val);
+    BigNum(std::string_view hexStr);
+    static BigNum fromBytes(const uint8_t *bytes, size_t n);
+    void assignBytes(const uint8_t *bytes, size_t n); // reuses the digit buffer
+    static BigNum fromLimbs(const limb_t *limbs, size_t n);
+
+    // Reversed hex, least significant digit first; whitespace is skipped.
+    // parseReversedHex returns false on any other character (reporting its
+    // offset), fromReversedHex throws std::invalid_argument naming it.
+    bool parseReversedHex(std::string_view text, size_t *badOffset = nullptr);
+    void fromReversedHex(std::string_view hexStr);
+    std::string toReversedHex() const;
+    void toLimbs(limb_t *out, size_t n) const;
+    size_t limbCount() const { return (digits.size() + 3) / 4; }
+    int cmp(const BigNum &b) const;
+    bool isZero() const;
+    bool isOdd() const;
+    int bitLength() const;
+    bool testBit(int i) const;
+    BigNum div2() const;
+
+    BigNum operator+(const BigNum &b) const;
+    BigNum operator-(const BigNum &b) const;
+    BigNum operator*(const BigNum &b) const;
+    BigNum operator%(const BigNum &b) const;
+    BigNum operator/(const BigNum &b) const;
+
+    // In-place forms: results go into existing buffers, so a caller that
+    // reuses its operands allocates nothing once their capacity has grown.
+    // out must not alias an operand.
+    BigNum &operator+=(const BigNum &b);
+    BigNum &operator-=(const BigNum &b); // requires *this >= b
+    static void mulTo(BigNum &out, const BigNum &a, const BigNum &b);
+    static void sqrTo(BigNum &out, const BigNum &a);
+    void reduceInto(BigNum &out, const BigNum &m) const;
+    void divideInto(BigNum &quot, BigNum &rem, const BigNum &m) const; // one division for both
+
+    static BigNum gcd(const BigNum &a, const BigNum &b);
+    static BigNum modInverse(const BigNum &a, const BigNum &m);
+    static BigNum modPow(const BigNum &base, const BigNum &exp, const BigNum &mod);
+    static int jacobi(const BigNum &a, const BigNum &n);
+    const std::vector<int> &getDigits() const { return digits; }
+};
+
+// ========================== BigNum Implementation ==========================
+
+inline BigNum::BigNum() { digits = {0}; }
+
+inline BigNum::BigNum(long long val)
+{
+    digits.clear();
+    if (val == 0)
+    {
+        digits.push_back(0);
+        return;
+    }
+    while (val > 0)
+    {
+        digits.push_back(val % 256);
+        val /= 256;
+    }
+}
+
+inline BigNum::BigNum(std::string_view hexStr) { fromReversedHex(hexStr); }
+
+// Little-endian bytes, i.e. already in digit order
+inline BigNum BigNum::fromBytes(const uint8_t *bytes, size_t n)
+{
+    BigNum r;
+    r.assignBytes(bytes, n);
+    return r;
+}
+
+inline void BigNum::assignBytes(const uint8_t *bytes, size_t n)
+{
+    while (n > 1 && bytes[n - 1] == 0)
+        n--;
+    if (n == 0)
+        digits.assign(1, 0);
+    else
+        digits.assign(bytes, bytes + n);
+}
+
+// Little-endian 32-bit limbs
+inline BigNum BigNum::fromLimbs(const limb_t *limbs, size_t n)
+{
+    BigNum r;
+    r.assignLimbs(limbs, n);
+    return r;
+}
+
+inline void BigNum::assignLimbs(const limb_t *limbs, size_t n)
+{
+    digits.resize(4 * n);
+    for (size_t i = 0; i < 4 * n; i++)
+        digits[i] = (limbs[i / 4] >> (8 * (i % 4))) & 0xFF;
+    trim();
+    if (digits.empty())
+        digits.assign(1, 0);
+}
+
+inline void BigNum::toLimbs(limb_t *out, size_t n) const
+{
+    std::fill(out, out + n, 0);
+    for (size_t i = 0; i < digits.size() && i / 4 < n; i++)
+        out[i / 4] |= (limb_t)digits[i] << (8 * (i % 4));
+}
+
+// Decodes straight into digits. Surrounding whitespace (line ends, padding)
+// is trimmed off the view; only whitespace inside a value costs a copy.
+inline bool BigNum::parseReversedHex(std::string_view text, size_t *badOffset)
+{
+    size_t begin = 0, end = text.size();
+    while (begin < end && isspace((unsigned char)text[begin]))
+        begin++;
+    while (end > begin && isspace((unsigned char)text[end - 1]))
+        end--;
+    std::string_view s = text.substr(begin, end - begin);
+
+    digits.resize(std::max<size_t>((s.size() + 1) / 2, 1));
+    digits[0] = 0;
+    size_t pos = hexDecodeReversed(s.data(), s.size(), digits.data());
+    if (pos < s.size() && isspace((unsigned char)s[pos]))
+    {
+        // Whitespace inside the value: drop it and decode what is left
+        ScratchArena::Frame frame;
+        char *packed = frame.alloc<char>(s.size());
+        size_t n = 0;
+        pos = s.size();
+        for (size_t i = 0; i < s.size() && pos == s.size(); i++)
+        {
+            if (hexValue(s[i]) >= 0)
+                packed[n++] = s[i];
+            else if (!isspace((unsigned char)s[i]))
+                pos = i;
+        }
+        if (pos == s.size())
+        {
+            digits.resize(std::max<size_t>((n + 1) / 2, 1));
+            digits[0] = 0;
+            hexDecodeReversed(packed, n, digits.data());
+        }
+    }
+    if (pos < s.size())
+    {
+        digits.assign(1, 0);
+        if (badOffset)
+            *badOffset = begin + pos;
+        return false;
+    }
+    trim();
+    return true;
+}
+
+inline void BigNum::fromReversedHex(std::string_view hexStr)
+{
+    size_t bad = 0;
+    if (!parseReversedHex(hexStr, &bad))
+        throw std::invalid_argument("Malformed hex value: unexpected '" + std::string(1, hexStr[bad]) +
+                                    "' at offset " + std::to_string(bad));
+}
+
+inline std::string BigNum::toReversedHex() const
+{
+    size_t n = digits.size();
+    while (n > 1 && digits[n - 1] == 0)
+        n--;
+    if (n == 0 || (n == 1 && digits[0] == 0))
+        return "00";
+
+    std::string out(2 * n, '0');
+    hexEncode(digits.data(), n, &out[0]);
+    if (digits[n - 1] < 16)
+        out.erase(0, 1);
+    return out;
+}
+
+inline int BigNum::cmp(const BigNum &b) const
+{
+    if (digits.size() != b.digits.size())
+        return digits.size() < b.digits.size() ? -1 : 1;
+    for (int i = digits.size() - 1; i >= 0; i--)
+        if (digits[i] != b.digits[i])
+            return digits[i] < b.digits[i] ? -1 : 1;
+    return 0;
+}
+
+inline bool BigNum::isZero() const { return digits.empty() || (digits.size() == 1 && digits[0] == 0); }
+inline bool BigNum::isOdd() const { return digits[0] & 1; }
+
+inline int BigNum::bitLength() const
+{
+    if (isZero())
+        return 0;
+    int bits = (digits.size() - 1) * 8;
+    for (int top = digits.back(); top > 0; top >>= 1)
+        bits++;
+    return bits;
+}
+
+inline bool BigNum::testBit(int i) const
+{
+    size_t d = i / 8;
+    return d < digits.size() && (digits[d] >> (i % 8)) & 1;
+}
+
+inline BigNum BigNum::div2() const
+{
+    BigNum r = *this;
+    int carry = 0;
+    for (int i = r.digits.size() - 1; i >= 0; i--)
+    {
+        int cur = r.digits[i] + carry * 256;
+        r.digits[i] = cur / 2;
+        carry = cur % 2;
+    }
+    while (r.digits.size() > 1 && r.digits.back() == 0)
+        r.digits.pop_back();
+    return r;
+}
+
+inline void BigNum::trim()
+{
+    while (digits.size() > 1 && digits.back() == 0)
+        digits.pop_back();
+}
+
+inline BigNum BigNum::operator+(const BigNum &b) const
+{
+    BigNum r = *this;
+    r += b;
+    return r;
+}
+
+inline BigNum BigNum::operator-(const BigNum &b) const
+{
+    BigNum r = *this;
+    r -= b;
+    return r;
+}
+
+inline BigNum BigNum::operator*(const BigNum &b) const
+{
+    BigNum r;
+    mulTo(r, *this, b);
+    return r;
+}
+
+inline BigNum BigNum::operator%(const BigNum &m) const
+{
+    if (m.isZero())
+        return BigNum(0);
+    if (this->cmp(m) < 0)
+        return *this;
+
+    BigNum rem;
+    divMod(m, nullptr, rem);
+    return rem;
+}
+
+inline BigNum BigNum::operator/(const BigNum &b) const
+{
+    if (b.isZero())
+        throw std::runtime_error("Division by zero");
+    if (this->cmp(b) < 0)
+        return BigNum(0);
+
+    BigNum quotient, rem;
+    divMod(b, &quotient, rem);
+    return quotient;
+}
+
+inline BigNum &BigNum::operator+=(const BigNum &b)
+{
+    size_t n = std::max(digits.size(), b.digits.size());
+    digits.resize(n + 1, 0);
+    int carry = 0;
+    for (size_t i = 0; i <= n; i++)
+    {
+        int sum = digits[i] + carry + (i < b.digits.size() ? b.digits[i] : 0);
+        digits[i] = sum & 0xFF;
+        carry = sum >> 8;
+    }
+    trim();
+    return *this;
+}
+
+inline BigNum &BigNum::operator-=(const BigNum &b)
+{
+    int borrow = 0;
+    for (size_t i = 0; i < digits.size(); i++)
+    {
+        int diff = digits[i] - (i < b.digits.size() ? b.digits[i] : 0) - borrow;
+        borrow = diff < 0;
+        digits[i] = diff + (borrow << 8);
+    }
+    trim();
+    return *this;
+}
+
+// Products run on 32-bit limbs in the arena: limbsMul / limbsSqr pick the
+// quadratic loop or transforms by size
+inline void BigNum::mulTo(BigNum &out, const BigNum &a, const BigNum &b)
+{
+    ScratchArena::Frame frame;
+    size_t na = a.limbCount(), nb = b.limbCount();
+    limb_t *x = frame.alloc<limb_t>(na), *y = frame.alloc<limb_t>(nb), *z = frame.alloc<limb_t>(na + nb);
+    a.toLimbs(x, na);
+    b.toLimbs(y, nb);
+    limbsMul(z, x, na, y, nb);
+    out.assignLimbs(z, na + nb);
+}
+
+inline void BigNum::sqrTo(BigNum &out, const BigNum &a)
+{
+    ScratchArena::Frame frame;
+    size_t n = a.limbCount();
+    limb_t *x = frame.alloc<limb_t>(n), *z = frame.alloc<limb_t>(2 * n);
+    a.toLimbs(x, n);
+    limbsSqr(z, x, n);
+    out.assignLimbs(z, 2 * n);
+}
+
+// out = *this mod m
+inline void BigNum::reduceInto(BigNum &out, const BigNum &m) const
+{
+    if (m.isZero())
+        out.digits.assign(1, 0);
+    else if (this->cmp(m) < 0)
+        out.digits.assign(digits.begin(), digits.end());
+    else
+        divMod(m, nullptr, out);
+}
+
+inline void BigNum::divideInto(BigNum &quot, BigNum &rem, const BigNum &m) const
+{
+    if (m.isZero())
+        throw std::runtime_error("Division by zero");
+    if (this->cmp(m) < 0)
+    {
+        rem.digits.assign(digits.begin(), digits.end());
+        quot.digits.assign(1, 0);
+    }
+    else
+        divMod(m, &quot, rem);
+}
+
+// Schoolbook long division one base-256 digit at a time; the quotient digit
+// is found by binary search on m * x <= rem. Products live in the scratch
+// arena and rem is updated in place, so only rem and quot may grow. Large
+// divisions go through a reciprocal instead.
+inline void BigNum::divMod(const BigNum &m, BigNum *quot, BigNum &rem) const
+{
+    STATS_COUNT(DIV);
+    if (m.digits.size() >= tuning().newtonDivDigits && digits.size() - m.digits.size() >= m.digits.size() / 2)
+    {
+        divModNewton(m, quot, rem);
+        return;
+    }
+
+    ScratchArena::Frame frame;
+    size_t nm = m.digits.size();
+    int *prod = frame.alloc<int>(nm + 1);
+
+    rem.digits.reserve(nm + 2);
+    rem.digits.assign(1, 0);
+    if (quot)
+        quot->digits.assign(digits.size(), 0);
+
+    for (int i = digits.size() - 1; i >= 0; i--)
+    {
+        if (rem.isZero())
+            rem.digits[0] = digits[i];
+        else
+            rem.digits.insert(rem.digits.begin(), digits[i]);
+        if (rem.cmp(m) < 0)
+            continue;
+
+        int x = 1, left = 2, right = 255;
+        while (left <= right)
+        {
+            int mid = (left + right) / 2;
+            size_t len = nm + 1;
+            int carry = 0;
+            for (size_t j = 0; j < nm; j++)
+            {
+                int cur = m.digits[j] * mid + carry;
+                prod[j] = cur & 0xFF;
+                carry = cur >> 8;
+            }
+            prod[nm] = carry;
+            while (len > 1 && prod[len - 1] == 0)
+                len--;
+
+            int c = len < rem.digits.size() ? -1 : len > rem.digits.size() ? 1 : 0;
+            for (size_t j = len; c == 0 && j-- > 0;)
+                if (prod[j] != rem.digits[j])
+                    c = prod[j] < rem.digits[j] ? -1 : 1;
+            if (c <= 0)
+            {
+                x = mid;
+                left = mid + 1;
+            }
+            else
+                right = mid - 1;
+        }
+
+        // rem -= m * x
+        int carry = 0, borrow = 0;
+        for (size_t j = 0; j < rem.digits.size(); j++)
+        {
+            int p = (j < nm ? m.digits[j] * x : 0) + carry;
+            carry = p >> 8;
+            int diff = rem.digits[j] - (p & 0xFF) - borrow;
+            borrow = diff < 0;
+            rem.digits[j] = diff + (borrow << 8);
+        }
+        rem.trim();
+        if (quot)
+            quot->digits[i] = x;
+    }
+    if (quot)
+        quot->trim();
+}
+
+// v = floor(256^k / m) for k >= 2 * |m|, by Newton's iteration
+//   v += v * (256^k - m * v) / 256^k
+// from an estimate off by about 2^-16, which stays below the target and
+// doubles the correct digits each step
+inline void BigNum::reciprocal(BigNum &v, const BigNum &m, size_t k)
+{
+    size_t nm = m.digits.size(), t = std::min<size_t>(nm, 3);
+    long long top = 1;
+    for (size_t i = 0; i < t; i++)
+        top += (long long)m.digits[nm - 1 - i] << (8 * (t - 1 - i));
+    size_t e = k + t - nm, shift = e > 7 ? e - 7 : 0;
+    BigNum est((1LL << (8 * (e - shift))) / top);
+    v.digits.assign(shift, 0);
+    v.digits.insert(v.digits.end(), est.digits.begin(), est.digits.end());
+
+    BigNum pk, mv, d;
+    pk.digits.assign(k + 1, 0);
+    pk.digits[k] = 1;
+    for (;;)
+    {
+        mulTo(mv, m, v);
+        BigNum err = pk;
+        err -= mv;
+        if (err.cmp(m) < 0)
+            return;
+        mulTo(d, v, err);
+        if (d.digits.size() > k)
+            d.digits.erase(d.digits.begin(), d.digits.begin() + k);
+        else
+            d = BigNum(1);
+        v += d;
+    }
+}
+
+// q = floor(x * v / 256^k) is at most two below the quotient. The reciprocal
+// of the last divisor is kept per thread, so reductions by one modulus
+// compute it once.
+inline void BigNum::divModNewton(const BigNum &m, BigNum *quot, BigNum &rem) const
+{
+    struct Recip
+    {
+        BigNum m, v, q, t;
+        size_t k = 0;
+    };
+    thread_local Recip r;
+
+    size_t k = std::max(digits.size(), 2 * m.digits.size());
+    if (k != r.k || r.m.cmp(m) != 0)
+    {
+        reciprocal(r.v, m, k);
+        r.m = m;
+        r.k = k;
+    }
+
+    mulTo(r.t, *this, r.v);
+    if (r.t.digits.size() > k)
+        r.q.digits.assign(r.t.digits.begin() + k, r.t.digits.end());
+    else
+        r.q.digits.assign(1, 0);
+    mulTo(r.t, r.q, m);
+    rem.digits.assign(digits.begin(), digits.end());
+    rem -= r.t;
+    while (rem.cmp(m) >= 0)
+    {
+        rem -= m;
+        for (size_t i = 0; i <= r.q.digits.size(); i++)
+        {
+            if (i == r.q.digits.size())
+                r.q.digits.push_back(0);
+            if (++r.q.digits[i] < 256)
+                break;
+            r.q.digits[i] = 0;
+        }
+    }
+    if (quot)
+        quot->digits.assign(r.q.digits.begin(), r.q.digits.end());
+}
+
+inline BigNum BigNum::gcd(const BigNum &a, const BigNum &b)
+{
+    if (b.isZero())
+        return a;
+    return gcd(b, a % b);
+}
+
+// ========================== Montgomery arithmetic ==========================
+
+// Limb helpers on little-endian arrays of n limbs
+inline int limbsCmp(const limb_t *a, const limb_t *b, size_t n)
+{
+    for (size_t i = n; i-- > 0;)
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    return 0;
+}
+
+inline limb_t limbsSub(limb_t *out, const limb_t *a, const limb_t *b, size_t n)
+{
+    limb_t borrow = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        dlimb_t d = (dlimb_t)a[i] - b[i] - borrow;
+        out[i] = (limb_t)d;
+        borrow = (limb_t)(d >> 63);
+    }
+    return borrow;
+}
+
+// x = 2x mod m for x < m
+inline void limbsDoubleMod(limb_t *x, const limb_t *m, size_t n)
+{
+    limb_t carry = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        limb_t next = x[i] >> 31;
+        x[i] = x[i] << 1 | carry;
+        carry = next;
+    }
+    if (carry || limbsCmp(x, m, n) >= 0)
+        limbsSub(x, x, m, n);
+}
+
+// x = x / 2 mod m for x < m, m odd
+inline void limbsHalveMod(limb_t *x, const limb_t *m, size_t n)
+{
+    limb_t carry = 0;
+    if (x[0] & 1)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            dlimb_t s = (dlimb_t)x[i] + m[i] + carry;
+            x[i] = (limb_t)s;
+            carry = (limb_t)(s >> 32);
+        }
+    }
+    for (size_t i = 0; i + 1 < n; i++)
+        x[i] = x[i] >> 1 | x[i + 1] << 31;
+    x[n - 1] = x[n - 1] >> 1 | carry << 31;
+}
+
+// x = x - y mod m for x, y < m
+inline void limbsSubMod(limb_t *x, const limb_t *y, const limb_t *m, size_t n)
+{
+    if (!limbsSub(x, x, y, n))
+        return;
+    limb_t carry = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        dlimb_t s = (dlimb_t)x[i] + m[i] + carry;
+        x[i] = (limb_t)s;
+        carry = (limb_t)(s >> 32);
+    }
+}
+
+// Binary extended GCD: u = x1 * a and v = x2 * a (mod m) throughout, so once
+// u reaches 0, v is the gcd and x2 the inverse. Shifts and subtractions only,
+// no BigNum division or allocation per step.
+inline BigNum BigNum::modInverseOdd(const BigNum &a, const BigNum &m)
+{
+    ScratchArena::Frame frame;
+    size_t n = m.limbCount();
+    limb_t *mod = frame.alloc<limb_t>(n), *u = frame.alloc<limb_t>(n), *v = frame.alloc<limb_t>(n);
+    limb_t *x1 = frame.alloc<limb_t>(n), *x2 = frame.alloc<limb_t>(n);
+    m.toLimbs(mod, n);
+    if (a.cmp(m) >= 0)
+        (a % m).toLimbs(u, n);
+    else
+        a.toLimbs(u, n);
+    std::copy(mod, mod + n, v);
+    std::fill(x1, x1 + n, 0);
+    std::fill(x2, x2 + n, 0);
+    x1[0] = 1;
+
+    auto isZero = [n](const limb_t *x) { return std::all_of(x, x + n, [](limb_t l) { return l == 0; }); };
+    auto shr1 = [n](limb_t *x) {
+        for (size_t i = 0; i + 1 < n; i++)
+            x[i] = x[i] >> 1 | x[i + 1] << 31;
+        x[n - 1] >>= 1;
+    };
+    while (!isZero(u))
+    {
+        while (!(u[0] & 1))
+        {
+            shr1(u);
+            limbsHalveMod(x1, mod, n);
+        }
+        while (!(v[0] & 1))
+        {
+            shr1(v);
+            limbsHalveMod(x2, mod, n);
+        }
+        if (limbsCmp(u, v, n) >= 0)
+        {
+            limbsSub(u, u, v, n);
+            limbsSubMod(x1, x2, mod, n);
+        }
+        else
+        {
+            limbsSub(v, v, u, n);
+            limbsSubMod(x2, x1, mod, n);
+        }
+    }
+    if (v[0] != 1 || !std::all_of(v + 1, v + n, [](limb_t l) { return l == 0; }))
+        return BigNum(0);
+    return fromLimbs(x2, n);
+}
+
+// Binary Jacobi symbol (a/n) for odd n > 0 on scratch limbs: strip all
+// trailing zeros with one in-place shift, then swap and subtract. Quadratic,
+// with no modular multiplication and no BigNum temporaries per step.
+inline int BigNum::jacobi(const BigNum &a, const BigNum &n)
+{
+    ScratchArena::Frame frame;
+    size_t len = n.limbCount();
+    limb_t *x = frame.alloc<limb_t>(len), *y = frame.alloc<limb_t>(len);
+    if (a.cmp(n) >= 0)
+        (a % n).toLimbs(x, len);
+    else
+        a.toLimbs(x, len);
+    n.toLimbs(y, len);
+    int t = 1;
+    while (true)
+    {
+        // Limbs at or above len are zero in both x and y
+        while (len > 1 && x[len - 1] == 0 && y[len - 1] == 0)
+            len--;
+        size_t zeroLimbs = 0;
+        while (zeroLimbs < len && x[zeroLimbs] == 0)
+            zeroLimbs++;
+        if (zeroLimbs == len)
+            break;
+        unsigned bits = __builtin_ctz(x[zeroLimbs]);
+        if (zeroLimbs)
+        {
+            std::copy(x + zeroLimbs, x + len, x);
+            std::fill(x + len - zeroLimbs, x + len, 0);
+        }
+        if (bits)
+        {
+            for (size_t i = 0; i + 1 < len; i++)
+                x[i] = x[i] >> bits | x[i + 1] << (32 - bits);
+            x[len - 1] >>= bits;
+        }
+        int r = y[0] & 7;
+        if ((bits & 1) && (r == 3 || r == 5))
+            t = -t;
+        if (limbsCmp(x, y, len) < 0)
+        {
+            std::swap(x, y);
+            if ((x[0] & 3) == 3 && (y[0] & 3) == 3)
+                t = -t;
+        }
+        limbsSub(x, x, y, len);
+    }
+    return y[0] == 1 && std::all_of(y + 1, y + len, [](limb_t l) { return l == 0; }) ? t : 0;
+}
+
+inline BigNum BigNum::modInverse(const BigNum &a, const BigNum &m)
+{
+    STATS_COUNT(INV);
+    if (m.isZero())
+        return BigNum(0);
+    if (m.isOdd())
+        return modInverseOdd(a, m);
+
+    BigNum aa = a;
+    BigNum mm = m;
+    BigNum m0 = m;
+
+    if (BigNum::gcd(aa, mm).cmp(BigNum(1)) != 0)
+    {
+        return BigNum(0);
+    }
+
+    BigNum x0(1), x1(0);
+
+    while (!mm.isZero())
+    {
+        BigNum q = aa / mm;
+
+        BigNum t = mm;
+        mm = aa % mm;
+        aa = t;
+
+        BigNum qx1 = (q * x1) % m0;
+        BigNum newx = (x0 + m0 - qx1) % m0;
+
+        x0 = x1;
+        x1 = newx;
+    }
+
+    BigNum inv = x0 % m0;
+    return inv;
+}
+
+
+// out = a * b * R^-1 mod m (CIOS), R = 2^(32n). Inputs < m; out may alias a or b.
+// t is scratch of n + 2 limbs. ConstTime applies the final subtraction by
+// mask instead of branching on its comparison.
+template <bool ConstTime = false>
+inline void montMul(limb_t *out, const limb_t *a, const limb_t *b, const limb_t *m,
+                    limb_t n0inv, size_t n, limb_t *t)
+{
+    std::fill(t, t + n + 2, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        dlimb_t carry = 0;
+        for (size_t j = 0; j < n; j++)
+        {
+            dlimb_t cur = (dlimb_t)a[j] * b[i] + t[j] + carry;
+            t[j] = (limb_t)cur;
+            carry = cur >> 32;
+        }
+        dlimb_t top = (dlimb_t)t[n] + carry;
+        t[n] = (limb_t)top;
+        t[n + 1] = (limb_t)(top >> 32);
+
+        limb_t q = t[0] * n0inv;
+        carry = ((dlimb_t)q * m[0] + t[0]) >> 32;
+        for (size_t j = 1; j < n; j++)
+        {
+            dlimb_t cur = (dlimb_t)q * m[j] + t[j] + carry;
+            t[j - 1] = (limb_t)cur;
+            carry = cur >> 32;
+        }
+        top = (dlimb_t)t[n] + carry;
+        t[n - 1] = (limb_t)top;
+        t[n] = t[n + 1] + (limb_t)(top >> 32);
+    }
+    if (ConstTime)
+    {
+        limb_t borrow = limbsSub(out, t, m, n);
+        ctSelect(out, t, out, n, (limb_t)(0 - ((t[n] == 0) & borrow)));
+        return;
+    }
+    if (t[n] || limbsCmp(t, m, n) >= 0)
+        limbsSub(out, t, m, n);
+    else
+        std::copy(t, t + n, out);
+}
+
+
+// Reduction state for one odd modulus: m, -m^-1 mod 2^32 and R^2 mod m.
+// Moduli that fill exactly 1024, 2048, 3072 or 4096 bits of limbs dispatch to
+// the FixedMont kernel for that width, very large ones to NttMont; others
+// use the generic montMul. Exponentiations run on a SIMD kernel instead when
+// the CPU has one. Special-form moduli (special_mod.h) replace the scalar
+// kernels: their products are folded, with R = 1, so a value is its own
+// Montgomery form and callers see no difference. The SIMD kernel still runs
+// their exponentiations where there is one, being faster still.
+class MontContext
+{
+private:
+    BigNum modulus;
+    std::vector<limb_t> m;
+    std::vector<limb_t> r2;
+    std::vector<limb_t> oneM;
+    std::vector<limb_t> montR2; // R^2 mod m for R = 2^(32n), kept in special form
+    limb_t n0inv;
+    void (*fixedMul)(limb_t *, const limb_t *, const limb_t *, const limb_t *, uint64_t) = nullptr;
+    uint64_t n0inv64 = 0;
+
+    std::unique_ptr<VecMont> vec;
+#ifdef NTT_AVAILABLE
+    std::unique_ptr<NttMont> ntt;
+#endif
+#ifdef SPECIAL_MOD_AVAILABLE
+    std::unique_ptr<SpecialMod> special;
+#endif
+
+    bool useSpecialForm();
+
+    void selectKernel();
+    void selectVector();
+    const limb_t *ctR2() const { return montR2.empty() ? r2.data() : montR2.data(); }
+
+public:
+    // allowSpecialForm = false keeps Montgomery form for a special modulus
+    explicit MontContext(const BigNum &mod, bool allowSpecialForm = true);
+    MontContext(const BigNum &mod, limb_t n0inv, const limb_t *r2);
+
+    size_t size() const { return m.size(); }
+    limb_t getN0inv() const { return n0inv; }
+    const limb_t *getR2() const { return r2.data(); }
+    const limb_t *one() const { return oneM.data(); }
+    const BigNum &getModulus() const { return modulus; }
+
+    int fixedWidth() const { return fixedMul ? (int)m.size() * 32 : 0; }
+    // Vector kernel used by pow, if the CPU has one for this size
+    const VecMont *vector() const { return vec.get(); }
+    // log2 of R: 32 * size(), or 0 for a special-form modulus
+    size_t rBits() const { return isSpecialForm() ? 0 : 32 * m.size(); }
+#ifdef SPECIAL_MOD_AVAILABLE
+    bool isSpecialForm() const { return special != nullptr; }
+    const SpecialMod *specialForm() const { return special.get(); }
+#else
+    bool isSpecialForm() const { return false; }
+#endif
+
+    void mul(limb_t *out, const limb_t *a, const limb_t *b, limb_t *t) const
+    {
+        STATS_PRODUCTS(a, b, 1);
+#ifdef SPECIAL_MOD_AVAILABLE
+        if (special)
+        {
+            special->mul(out, a, b);
+            return;
+        }
+#endif
+        if (fixedMul)
+            fixedMul(out, a, b, m.data(), n0inv64);
+#ifdef NTT_AVAILABLE
+        else if (ntt)
+            ntt->mul(out, a, b);
+#endif
+        else
+            montMul(out, a, b, m.data(), n0inv, m.size(), t);
+    }
+    void toMont(const BigNum &x, limb_t *out) const;
+    void fromMontInto(limb_t *out, const limb_t *x) const;
+    BigNum fromMont(const limb_t *x) const;
+    BigNum mulMod(const BigNum &a, const BigNum &b) const;
+    BigNum pow(const BigNum &base, const BigNum &exp) const;
+    void powInto(limb_t *out, const limb_t *baseM, const BigNum &exp) const;
+    BigNum pow2(const BigNum &exp) const;
+
+    // out = a * b * R^-1 mod m for R = 2^(32n) in any form, in time
+    // independent of a and b
+    void mulConstTime(limb_t *out, const limb_t *a, const limb_t *b, limb_t *t) const
+    {
+        STATS_PRODUCTS(a, b, 1);
+        if (fixedMul)
+            fixedMul(out, a, b, m.data(), n0inv64);
+        else
+            montMul<true>(out, a, b, m.data(), n0inv, m.size(), t);
+    }
+    // base^exp for an exponent of at most `bits` bits, in time independent of
+    // base and exp
+    BigNum powConstTime(const BigNum &base, const BigNum &exp, int bits) const;
+};
+
+inline MontContext::MontContext(const BigNum &mod, bool allowSpecialForm) : modulus(mod)
+{
+    STATS_PHASE(PRECOMPUTE);
+    size_t n = mod.limbCount();
+    m.resize(n);
+    mod.toLimbs(m.data(), n);
+
+    // Newton iteration doubles the correct low bits of m0^-1 each step
+    limb_t inv = m[0];
+    for (int i = 0; i < 5; i++)
+        inv *= 2 - m[0] * inv;
+    n0inv = 0 - inv;
+    selectKernel();
+    if (!allowSpecialForm || !useSpecialForm())
+    {
+        // R^2 mod m by doubling 1 a total of 64n times
+        r2.assign(n, 0);
+        r2[0] = 1;
+        for (size_t k = 0; k < 64 * n; k++)
+            limbsDoubleMod(r2.data(), m.data(), n);
+
+        oneM.assign(n, 0);
+        std::vector<limb_t> t(n + 2), unit(n, 0);
+        unit[0] = 1;
+        mul(oneM.data(), unit.data(), r2.data(), t.data());
+    }
+    selectVector();
+}
+
+// Constants supplied by a precomputation cache. A cached R^2 of 1 marks a
+// table built in the special form (R = 1); any other keeps Montgomery form.
+// If the marked form is no longer taken here (the tuning profile moved the
+// NTT threshold), the real R^2 is derived instead, so getR2() no longer
+// matches the cached one and the caller must not use the cached table.
+inline MontContext::MontContext(const BigNum &mod, limb_t n0inv, const limb_t *r2Limbs)
+    : modulus(mod), n0inv(n0inv)
+{
+    STATS_PHASE(PRECOMPUTE);
+    size_t n = mod.limbCount();
+    m.resize(n);
+    mod.toLimbs(m.data(), n);
+    selectKernel();
+    bool marked = r2Limbs[0] == 1 && std::all_of(r2Limbs + 1, r2Limbs + n, [](limb_t l) { return l == 0; });
+    if (!marked || !useSpecialForm())
+    {
+        r2.assign(r2Limbs, r2Limbs + n);
+        if (marked)
+            for (size_t k = 0; k < 64 * n; k++)
+                limbsDoubleMod(r2.data(), m.data(), n);
+        oneM.assign(n, 0);
+        std::vector<limb_t> t(n + 2), unit(n, 0);
+        unit[0] = 1;
+        mul(oneM.data(), unit.data(), r2.data(), t.data());
+    }
+    selectVector();
+}
+
+// Switches to the special-form reducer if m has one: R = 1, so R^2 mod m and
+// the Montgomery form of 1 are both 1. The fold multiplies by schoolbook, so
+// moduli in NttMont's range stay with it.
+inline bool MontContext::useSpecialForm()
+{
+#ifdef SPECIAL_MOD_AVAILABLE
+    if (m.size() >= tuning().nttMontLimbs)
+        return false;
+    special = SpecialMod::detect(m.data(), m.size());
+    if (!special)
+        return false;
+    r2.assign(m.size(), 0);
+    r2[0] = 1;
+    oneM = r2;
+    // folds take a data-dependent number of steps, so powConstTime stays in
+    // Montgomery form and needs the real R^2
+    montR2 = r2;
+    for (size_t k = 0; k < 64 * m.size(); k++)
+        limbsDoubleMod(montR2.data(), m.data(), m.size());
+    return true;
+#else
+    return false;
+#endif
+}
+
+inline void MontContext::selectKernel()
+{
+#ifdef NTT_AVAILABLE
+    if (m.size() >= tuning().nttMontLimbs)
+        ntt.reset(new NttMont(m.data(), m.size()));
+#endif
+#ifdef FIXED_BIGNUM_AVAILABLE
+    switch (m.size() * 32)
+    {
+    case 1024:
+        fixedMul = FixedMont<1024>::mulLimbs;
+        break;
+    case 2048:
+        fixedMul = FixedMont<2048>::mulLimbs;
+        break;
+    case 3072:
+        fixedMul = FixedMont<3072>::mulLimbs;
+        break;
+    case 4096:
+        fixedMul = FixedMont<4096>::mulLimbs;
+        break;
+    default:
+        return;
+    }
+    n0inv64 = FixedMont<1024>::negInverse(m[0] | (uint64_t)m[1] << 32);
+#endif
+}
+
+// The vector kernel's R^2 comes from ours by doubling up to its wider R; the
+// mixed factor R_vec^2 / R converts table entries in our form to its form
+inline void MontContext::selectVector()
+{
+    size_t n = m.size();
+    SimdKernel kind = simdKernel();
+    if (const char *name = tuning().simdKernel(n))
+        kind = std::min(kind, simdKernelNamed(name));
+    if (!VecMont::supports(kind, n))
+        return;
+    std::vector<limb_t> rr(r2), mixed(n);
+    size_t extra = 2 * (VecMont::radixBits(kind) * VecMont::digitsFor(kind, n) - rBits());
+    for (size_t k = 0; k < extra; k++)
+        limbsDoubleMod(rr.data(), m.data(), n);
+    fromMontInto(mixed.data(), rr.data());
+    vec.reset(new VecMont(kind, m.data(), n, rr.data(), mixed.data()));
+}
+
+inline void MontContext::toMont(const BigNum &x, limb_t *out) const
+{
+    ScratchArena::Frame frame;
+    limb_t *t = frame.alloc<limb_t>(m.size() + 2);
+    if (x.cmp(modulus) < 0)
+        x.toLimbs(out, m.size());
+    else
+        (x % modulus).toLimbs(out, m.size());
+    mul(out, out, r2.data(), t);
+}
+
+inline void MontContext::fromMontInto(limb_t *out, const limb_t *x) const
+{
+    ScratchArena::Frame frame;
+    size_t n = m.size();
+    limb_t *t = frame.alloc<limb_t>(n + 2), *unit = frame.alloc<limb_t>(n);
+    std::fill(unit, unit + n, 0);
+    unit[0] = 1;
+    mul(out, x, unit, t);
+}
+
+inline BigNum MontContext::fromMont(const limb_t *x) const
+{
+    ScratchArena::Frame frame;
+    limb_t *out = frame.alloc<limb_t>(m.size());
+    fromMontInto(out, x);
+    return BigNum::fromLimbs(out, m.size());
+}
+
+// a * b mod m for a, b < m: (a * b * R^-1) * R^2 * R^-1
+inline BigNum MontContext::mulMod(const BigNum &a, const BigNum &b) const
+{
+    ScratchArena::Frame frame;
+    size_t n = m.size();
+    limb_t *t = frame.alloc<limb_t>(n + 2), *x = frame.alloc<limb_t>(n), *y = frame.alloc<limb_t>(n);
+    a.toLimbs(x, n);
+    b.toLimbs(y, n);
+    mul(x, x, y, t);
+    mul(x, x, r2.data(), t);
+    return BigNum::fromLimbs(x, n);
+}
+
+inline BigNum MontContext::pow(const BigNum &base, const BigNum &exp) const
+{
+    STATS_COUNT(POW);
+    if (exp.isZero())
+        return BigNum(1);
+    if (base.cmp(modulus) >= 0)
+        return pow(base % modulus, exp);
+
+    ScratchArena::Frame frame;
+    size_t n = m.size();
+    limb_t *acc = frame.alloc<limb_t>(n);
+    if (vec)
+    {
+        limb_t *e = frame.alloc<limb_t>(exp.limbCount());
+        base.toLimbs(acc, n);
+        exp.toLimbs(e, exp.limbCount());
+        vec->pow(acc, acc, n, e, exp.bitLength());
+        return BigNum::fromLimbs(acc, n);
+    }
+    if (base.bitLength() == 2 && !base.testBit(0))
+        return pow2(exp);
+
+    toMont(base, acc);
+    powInto(acc, acc, exp);
+    return fromMont(acc);
+}
+
+// Sliding-window exponentiation over precomputed odd powers of the base, all
+// in Montgomery form; out may alias baseM. Scratch comes from the arena, so
+// this allocates nothing once the arena has grown.
+inline void MontContext::powInto(limb_t *out, const limb_t *baseM, const BigNum &exp) const
+{
+    size_t n = m.size();
+    int bits = exp.bitLength();
+    if (bits == 0)
+    {
+        std::copy(oneM.begin(), oneM.end(), out);
+        return;
+    }
+
+    ScratchArena::Frame frame;
+    limb_t *t = frame.alloc<limb_t>(n + 2);
+    if (vec)
+    {
+        limb_t *e = frame.alloc<limb_t>(exp.limbCount());
+        exp.toLimbs(e, exp.limbCount());
+        fromMontInto(out, baseM);
+        vec->pow(out, out, n, e, bits);
+        mul(out, out, r2.data(), t);
+        return;
+    }
+
+    int w = tuning().powWindow(bits);
+    limb_t *sq = frame.alloc<limb_t>(n);
+    limb_t *tbl = frame.alloc<limb_t>((size_t(1) << (w - 1)) * n);
+    std::copy(baseM, baseM + n, tbl);
+    mul(sq, tbl, tbl, t);
+    for (size_t k = 1; k < (size_t(1) << (w - 1)); k++)
+        mul(&tbl[k * n], &tbl[(k - 1) * n], sq, t);
+
+    bool started = false;
+    for (int i = bits - 1; i >= 0;)
+    {
+        if (!exp.testBit(i))
+        {
+            mul(out, out, out, t);
+            i--;
+            continue;
+        }
+        int j = std::max(i - w + 1, 0);
+        while (!exp.testBit(j))
+            j++;
+        int val = 0;
+        for (int k = i; k >= j; k--)
+            val = val << 1 | exp.testBit(k);
+        const limb_t *entry = &tbl[(val >> 1) * n];
+        if (started)
+        {
+            for (int k = j; k <= i; k++)
+                mul(out, out, out, t);
+            mul(out, out, entry, t);
+        }
+        else
+            std::copy(entry, entry + n, out);
+        started = true;
+        i = j - 1;
+    }
+}
+
+// 2^exp mod m, left to right: multiplying by the base is just a doubling
+inline BigNum MontContext::pow2(const BigNum &exp) const
+{
+    ScratchArena::Frame frame;
+    size_t n = m.size();
+    limb_t *t = frame.alloc<limb_t>(n + 2), *acc = frame.alloc<limb_t>(n);
+    std::copy(oneM.begin(), oneM.end(), acc);
+    for (int i = exp.bitLength() - 1; i >= 0; i--)
+    {
+        mul(acc, acc, acc, t);
+        if (exp.testBit(i))
+            limbsDoubleMod(acc, m.data(), n);
+    }
+    return fromMont(acc);
+}
+
+// Fixed windows over all `bits` bits (at least exp's width; a public bound
+// such as the bit length of the group order), each one w squarings and a
+// multiplication by a table entry chosen with a masked scan of the whole
+// table, entry 0 being 1. Multiplications subtract by mask. Special-form
+// moduli run in Montgomery form here, NTT-sized ones on montMul. Moving base
+// and exp in and out of BigNum is not covered: BigNum trims leading zeros.
+inline BigNum MontContext::powConstTime(const BigNum &base, const BigNum &exp, int bits) const
+{
+    STATS_COUNT(POW);
+    bits = std::max(bits, exp.bitLength());
+    if (bits == 0)
+        return BigNum(1);
+
+    ScratchArena::Frame frame;
+    size_t n = m.size(), el = (bits + 31) / 32;
+    limb_t *acc = frame.alloc<limb_t>(n), *e = frame.alloc<limb_t>(el);
+    (base.cmp(modulus) < 0 ? base : base % modulus).toLimbs(acc, n);
+    exp.toLimbs(e, el);
+    if (vec)
+    {
+        vec->powConstTime(acc, acc, n, e, el, bits);
+        return BigNum::fromLimbs(acc, n);
+    }
+
+    unsigned w = constTimeWindow(bits);
+    size_t entries = size_t(1) << w;
+    limb_t *t = frame.alloc<limb_t>(n + 2), *entry = frame.alloc<limb_t>(n);
+    limb_t *tbl = frame.alloc<limb_t>(entries * n);
+    std::fill(entry, entry + n, 0);
+    entry[0] = 1;
+    mulConstTime(tbl, entry, ctR2(), t);
+    mulConstTime(tbl + n, acc, ctR2(), t);
+    for (size_t k = 2; k < entries; k++)
+        mulConstTime(tbl + k * n, tbl + (k - 1) * n, tbl + n, t);
+
+    int windows = (bits + w - 1) / w;
+    ctLookup(acc, tbl, entries, n, ctWindow(e, el, size_t(windows - 1) * w, w));
+    for (int i = windows - 2; i >= 0; i--)
+    {
+        for (unsigned k = 0; k < w; k++)
+            mulConstTime(acc, acc, acc, t);
+        ctLookup(entry, tbl, entries, n, ctWindow(e, el, size_t(i) * w, w));
+        mulConstTime(acc, acc, entry, t);
+    }
+    std::fill(entry, entry + n, 0);
+    entry[0] = 1;
+    mulConstTime(acc, acc, entry, t);
+    return BigNum::fromLimbs(acc, n);
+}
+
+// Odd moduli go through Montgomery form; even ones keep the plain
+// square-and-multiply loop.
+inline BigNum BigNum::modPow(const BigNum &base, const BigNum &exp, const BigNum &mod)
+{
+    if (mod.cmp(BigNum(1)) == 0)
+        return BigNum(0);
+    if (mod.isOdd())
+        return MontContext(mod).pow(base, exp);
+    STATS_COUNT(POW);
+
+    // Right to left over the bits of exp; the three buffers are reused, so
+    // after the first rounds no step allocates
+    BigNum result(1), b, tmp;
+    base.reduceInto(b, mod);
+    int bits = exp.bitLength();
+    for (int i = 0; i < bits; i++)
+    {
+        if (exp.testBit(i))
+        {
+            mulTo(tmp, result, b);
+            tmp.reduceInto(result, mod);
+        }
+        if (i + 1 < bits)
+        {
+            sqrTo(tmp, b);
+            tmp.reduceInto(b, mod);
+        }
+    }
+    return result;
+}
+
+#endif
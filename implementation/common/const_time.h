@@ -0,0 +1,124 @@
+#ifndef CONST_TIME_H
+#define CONST_TIME_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+// Helpers for the constant-time exponentiation paths: no branch or memory
+// access depends on the secret values passed to them, only on their sizes.
+
+// Window width for a fixed-window exponentiation over `bits` exponent bits:
+// each window costs w squarings, one multiplication and a scan of 2^w
+// table entries
+inline unsigned constTimeWindow(int bits)
+{
+    return bits > 1024 ? 5 : bits > 64 ? 4 : bits > 16 ? 3 : 1;
+}
+
+// All ones if a == b, else 0, by arithmetic rather than a comparison
+template <class T>
+inline T ctEqualMask(size_t a, size_t b)
+{
+    uint64_t d = (uint64_t)(a ^ b);
+    return (T)(((d | (0 - d)) >> 63) - 1);
+}
+
+// Most entries a table scan takes
+const size_t CT_MAX_ENTRIES = 64;
+
+// The scan behind ctLookup over raw bytes, entries of `size` bytes, with
+// masks[k] = ctEqualMask(k, index): 32 bytes per step with AVX2, 16 with SSE2
+// (x86-64 baseline), then single bytes
+inline void ctLookupBytes(unsigned char *out, const unsigned char *table, size_t count, size_t size,
+                          const uint64_t *masks, size_t j = 0)
+{
+#if defined(__SSE2__)
+    for (; j + 16 <= size; j += 16)
+    {
+        __m128i acc = _mm_setzero_si128();
+        for (size_t k = 0; k < count; k++)
+        {
+            __m128i mask = _mm_set1_epi64x((long long)masks[k]);
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(table + k * size + j));
+            acc = _mm_or_si128(acc, _mm_and_si128(v, mask));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + j), acc);
+    }
+#endif
+    for (; j < size; j++)
+    {
+        unsigned char v = 0;
+        for (size_t k = 0; k < count; k++)
+            v |= table[k * size + j] & (unsigned char)masks[k];
+        out[j] = v;
+    }
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("avx2"))) inline void ctLookupAvx2(unsigned char *out, const unsigned char *table,
+                                                         size_t count, size_t size, const uint64_t *masks)
+{
+    size_t j = 0;
+    for (; j + 32 <= size; j += 32)
+    {
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t k = 0; k < count; k++)
+        {
+            __m256i mask = _mm256_set1_epi64x((long long)masks[k]);
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(table + k * size + j));
+            acc = _mm256_or_si256(acc, _mm256_and_si256(v, mask));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + j), acc);
+    }
+    ctLookupBytes(out, table, count, size, masks, j);
+}
+#endif
+
+// out = table[index] for count (at most CT_MAX_ENTRIES) entries of len words
+// each, reading every entry; no entry matches an index >= count, giving 0
+template <class T>
+inline void ctLookup(T *out, const T *table, size_t count, size_t len, size_t index)
+{
+    uint64_t masks[CT_MAX_ENTRIES];
+    for (size_t k = 0; k < count; k++)
+        masks[k] = ctEqualMask<uint64_t>(k, index);
+    unsigned char *o = reinterpret_cast<unsigned char *>(out);
+    const unsigned char *t = reinterpret_cast<const unsigned char *>(table);
+#if defined(__x86_64__) && defined(__GNUC__)
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2)
+    {
+        ctLookupAvx2(o, t, count, len * sizeof(T), masks);
+        return;
+    }
+#endif
+    ctLookupBytes(o, t, count, len * sizeof(T), masks);
+}
+
+// out = keep ? a : b where keep is 0 or all ones
+template <class T>
+inline void ctSelect(T *out, const T *a, const T *b, size_t len, T keep)
+{
+    for (size_t j = 0; j < len; j++)
+        out[j] = (a[j] & keep) | (b[j] & ~keep);
+}
+
+// Bits [pos, pos + w) of a little-endian limb array of `limbs` limbs; pos and
+// w are public, so only the values read are secret
+inline uint32_t ctWindow(const uint32_t *x, size_t limbs, size_t pos, unsigned w)
+{
+    size_t i = pos / 32, off = pos % 32;
+    uint64_t v = i < limbs ? x[i] : 0;
+    if (i + 1 < limbs)
+        v |= (uint64_t)x[i + 1] << 32;
+    return (uint32_t)(v >> off) & ((1u << w) - 1);
+}
+
+#endif
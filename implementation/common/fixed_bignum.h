@@ -0,0 +1,114 @@
+#ifndef FIXED_BIGNUM_H
+#define FIXED_BIGNUM_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+// Fixed-width numbers for the standard group sizes: 64-bit limbs in a
+// std::array, so values live on the stack and every loop has a compile-time
+// trip count. Values are exchanged with the 32-bit limb arrays used elsewhere
+// by memcpy (same bytes on little-endian hosts for an even number of 32-bit
+// limbs), so tables built or cached by MontContext work unchanged.
+
+#if defined(__SIZEOF_INT128__)
+#define FIXED_BIGNUM_AVAILABLE 1
+
+typedef unsigned __int128 u128;
+
+// ========================== CLASS FixedBigNum ==========================
+
+template <size_t Bits>
+struct FixedBigNum
+{
+    static const size_t LIMBS = Bits / 64;
+    std::array<uint64_t, LIMBS> limbs;
+
+    void load(const uint32_t *src) { memcpy(limbs.data(), src, Bits / 8); }
+    void store(uint32_t *dst) const { memcpy(dst, limbs.data(), Bits / 8); }
+
+    int cmp(const FixedBigNum &b) const
+    {
+        for (size_t i = LIMBS; i-- > 0;)
+            if (limbs[i] != b.limbs[i])
+                return limbs[i] < b.limbs[i] ? -1 : 1;
+        return 0;
+    }
+};
+
+// ========================== CLASS FixedMont ==========================
+
+// Montgomery multiplication specialised for one width, R = 2^Bits
+template <size_t Bits>
+struct FixedMont
+{
+    static const size_t N = Bits / 64;
+    typedef FixedBigNum<Bits> Num;
+
+    // -m^-1 mod 2^64
+    static uint64_t negInverse(uint64_t m0)
+    {
+        uint64_t inv = m0;
+        for (int i = 0; i < 6; i++)
+            inv *= 2 - m0 * inv;
+        return 0 - inv;
+    }
+
+    // out = a * b * R^-1 mod m; out may alias a or b. Each row interleaves
+    // the a * b[i] and q * m products (two independent carry chains).
+    static void mul(Num &out, const Num &a, const Num &b, const Num &m, uint64_t n0inv)
+    {
+        uint64_t t[N + 1] = {0};
+        for (size_t i = 0; i < N; i++)
+        {
+            uint64_t bi = b.limbs[i];
+            u128 x = (u128)a.limbs[0] * bi + t[0];
+            uint64_t c1 = (uint64_t)(x >> 64);
+            uint64_t q = (uint64_t)x * n0inv;
+            u128 y = (u128)q * m.limbs[0] + (uint64_t)x;
+            uint64_t c2 = (uint64_t)(y >> 64);
+#pragma GCC unroll 64
+            for (size_t j = 1; j < N; j++)
+            {
+                x = (u128)a.limbs[j] * bi + t[j] + c1;
+                c1 = (uint64_t)(x >> 64);
+                y = (u128)q * m.limbs[j] + (uint64_t)x + c2;
+                c2 = (uint64_t)(y >> 64);
+                t[j - 1] = (uint64_t)y;
+            }
+            x = (u128)t[N] + c1 + c2;
+            t[N - 1] = (uint64_t)x;
+            t[N] = (uint64_t)(x >> 64);
+        }
+
+        // t < 2m: subtract m once if needed, selected by mask so the time
+        // does not depend on the operands
+        uint64_t borrow = 0;
+        Num d;
+#pragma GCC unroll 64
+        for (size_t j = 0; j < N; j++)
+        {
+            u128 diff = (u128)t[j] - m.limbs[j] - borrow;
+            d.limbs[j] = (uint64_t)diff;
+            borrow = (uint64_t)(diff >> 64) & 1;
+        }
+        uint64_t keep = 0 - ((t[N] == 0) & borrow);
+        for (size_t j = 0; j < N; j++)
+            out.limbs[j] = (t[j] & keep) | (d.limbs[j] & ~keep);
+    }
+
+    // Kernel over 32-bit limb arrays for MontContext::mul
+    static void mulLimbs(uint32_t *out, const uint32_t *a, const uint32_t *b, const uint32_t *m, uint64_t n0inv)
+    {
+        Num x, y, mod, r;
+        x.load(a);
+        y.load(b);
+        mod.load(m);
+        mul(r, x, y, mod, n0inv);
+        r.store(out);
+    }
+};
+
+#endif
+
+#endif
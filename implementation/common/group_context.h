@@ -0,0 +1,290 @@
+#ifndef GROUP_CONTEXT_H
+#define GROUP_CONTEXT_H
+
+#include <memory>
+#include <vector>
+
+#include "bignum.h"
+#include "multi_exp.h"
+#include "precomp_cache.h"
+
+// ========================== CLASS FixedBaseTable ==========================
+
+// base^(d * 2^(w*i)) in Montgomery form for every window i and digit
+// d = 1 .. 2^w - 1, so base^e costs one multiplication per nonzero window of e
+// and no squarings. The limbs are either owned or borrowed (e.g. from a
+// mapped cache file). New tables take w from the tuning profile.
+class FixedBaseTable
+{
+private:
+    const MontContext *mont = nullptr;
+    std::vector<limb_t> owned;
+    const limb_t *data = nullptr;
+    uint32_t windows = 0;
+    uint32_t windowBits = 0;
+    uint32_t digits = 0; // entries per window, 2^windowBits - 1
+
+public:
+    // Bytes of a table for `bits`-bit exponents over a `limbs`-limb modulus
+    static size_t bytesFor(int bits, size_t limbs);
+
+    void build(const MontContext &mont, const BigNum &base, int bits);
+    void attach(const MontContext &mont, const limb_t *limbs, uint32_t windows, uint32_t windowBits);
+
+    bool empty() const { return data == nullptr; }
+    bool covers(const BigNum &exp) const { return data && exp.bitLength() <= (int)coveredBits(); }
+    uint32_t coveredBits() const { return windows * windowBits; }
+    BigNum pow(const BigNum &exp) const;
+    // Whether powConstTime runs here: a special-form table would be folded on
+    // the scalar path, in data-dependent time
+    bool constTimeCapable() const;
+    // pow in time independent of exp, for exponents of at most `bits` bits
+    BigNum powConstTime(const BigNum &exp, int bits) const;
+
+    uint32_t getWindows() const { return windows; }
+    uint32_t getWindowBits() const { return windowBits; }
+    const std::vector<limb_t> &limbs() const { return owned; }
+    size_t bytes() const { return (size_t)windows * digits * mont->size() * sizeof(limb_t); }
+};
+
+inline size_t FixedBaseTable::bytesFor(int bits, size_t limbs)
+{
+    uint32_t w = tuning().combWindow(bits);
+    return (size_t)(bits + w - 1) / w * ((1u << w) - 1) * limbs * sizeof(limb_t);
+}
+
+// Table for exponents of up to `bits` bits
+inline void FixedBaseTable::build(const MontContext &ctx, const BigNum &base, int bits)
+{
+    STATS_PHASE(PRECOMPUTE);
+    mont = &ctx;
+    size_t n = ctx.size();
+    windowBits = tuning().combWindow(bits);
+    digits = (1u << windowBits) - 1;
+    windows = (bits + windowBits - 1) / windowBits;
+    owned.resize(windows * digits * n);
+
+    std::vector<limb_t> t(n + 2), b(n);
+    ctx.toMont(base, b.data());
+    for (uint32_t i = 0; i < windows; i++)
+    {
+        limb_t *entry = &owned[i * digits * n];
+        std::copy(b.begin(), b.end(), entry);
+        for (size_t d = 1; d < digits; d++)
+            ctx.mul(entry + d * n, entry + (d - 1) * n, b.data(), t.data());
+        // next window base: base^(2^(w*(i+1))) = base^((2^w - 1) * 2^(w*i)) * base^(2^(w*i))
+        ctx.mul(b.data(), entry + (digits - 1) * n, b.data(), t.data());
+    }
+    data = owned.data();
+}
+
+inline void FixedBaseTable::attach(const MontContext &ctx, const limb_t *limbs, uint32_t count, uint32_t bits)
+{
+    mont = &ctx;
+    owned.clear();
+    data = limbs;
+    windows = count;
+    windowBits = bits;
+    digits = (1u << bits) - 1;
+}
+
+// Caller checks covers(exp) first
+inline BigNum FixedBaseTable::pow(const BigNum &exp) const
+{
+    STATS_COUNT(POW);
+    ScratchArena::Frame frame;
+    size_t n = mont->size();
+    const VecMont *vec = mont->vector();
+    if (vec && vec->getKind() == SimdKernel::Ifma)
+    {
+        // entries are in MontContext form, so each window costs two vector
+        // multiplications; only IFMA is fast enough for that to pay off
+        uint64_t *acc = frame.alloc<uint64_t>(vec->paddedDigits());
+        std::copy(vec->one(), vec->one() + vec->paddedDigits(), acc);
+        for (uint32_t i = 0; i < windows; i++)
+        {
+            uint32_t d = 0;
+            for (uint32_t k = 0; k < windowBits; k++)
+                d |= (uint32_t)exp.testBit(i * windowBits + k) << k;
+            if (d)
+                vec->mulMixed(acc, data + (i * digits + d - 1) * n, n);
+        }
+        vec->fromMont(acc);
+        limb_t *out = frame.alloc<limb_t>(n);
+        vec->toLimbs(out, n, acc);
+        return BigNum::fromLimbs(out, n);
+    }
+
+    limb_t *t = frame.alloc<limb_t>(n + 2), *acc = frame.alloc<limb_t>(n);
+    std::copy(mont->one(), mont->one() + n, acc);
+    for (uint32_t i = 0; i < windows; i++)
+    {
+        uint32_t d = 0;
+        for (uint32_t k = 0; k < windowBits; k++)
+            d |= (uint32_t)exp.testBit(i * windowBits + k) << k;
+        if (d)
+            mont->mul(acc, acc, data + (i * digits + d - 1) * n, t);
+    }
+    return mont->fromMont(acc);
+}
+
+inline bool FixedBaseTable::constTimeCapable() const
+{
+    if (!data)
+        return false;
+    const VecMont *vec = mont->vector();
+    return !mont->isSpecialForm() || (vec && vec->getKind() == SimdKernel::Ifma);
+}
+
+// Every window multiplies, by 1 when its digit is 0, and its entry is found
+// by a masked scan of all of them. Caller checks constTimeCapable() and that
+// the table covers `bits` bits.
+inline BigNum FixedBaseTable::powConstTime(const BigNum &exp, int bits) const
+{
+    STATS_COUNT(POW);
+    ScratchArena::Frame frame;
+    size_t n = mont->size(), el = (bits + 31) / 32;
+    limb_t *e = frame.alloc<limb_t>(el), *entry = frame.alloc<limb_t>(n);
+    exp.toLimbs(e, el);
+    uint32_t used = (bits + windowBits - 1) / windowBits;
+    auto select = [&](uint32_t i) {
+        uint32_t d = ctWindow(e, el, i * windowBits, windowBits);
+        // digit d sits at index d - 1; d = 0 matches no entry and takes 1
+        ctLookup(entry, data + i * digits * n, digits, n, (size_t)d - 1);
+        limb_t zero = ctEqualMask<limb_t>(d, 0);
+        for (size_t j = 0; j < n; j++)
+            entry[j] |= mont->one()[j] & zero;
+    };
+
+    const VecMont *vec = mont->vector();
+    if (vec && vec->getKind() == SimdKernel::Ifma)
+    {
+        uint64_t *acc = frame.alloc<uint64_t>(vec->paddedDigits());
+        std::copy(vec->one(), vec->one() + vec->paddedDigits(), acc);
+        for (uint32_t i = 0; i < used; i++)
+        {
+            select(i);
+            vec->mulMixed(acc, entry, n);
+        }
+        vec->fromMont(acc);
+        limb_t *out = frame.alloc<limb_t>(n);
+        vec->toLimbs(out, n, acc);
+        return BigNum::fromLimbs(out, n);
+    }
+
+    limb_t *t = frame.alloc<limb_t>(n + 2), *acc = frame.alloc<limb_t>(n);
+    std::copy(mont->one(), mont->one() + n, acc);
+    for (uint32_t i = 0; i < used; i++)
+    {
+        select(i);
+        mont->mulConstTime(acc, acc, entry, t);
+    }
+    return mont->fromMont(acc);
+}
+
+// ========================== CLASS GroupContext ==========================
+
+// Everything that depends only on (p, g): the Montgomery context for p and a
+// fixed-base table for g, taken from the precomputation cache when possible.
+// Building the table costs several exponentiations, so it is only built when
+// it can be stored for the next run, and by default only for a group the
+// cache has seen before (PrecompCache::sighted): a one-off group costs one
+// empty marker file, not a table.
+class GroupContext
+{
+public:
+    // What to do when the cache holds no table for the group
+    enum TableBuild
+    {
+        NO_TABLE,
+        TABLE_IF_SEEN, // build if an earlier run or caller has seen the group
+        BUILD_TABLE,
+    };
+
+private:
+    BigNum p;
+    BigNum g;
+    std::unique_ptr<MontContext> mont;
+    MappedFile mapping;
+    FixedBaseTable table;
+
+public:
+    GroupContext(const BigNum &p, const BigNum &g, TableBuild build = TABLE_IF_SEEN);
+
+    BigNum powG(const BigNum &exp) const;
+    // g^exp in time independent of exp, which has at most `bits` bits (more
+    // only at the cost of revealing its width); p must be odd
+    BigNum powGConstTime(const BigNum &exp, int bits) const;
+    void powGBatch(BigNum *out, const BigNum *exps, size_t count) const;
+    bool hasTable() const { return !table.empty(); }
+    const MontContext *getMont() const { return mont.get(); }
+};
+
+inline GroupContext::GroupContext(const BigNum &p, const BigNum &g, TableBuild build) : p(p), g(g)
+{
+    if (!p.isOdd() || p.cmp(BigNum(1)) <= 0)
+        return;
+    if (g.cmp(p) >= 0)
+        this->g = g % p;
+
+    if (const CacheHeader *h = PrecompCache::load(mapping, p, this->g))
+    {
+        const unsigned char *base = mapping.bytes();
+        const limb_t *r2 = reinterpret_cast<const limb_t *>(base + h->r2Offset);
+        mont.reset(new MontContext(p, h->n0inv, r2));
+        // a table of another width or another form (the tuning profile
+        // changed) is rebuilt
+        if (h->windowBits == tuning().combWindow(p.bitLength()) && std::equal(r2, r2 + mont->size(), mont->getR2()))
+        {
+            table.attach(*mont, reinterpret_cast<const limb_t *>(base + h->tableOffset), h->windows, h->windowBits);
+            return;
+        }
+    }
+    else
+        mont.reset(new MontContext(p));
+
+    if (build == NO_TABLE || (build == TABLE_IF_SEEN && !PrecompCache::sighted(p, this->g)))
+        return;
+    std::string path = PrecompCache::pathFor(p, this->g);
+    if (path.empty())
+        return;
+    table.build(*mont, this->g, p.bitLength());
+    mapping.close();
+    PrecompCache::store(path, *mont, this->g, table.getWindowBits(), table.getWindows(), table.limbs());
+}
+
+// g^exp mod p; exponents wider than the table use the generic path
+inline BigNum GroupContext::powG(const BigNum &exp) const
+{
+    if (!mont)
+        return BigNum::modPow(g, exp, p);
+    if (!table.covers(exp))
+        return mont->pow(g, exp);
+    return table.pow(exp);
+}
+
+inline BigNum GroupContext::powGConstTime(const BigNum &exp, int bits) const
+{
+    if (!mont)
+        throw std::invalid_argument("Constant-time exponentiation needs an odd modulus greater than 1");
+    bits = std::max(bits, exp.bitLength());
+    if (table.constTimeCapable() && bits <= (int)table.coveredBits())
+        return table.powConstTime(exp, bits);
+    return mont->powConstTime(g, exp, bits);
+}
+
+// g^exps[i] for a batch: the table when there is one (cheaper per exponent
+// than a full exponentiation), otherwise lanes of the multi-buffer engine
+inline void GroupContext::powGBatch(BigNum *out, const BigNum *exps, size_t count) const
+{
+    if (!mont || hasTable())
+    {
+        for (size_t i = 0; i < count; i++)
+            out[i] = powG(exps[i]);
+        return;
+    }
+    std::vector<BigNum> bases(count, g);
+    MultiExp(*mont).pow(out, bases.data(), exps, count);
+}
+
+#endif
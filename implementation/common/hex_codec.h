@@ -0,0 +1,128 @@
+#ifndef HEX_CODEC_H
+#define HEX_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Hex text <-> base-256 digits, 16 characters per step with SSE2 (part of the
+// x86-64 baseline, so no dispatch) and a scalar path for tails and other
+// targets. Reversed hex, the tools' input format, puts the least significant
+// nibble first, so digit i is text[2i] | text[2i + 1] << 4 and decoding needs
+// no reversal.
+
+// Value of one hex character, -1 if it is not one; constexpr so that
+// compile-time tables (project2's named groups) decode with it too
+constexpr int hexValue(unsigned char c)
+{
+    if (unsigned(c - '0') < 10)
+        return c - '0';
+    c |= 0x20;
+    if (unsigned(c - 'a') < 6)
+        return c - 'a' + 10;
+    return -1;
+}
+
+// digits[0 .. (n + 1) / 2) from n characters of reversed hex. Returns n, or
+// the offset of the first character that is not a hex digit.
+inline size_t hexDecodeReversed(const char *text, size_t n, int *digits)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + i));
+        // Bytes >= 0x80 compare as negative, so they fail both ranges
+        __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+        __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                        _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+        __m128i isAlpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                        _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+        if (_mm_movemask_epi8(_mm_or_si128(isDigit, isAlpha)) != 0xFFFF)
+            break;
+        __m128i nib = _mm_or_si128(_mm_and_si128(isDigit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+                                   _mm_and_si128(isAlpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+
+        // 16-bit lane k holds nibbles 2k (low byte) and 2k + 1 (high byte)
+        __m128i bytes = _mm_or_si128(_mm_and_si128(nib, _mm_set1_epi16(0x00FF)),
+                                     _mm_and_si128(_mm_srli_epi16(nib, 4), _mm_set1_epi16(0x00F0)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(digits + i / 2), _mm_unpacklo_epi16(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(digits + i / 2 + 4), _mm_unpackhi_epi16(bytes, zero));
+    }
+#endif
+    for (; i < n; i += 2)
+    {
+        int lo = hexValue(text[i]), hi = i + 1 < n ? hexValue(text[i + 1]) : 0;
+        if (lo < 0)
+            return i;
+        if (hi < 0)
+            return i + 1;
+        digits[i / 2] = hi << 4 | lo;
+    }
+    return n;
+}
+
+// 2n characters of ordinary (most significant first) upper-case hex for
+// digits[0 .. n)
+inline void hexEncode(const int *digits, size_t n, char *out)
+{
+    static const char HEX[] = "0123456789ABCDEF";
+    size_t j = n;
+#if defined(__SSE2__)
+    for (; j >= 8; j -= 8, out += 16)
+    {
+        __m128i lo4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(digits + j - 8));
+        __m128i hi4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(digits + j - 4));
+        __m128i v = _mm_packs_epi32(lo4, hi4); // digit j - 8 + k in lane k
+
+        // Each lane becomes its two characters, high nibble first in memory
+        __m128i nib = _mm_or_si128(_mm_srli_epi16(v, 4), _mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0x0F)), 8));
+        __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(nib, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '0' - 10));
+        __m128i chars = _mm_add_epi8(_mm_add_epi8(nib, _mm_set1_epi8('0')), letter);
+
+        // Most significant digit first: reverse the eight lanes
+        chars = _mm_shufflelo_epi16(chars, 0x1B);
+        chars = _mm_shufflehi_epi16(chars, 0x1B);
+        chars = _mm_shuffle_epi32(chars, 0x4E);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), chars);
+    }
+#endif
+    while (j-- > 0)
+    {
+        *out++ = HEX[digits[j] >> 4];
+        *out++ = HEX[digits[j] & 0xF];
+    }
+}
+
+// 2n characters of reversed hex (least significant nibble first) for
+// digits[0 .. n), the tools' output format
+inline void hexEncodeReversed(const int *digits, size_t n, char *out)
+{
+    static const char HEX[] = "0123456789ABCDEF";
+    size_t j = 0;
+#if defined(__SSE2__)
+    for (; j + 8 <= n; j += 8, out += 16)
+    {
+        __m128i lo4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(digits + j));
+        __m128i hi4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(digits + j + 4));
+        __m128i v = _mm_packs_epi32(lo4, hi4);
+
+        // Low nibble first in memory; already in output order
+        __m128i nib = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi16(0x0F)), _mm_slli_epi16(_mm_srli_epi16(v, 4), 8));
+        __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(nib, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '0' - 10));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out),
+                         _mm_add_epi8(_mm_add_epi8(nib, _mm_set1_epi8('0')), letter));
+    }
+#endif
+    for (; j < n; j++)
+    {
+        *out++ = HEX[digits[j] & 0xF];
+        *out++ = HEX[digits[j] >> 4];
+    }
+}
+
+#endif
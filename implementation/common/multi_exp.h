@@ -0,0 +1,278 @@
+#ifndef MULTI_EXP_H
+#define MULTI_EXP_H
+
+#include <vector>
+
+#include "bignum.h"
+
+// Multi-buffer exponentiation: independent base^exp mod m sharing one
+// modulus, one operand per SIMD lane (8 on IFMA, 4 on AVX2). Vector j holds
+// digit j of every lane, so a Montgomery multiplication is the plain
+// row-by-row loop done for all lanes at once: no shuffles and no serial
+// extraction of q, unlike the single-operand kernels in simd_mont.h. All
+// lanes follow one fixed 4-bit window schedule over the longest exponent
+// (a zero window multiplies by entry 0 = 1), so they never diverge.
+
+// out = a * b * R^-1 mod m for every lane; arrays are n digit vectors of
+// `lanes` values each, m is broadcast the same way; out may alias a or b
+typedef void (*MultiMulFn)(uint64_t *out, const uint64_t *a, const uint64_t *b, const uint64_t *m,
+                           uint64_t k0, size_t n);
+
+#ifdef SIMD_MONT_X86
+
+// The maskz_ forms of the 512-bit intrinsics avoid GCC 12's bogus
+// -Wmaybe-uninitialized on the unmasked ones
+const size_t MULTI_IFMA_MAX_DIGITS = 80;  // 4160 bits
+const size_t MULTI_AVX2_MAX_DIGITS = 160; // 4320 bits
+
+__attribute__((target("avx512f,avx512ifma"))) inline void multiMulIfma(uint64_t *out, const uint64_t *a,
+                                                                       const uint64_t *b, const uint64_t *m,
+                                                                       uint64_t k0, size_t n)
+{
+    const __m512i mask = _mm512_set1_epi64((uint64_t(1) << 52) - 1);
+    const __m512i kv = _mm512_set1_epi64(k0);
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i T[2 * MULTI_IFMA_MAX_DIGITS + 1];
+    for (size_t j = 0; j <= 2 * n; j++)
+        T[j] = zero;
+
+    // row i works on columns i .. i + n; column i is then a multiple of 2^52.
+    // One pass per row: the high halves for column j + 1 ride along in h.
+    for (size_t i = 0; i < n; i++)
+    {
+        __m512i *t = T + i;
+        __m512i bi = _mm512_loadu_si512(b + 8 * i);
+        __m512i a0 = _mm512_loadu_si512(a), m0 = _mm512_loadu_si512(m);
+        __m512i v = _mm512_madd52lo_epu64(t[0], a0, bi);
+        __m512i q = _mm512_madd52lo_epu64(zero, v, kv);
+        v = _mm512_madd52lo_epu64(v, m0, q);
+        __m512i h = _mm512_madd52hi_epu64(_mm512_maskz_srli_epi64(0xFF, v, 52), a0, bi);
+        h = _mm512_madd52hi_epu64(h, m0, q);
+        for (size_t j = 1; j < n; j++)
+        {
+            __m512i aj = _mm512_loadu_si512(a + 8 * j), mj = _mm512_loadu_si512(m + 8 * j);
+            v = _mm512_add_epi64(t[j], h);
+            v = _mm512_madd52lo_epu64(v, aj, bi);
+            t[j] = _mm512_madd52lo_epu64(v, mj, q);
+            h = _mm512_madd52hi_epu64(zero, aj, bi);
+            h = _mm512_madd52hi_epu64(h, mj, q);
+        }
+        t[n] = _mm512_add_epi64(t[n], h);
+    }
+
+    // columns n .. 2n - 1 hold the result (< 2m): normalise, then subtract m
+    // in the lanes where that does not borrow
+    __m512i carry = zero, borrow = zero;
+    for (size_t j = 0; j < n; j++)
+    {
+        __m512i v = _mm512_add_epi64(T[n + j], carry);
+        carry = _mm512_maskz_srli_epi64(0xFF, v, 52);
+        v = _mm512_and_si512(v, mask);
+        T[j] = v;
+        __m512i d = _mm512_sub_epi64(_mm512_sub_epi64(v, _mm512_loadu_si512(m + 8 * j)), borrow);
+        borrow = _mm512_maskz_srli_epi64(0xFF, d, 63);
+        T[n + j] = _mm512_and_si512(d, mask);
+    }
+    __mmask8 keep = _mm512_cmpeq_epi64_mask(carry, zero) & _mm512_cmpneq_epi64_mask(borrow, zero);
+    for (size_t j = 0; j < n; j++)
+        _mm512_storeu_si512(out + 8 * j, _mm512_mask_blend_epi64(keep, T[n + j], T[j]));
+}
+
+__attribute__((target("avx2"))) inline void multiMulAvx2(uint64_t *out, const uint64_t *a, const uint64_t *b,
+                                                         const uint64_t *m, uint64_t k0, size_t n)
+{
+    const __m256i mask = _mm256_set1_epi64x((uint64_t(1) << 27) - 1);
+    const __m256i kv = _mm256_set1_epi64x(k0);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i T[2 * MULTI_AVX2_MAX_DIGITS + 1];
+    for (size_t j = 0; j <= 2 * n; j++)
+        T[j] = zero;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        __m256i *t = T + i;
+        __m256i bi = _mm256_loadu_si256((const __m256i *)(b + 4 * i));
+        __m256i v = _mm256_add_epi64(t[0], _mm256_mul_epu32(_mm256_loadu_si256((const __m256i *)a), bi));
+        __m256i q = _mm256_and_si256(_mm256_mul_epu32(v, kv), mask);
+        v = _mm256_add_epi64(v, _mm256_mul_epu32(_mm256_loadu_si256((const __m256i *)m), q));
+        __m256i c = _mm256_srli_epi64(v, 27);
+        for (size_t j = 1; j < n; j++)
+        {
+            v = _mm256_add_epi64(t[j], c);
+            v = _mm256_add_epi64(v, _mm256_mul_epu32(_mm256_loadu_si256((const __m256i *)(a + 4 * j)), bi));
+            t[j] = _mm256_add_epi64(v, _mm256_mul_epu32(_mm256_loadu_si256((const __m256i *)(m + 4 * j)), q));
+            c = zero;
+        }
+    }
+
+    __m256i carry = zero, borrow = zero;
+    for (size_t j = 0; j < n; j++)
+    {
+        __m256i v = _mm256_add_epi64(T[n + j], carry);
+        carry = _mm256_srli_epi64(v, 27);
+        v = _mm256_and_si256(v, mask);
+        T[j] = v;
+        __m256i d = _mm256_sub_epi64(_mm256_sub_epi64(v, _mm256_loadu_si256((const __m256i *)(m + 4 * j))), borrow);
+        borrow = _mm256_srli_epi64(d, 63);
+        T[n + j] = _mm256_and_si256(d, mask);
+    }
+    __m256i keep = _mm256_andnot_si256(_mm256_cmpeq_epi64(borrow, zero), _mm256_cmpeq_epi64(carry, zero));
+    for (size_t j = 0; j < n; j++)
+        _mm256_storeu_si256((__m256i *)(out + 4 * j), _mm256_blendv_epi8(T[n + j], T[j], keep));
+}
+
+#endif
+
+// ========================== CLASS MultiExp ==========================
+
+class MultiExp
+{
+private:
+    static const unsigned WINDOW_BITS = 4;
+
+    const MontContext &mont;
+    size_t L = 0; // lanes, 0 if there is no kernel for this CPU and size
+    unsigned r = 0;
+    size_t n = 0;
+    uint64_t k0 = 0;
+    MultiMulFn mulFn = nullptr;
+    std::vector<uint64_t> m, rr, oneM, unit; // broadcast to every lane
+
+    void broadcast(std::vector<uint64_t> &out, const uint32_t *x) const;
+    // One product per lane
+    void mul(uint64_t *out, const uint64_t *a, const uint64_t *b) const
+    {
+        STATS_PRODUCTS(a, b, L);
+        mulFn(out, a, b, m.data(), k0, n);
+    }
+    void powLanes(BigNum *out, const BigNum *bases, const BigNum *exps) const;
+
+public:
+    explicit MultiExp(const MontContext &mont);
+
+    size_t lanes() const { return L; }
+
+    // out[i] = bases[i]^exps[i] mod m. Whole groups of lanes() go through the
+    // SIMD kernel, the rest through MontContext::pow.
+    void pow(BigNum *out, const BigNum *bases, const BigNum *exps, size_t count) const;
+};
+
+inline MultiExp::MultiExp(const MontContext &mont) : mont(mont)
+{
+    STATS_PHASE(PRECOMPUTE);
+#ifdef SIMD_MONT_X86
+    SimdKernel kind = simdKernel();
+    size_t limbs = mont.size();
+    if (kind == SimdKernel::Scalar)
+        return;
+    r = VecMont::radixBits(kind);
+    n = VecMont::digitsFor(kind, limbs);
+    if (kind == SimdKernel::Ifma && n <= MULTI_IFMA_MAX_DIGITS)
+    {
+        L = 8;
+        mulFn = multiMulIfma;
+    }
+    else if (kind == SimdKernel::Avx2 && n <= MULTI_AVX2_MAX_DIGITS && !mont.fixedWidth() && !mont.vector())
+    {
+        // four 32x32 multiplies per instruction lose to one 64x64 multiply
+        // on the FixedMont widths, so AVX2 only covers the generic sizes
+        L = 4;
+        mulFn = multiMulAvx2;
+    }
+    else
+        return;
+
+    std::vector<limb_t> mod(limbs), r2(mont.getR2(), mont.getR2() + limbs), one(limbs, 0);
+    mont.getModulus().toLimbs(mod.data(), limbs);
+    // R = 2^(r * n) here: double MontContext's R^2 up to it, as VecMont does
+    for (size_t k = 0; k < 2 * (r * n - mont.rBits()); k++)
+        limbsDoubleMod(r2.data(), mod.data(), limbs);
+    one[0] = 1;
+    broadcast(m, mod.data());
+    broadcast(rr, r2.data());
+    broadcast(unit, one.data());
+
+    uint64_t inv = m[0];
+    for (int i = 0; i < 6; i++)
+        inv *= 2 - m[0] * inv;
+    k0 = (0 - inv) & ((uint64_t(1) << r) - 1);
+
+    oneM.resize(n * L);
+    mulFn(oneM.data(), unit.data(), rr.data(), m.data(), k0, n);
+#endif
+}
+
+inline void MultiExp::broadcast(std::vector<uint64_t> &out, const uint32_t *x) const
+{
+    std::vector<uint64_t> d(n);
+    limbsToDigits(d.data(), n, n, r, x, mont.size());
+    out.resize(n * L);
+    for (size_t j = 0; j < n; j++)
+        std::fill(out.begin() + j * L, out.begin() + (j + 1) * L, d[j]);
+}
+
+inline void MultiExp::pow(BigNum *out, const BigNum *bases, const BigNum *exps, size_t count) const
+{
+    size_t i = 0;
+    if (L)
+        for (; i + L <= count; i += L)
+            powLanes(out + i, bases + i, exps + i);
+    for (; i < count; i++)
+        out[i] = mont.pow(bases[i], exps[i]);
+}
+
+inline void MultiExp::powLanes(BigNum *out, const BigNum *bases, const BigNum *exps) const
+{
+    const size_t entries = size_t(1) << WINDOW_BITS, nl = n * L, limbs = mont.size();
+    STATS_COUNT_N(POW, L);
+    ScratchArena::Frame frame;
+    uint64_t *tbl = frame.alloc<uint64_t>(entries * nl), *acc = frame.alloc<uint64_t>(nl);
+    uint64_t *sel = frame.alloc<uint64_t>(nl), *d = frame.alloc<uint64_t>(n);
+    limb_t *x = frame.alloc<limb_t>(limbs);
+
+    // entry 1 = the bases in Montgomery form, entry k = entry (k - 1) * entry 1
+    int bits = 0;
+    for (size_t l = 0; l < L; l++)
+    {
+        const BigNum &b = bases[l];
+        (b.cmp(mont.getModulus()) < 0 ? b : b % mont.getModulus()).toLimbs(x, limbs);
+        limbsToDigits(d, n, n, r, x, limbs);
+        for (size_t j = 0; j < n; j++)
+            tbl[nl + j * L + l] = d[j];
+        bits = std::max(bits, exps[l].bitLength());
+    }
+    std::copy(oneM.begin(), oneM.end(), tbl);
+    mul(tbl + nl, tbl + nl, rr.data());
+    for (size_t k = 2; k < entries; k++)
+        mul(tbl + k * nl, tbl + (k - 1) * nl, tbl + nl);
+
+    std::copy(oneM.begin(), oneM.end(), acc);
+    int windows = (bits + WINDOW_BITS - 1) / WINDOW_BITS;
+    for (int w = windows - 1; w >= 0; w--)
+    {
+        if (w != windows - 1)
+            for (unsigned s = 0; s < WINDOW_BITS; s++)
+                mul(acc, acc, acc);
+        for (size_t l = 0; l < L; l++)
+        {
+            unsigned e = 0;
+            for (unsigned k = 0; k < WINDOW_BITS; k++)
+                e |= (unsigned)exps[l].testBit(w * WINDOW_BITS + k) << k;
+            const uint64_t *entry = tbl + e * nl;
+            for (size_t j = 0; j < n; j++)
+                sel[j * L + l] = entry[j * L + l];
+        }
+        mul(acc, acc, sel);
+    }
+    mul(acc, acc, unit.data());
+
+    for (size_t l = 0; l < L; l++)
+    {
+        for (size_t j = 0; j < n; j++)
+            d[j] = acc[j * L + l];
+        digitsToLimbs(x, limbs, d, n, r);
+        out[l] = BigNum::fromLimbs(x, limbs);
+    }
+}
+
+#endif
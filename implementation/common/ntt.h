@@ -0,0 +1,468 @@
+#ifndef NTT_H
+#define NTT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "fixed_bignum.h"
+#include "scratch_arena.h"
+
+// Multiplication of very large numbers by number-theoretic transforms.
+// Operands are cut into 64-bit coefficients and convolved modulo three primes
+// just below 2^62, each c * 2^41 + 1, so transforms of up to 2^40 points
+// exist. The residues of each product coefficient are recombined by CRT
+// (Garner) into a value below 2^185, which holds any sum of up to 2^56
+// coefficient products of 128 bits.
+
+#ifdef FIXED_BIGNUM_AVAILABLE
+#define NTT_AVAILABLE 1
+
+// ========================== CLASS NttPrime ==========================
+
+// Arithmetic modulo one prime p < 2^62; values are kept fully reduced
+struct NttPrime
+{
+    uint64_t p;
+    uint64_t root;  // generator of the multiplicative group
+    uint64_t pinv;  // -p^-1 mod 2^64, for Montgomery products
+    uint64_t unitq; // floor(2^64 / p), reduces any 64-bit word
+
+    NttPrime(uint64_t p, uint64_t root) : p(p), root(root)
+    {
+        uint64_t inv = p;
+        for (int i = 0; i < 6; i++)
+            inv *= 2 - p * inv;
+        pinv = 0 - inv;
+        unitq = (uint64_t)(((u128)1 << 64) / p);
+    }
+
+    uint64_t add(uint64_t a, uint64_t b) const
+    {
+        uint64_t s = a + b;
+        return s >= p ? s - p : s;
+    }
+    uint64_t sub(uint64_t a, uint64_t b) const { return a >= b ? a - b : a + p - b; }
+    uint64_t fold(uint64_t a) const { return a >= p ? a - p : a; } // a < 2p
+
+    // a * w mod p for any 64-bit a and a constant w < p with quotient
+    // wq = floor(w * 2^64 / p) (Shoup)
+    uint64_t shoup(uint64_t w) const { return (uint64_t)(((u128)w << 64) / p); }
+    uint64_t mulShoup(uint64_t a, uint64_t w, uint64_t wq) const
+    {
+        uint64_t q = (uint64_t)(((u128)a * wq) >> 64);
+        return fold(a * w - q * p);
+    }
+    uint64_t reduce(uint64_t a) const { return mulShoup(a, 1, unitq); }
+
+    // a * b * 2^-64 mod p
+    uint64_t mulMont(uint64_t a, uint64_t b) const
+    {
+        u128 t = (u128)a * b;
+        uint64_t q = (uint64_t)t * pinv;
+        return fold((uint64_t)((t + (u128)q * p) >> 64));
+    }
+
+    // Plain arithmetic for table setup
+    uint64_t mul(uint64_t a, uint64_t b) const { return (uint64_t)((u128)a * b % p); }
+    uint64_t pow(uint64_t a, uint64_t e) const
+    {
+        uint64_t r = 1;
+        for (; e; e >>= 1, a = mul(a, a))
+            if (e & 1)
+                r = mul(r, a);
+        return r;
+    }
+    uint64_t inverse(uint64_t a) const { return pow(a, p - 2); }
+};
+
+static const int NTT_PRIMES = 3;
+static const int NTT_MAX_LOG = 40;
+
+inline const NttPrime *nttPrimes()
+{
+    static const NttPrime primes[NTT_PRIMES] = {NttPrime(0x3FFFC00000000001ULL, 11),
+                                                NttPrime(0x3FFFBE0000000001ULL, 3),
+                                                NttPrime(0x3FFF840000000001ULL, 19)};
+    return primes;
+}
+
+// Garner constants: x = v1 + v2 * p1 + v3 * p1 * p2
+struct NttCrt
+{
+    uint64_t inv12, inv12q; // p1^-1 mod p2
+    uint64_t inv13, inv13q; // p1^-1 mod p3
+    uint64_t inv23, inv23q; // p2^-1 mod p3
+    uint64_t p12lo, p12hi;  // p1 * p2
+
+    NttCrt()
+    {
+        const NttPrime *P = nttPrimes();
+        inv12 = P[1].inverse(P[0].p % P[1].p);
+        inv13 = P[2].inverse(P[0].p % P[2].p);
+        inv23 = P[2].inverse(P[1].p % P[2].p);
+        inv12q = P[1].shoup(inv12);
+        inv13q = P[2].shoup(inv13);
+        inv23q = P[2].shoup(inv23);
+        u128 p12 = (u128)P[0].p * P[1].p;
+        p12lo = (uint64_t)p12;
+        p12hi = (uint64_t)(p12 >> 64);
+    }
+
+    static const NttCrt &get()
+    {
+        static const NttCrt crt;
+        return crt;
+    }
+};
+
+// ========================== CLASS NttPlan ==========================
+
+// Points per cache block: 32 KB of residues, so once a butterfly span fits,
+// all remaining stages of a block run while it is in L1
+static const size_t NTT_BLOCK = 4096;
+
+// Twiddle factors for transforms of one size, built once and shared. Each
+// stage's factors are contiguous: w_2len^j and its Shoup quotient at
+// 2 * (len + j).
+class NttPlan
+{
+private:
+    std::vector<uint64_t> fwd[NTT_PRIMES], inv[NTT_PRIMES];
+
+    explicit NttPlan(size_t size);
+
+    static void difStage(const NttPrime &P, uint64_t *a, size_t n, size_t len, const uint64_t *w);
+    static void ditStage(const NttPrime &P, uint64_t *a, size_t n, size_t len, const uint64_t *w);
+
+public:
+    size_t size;
+    uint64_t scale[NTT_PRIMES], scaleq[NTT_PRIMES]; // 2^64 / size mod p
+
+    // Plan for the smallest power of two >= points
+    static const NttPlan &get(size_t points);
+
+    // Natural order in, bit-reversed out; the inverse takes it back and
+    // leaves a factor of size for the caller to scale out
+    void forward(uint64_t *a, int k) const;
+    void inverse(uint64_t *a, int k) const;
+};
+
+inline NttPlan::NttPlan(size_t size) : size(size)
+{
+    for (int k = 0; k < NTT_PRIMES; k++)
+    {
+        const NttPrime &P = nttPrimes()[k];
+        fwd[k].assign(2 * size, 0);
+        inv[k].assign(2 * size, 0);
+        for (size_t len = 1; len < size; len *= 2)
+        {
+            uint64_t w = P.pow(P.root, (P.p - 1) / (2 * len)), wi = P.inverse(w);
+            uint64_t x = 1, y = 1;
+            for (size_t j = 0; j < len; j++)
+            {
+                fwd[k][2 * (len + j)] = x;
+                fwd[k][2 * (len + j) + 1] = P.shoup(x);
+                inv[k][2 * (len + j)] = y;
+                inv[k][2 * (len + j) + 1] = P.shoup(y);
+                x = P.mul(x, w);
+                y = P.mul(y, wi);
+            }
+        }
+        uint64_t r = (uint64_t)(((u128)1 << 64) % P.p);
+        scale[k] = P.mul(r, P.inverse(size % P.p));
+        scaleq[k] = P.shoup(scale[k]);
+    }
+}
+
+inline const NttPlan &NttPlan::get(size_t points)
+{
+    static std::mutex lock;
+    static std::map<size_t, std::unique_ptr<NttPlan>> plans;
+
+    size_t size = 2;
+    while (size < points)
+        size *= 2;
+    if (size > (size_t(1) << NTT_MAX_LOG))
+        throw std::length_error("Operand too large for NTT multiplication");
+
+    std::lock_guard<std::mutex> guard(lock);
+    std::unique_ptr<NttPlan> &plan = plans[size];
+    if (!plan)
+        plan.reset(new NttPlan(size));
+    return *plan;
+}
+
+// Gentleman-Sande butterflies over blocks of 2 * len points
+inline void NttPlan::difStage(const NttPrime &P, uint64_t *a, size_t n, size_t len, const uint64_t *w)
+{
+    for (size_t s = 0; s < n; s += 2 * len)
+    {
+        uint64_t *x = a + s, *y = a + s + len;
+        const uint64_t *t = w + 2 * len;
+        for (size_t j = 0; j < len; j++)
+        {
+            uint64_t u = x[j], v = y[j];
+            x[j] = P.add(u, v);
+            y[j] = P.mulShoup(u + P.p - v, t[2 * j], t[2 * j + 1]);
+        }
+    }
+}
+
+// Cooley-Tukey butterflies, the exact inverse of difStage up to a factor 2
+inline void NttPlan::ditStage(const NttPrime &P, uint64_t *a, size_t n, size_t len, const uint64_t *w)
+{
+    for (size_t s = 0; s < n; s += 2 * len)
+    {
+        uint64_t *x = a + s, *y = a + s + len;
+        const uint64_t *t = w + 2 * len;
+        for (size_t j = 0; j < len; j++)
+        {
+            uint64_t u = x[j], v = P.mulShoup(y[j], t[2 * j], t[2 * j + 1]);
+            x[j] = P.add(u, v);
+            y[j] = P.sub(u, v);
+        }
+    }
+}
+
+inline void NttPlan::forward(uint64_t *a, int k) const
+{
+    const NttPrime &P = nttPrimes()[k];
+    const uint64_t *w = fwd[k].data();
+    size_t len = size / 2;
+    for (; 2 * len > NTT_BLOCK; len /= 2)
+        difStage(P, a, size, len, w);
+    for (size_t b = 0; b < size; b += 2 * len)
+        for (size_t l = len; l >= 1; l /= 2)
+            difStage(P, a + b, 2 * len, l, w);
+}
+
+inline void NttPlan::inverse(uint64_t *a, int k) const
+{
+    const NttPrime &P = nttPrimes()[k];
+    const uint64_t *w = inv[k].data();
+    size_t block = std::min(size, NTT_BLOCK);
+    for (size_t b = 0; b < size; b += block)
+        for (size_t l = 1; l < block; l *= 2)
+            ditStage(P, a + b, block, l, w);
+    for (size_t l = block; l < size; l *= 2)
+        ditStage(P, a, size, l, w);
+}
+
+// ========================== Transform-domain operations ==========================
+
+// out = transforms of the residues of a number of n 32-bit limbs, one run of
+// plan.size words per prime
+inline void nttForward(const NttPlan &plan, uint64_t *out, const uint32_t *limbs, size_t n)
+{
+    size_t words = (n + 1) / 2;
+    for (int k = 0; k < NTT_PRIMES; k++)
+    {
+        const NttPrime &P = nttPrimes()[k];
+        uint64_t *v = out + k * plan.size;
+        for (size_t i = 0; i < n / 2; i++)
+            v[i] = P.reduce(limbs[2 * i] | (uint64_t)limbs[2 * i + 1] << 32);
+        if (n % 2)
+            v[n / 2] = limbs[n - 1];
+        std::fill(v + words, v + plan.size, 0);
+        plan.forward(v, k);
+    }
+}
+
+// a = a * b pointwise, with an extra 2^-64 that the inverse scaling removes
+inline void nttPointwise(const NttPlan &plan, uint64_t *a, const uint64_t *b)
+{
+    for (int k = 0; k < NTT_PRIMES; k++)
+    {
+        const NttPrime &P = nttPrimes()[k];
+        uint64_t *x = a + k * plan.size;
+        const uint64_t *y = b + k * plan.size;
+        for (size_t i = 0; i < plan.size; i++)
+            x[i] = P.mulMont(x[i], y[i]);
+    }
+}
+
+// out[0 .. n) = low n limbs of the number whose transform is in a
+// (destroyed). Coefficients are recombined and carried upwards in one pass.
+inline void nttInverse(const NttPlan &plan, uint32_t *out, size_t n, uint64_t *a)
+{
+    const NttPrime *P = nttPrimes();
+    const NttCrt &C = NttCrt::get();
+    for (int k = 0; k < NTT_PRIMES; k++)
+        plan.inverse(a + k * plan.size, k);
+
+    const uint64_t *a1 = a, *a2 = a + plan.size, *a3 = a + 2 * plan.size;
+    uint64_t c0 = 0, c1 = 0, c2 = 0;
+    for (size_t i = 0; 2 * i < n; i++)
+    {
+        if (i < plan.size)
+        {
+            uint64_t r1 = P[0].mulShoup(a1[i], plan.scale[0], plan.scaleq[0]);
+            uint64_t r2 = P[1].mulShoup(a2[i], plan.scale[1], plan.scaleq[1]);
+            uint64_t r3 = P[2].mulShoup(a3[i], plan.scale[2], plan.scaleq[2]);
+            uint64_t v1 = r1;
+            uint64_t v2 = P[1].mulShoup(P[1].sub(r2, P[1].fold(v1)), C.inv12, C.inv12q);
+            uint64_t t = P[2].mulShoup(P[2].sub(r3, P[2].fold(v1)), C.inv13, C.inv13q);
+            uint64_t v3 = P[2].mulShoup(P[2].sub(t, P[2].fold(v2)), C.inv23, C.inv23q);
+
+            // x = v1 + v2 * p1 + v3 * p1 * p2 in three words, added into c
+            u128 lo = (u128)v2 * P[0].p + v1 + (u128)v3 * C.p12lo;
+            u128 hi = (lo >> 64) + (u128)v3 * C.p12hi;
+            u128 s = (u128)c0 + (uint64_t)lo;
+            c0 = (uint64_t)s;
+            s = (u128)c1 + (uint64_t)hi + (uint64_t)(s >> 64);
+            c1 = (uint64_t)s;
+            c2 += (uint64_t)(hi >> 64) + (uint64_t)(s >> 64);
+        }
+        out[2 * i] = (uint32_t)c0;
+        if (2 * i + 1 < n)
+            out[2 * i + 1] = (uint32_t)(c0 >> 32);
+        c0 = c1;
+        c1 = c2;
+        c2 = 0;
+    }
+}
+
+// out[0 .. na + nb) = a * b; a single forward transform when squaring
+inline void nttMultiply(uint32_t *out, const uint32_t *a, size_t na, const uint32_t *b, size_t nb)
+{
+    const NttPlan &plan = NttPlan::get((na + 1) / 2 + (nb + 1) / 2);
+    ScratchArena::Frame frame;
+    uint64_t *x = frame.alloc<uint64_t>(NTT_PRIMES * plan.size);
+    nttForward(plan, x, a, na);
+    if (a == b && na == nb)
+        nttPointwise(plan, x, x);
+    else
+    {
+        uint64_t *y = frame.alloc<uint64_t>(NTT_PRIMES * plan.size);
+        nttForward(plan, y, b, nb);
+        nttPointwise(plan, x, y);
+    }
+    nttInverse(plan, out, na + nb, x);
+}
+
+// ========================== CLASS NttMont ==========================
+
+// Montgomery multiplication for moduli too large for the quadratic kernels,
+// with MontContext's R = 2^(32n):
+//   t = a * b,  q = (t mod R) * (-m^-1) mod R,  out = (t + q * m) / R
+// Three transform products; those of m and -m^-1 are computed once.
+class NttMont
+{
+private:
+    size_t n;
+    std::vector<uint32_t> m;
+    const NttPlan *plan;
+    std::vector<uint64_t> mHat, negInvHat;
+
+public:
+    NttMont(const uint32_t *mod, size_t limbs);
+
+    // out = a * b * R^-1 mod m for a, b < m; out may alias a or b
+    void mul(uint32_t *out, const uint32_t *a, const uint32_t *b) const;
+};
+
+inline NttMont::NttMont(const uint32_t *mod, size_t limbs)
+    : n(limbs), m(mod, mod + limbs), plan(&NttPlan::get(limbs + limbs % 2))
+{
+    // m^-1 mod 2^(32k) by Newton's iteration x = x * (2 - m * x), doubling k
+    std::vector<uint32_t> x(n, 0), t(2 * n + 2), u(2 * n + 2);
+    uint32_t x0 = m[0];
+    for (int i = 0; i < 5; i++)
+        x0 *= 2 - m[0] * x0;
+    x[0] = x0;
+    for (size_t k = 1; k < n;)
+    {
+        size_t next = std::min(2 * k, n);
+        nttMultiply(t.data(), m.data(), next, x.data(), k);
+        uint64_t carry = 3; // t = 2 - t = ~t + 3 mod 2^(32 next)
+        for (size_t i = 0; i < next; i++)
+        {
+            uint64_t s = (uint64_t)(uint32_t)~t[i] + carry;
+            t[i] = (uint32_t)s;
+            carry = s >> 32;
+        }
+        nttMultiply(u.data(), x.data(), k, t.data(), next);
+        std::copy(u.begin(), u.begin() + next, x.begin());
+        k = next;
+    }
+
+    // -m^-1 = 2^(32n) - m^-1
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t d = 0 - (uint64_t)x[i] - borrow;
+        x[i] = (uint32_t)d;
+        borrow = d >> 63;
+    }
+
+    mHat.resize(NTT_PRIMES * plan->size);
+    negInvHat.resize(NTT_PRIMES * plan->size);
+    nttForward(*plan, mHat.data(), m.data(), n);
+    nttForward(*plan, negInvHat.data(), x.data(), n);
+}
+
+inline void NttMont::mul(uint32_t *out, const uint32_t *a, const uint32_t *b) const
+{
+    ScratchArena::Frame frame;
+    size_t N = plan->size;
+    uint64_t *x = frame.alloc<uint64_t>(NTT_PRIMES * N);
+    uint32_t *t = frame.alloc<uint32_t>(2 * n), *u = frame.alloc<uint32_t>(2 * n);
+
+    nttForward(*plan, x, a, n);
+    if (a == b)
+        nttPointwise(*plan, x, x);
+    else
+    {
+        uint64_t *y = frame.alloc<uint64_t>(NTT_PRIMES * N);
+        nttForward(*plan, y, b, n);
+        nttPointwise(*plan, x, y);
+    }
+    nttInverse(*plan, t, 2 * n, x);
+
+    nttForward(*plan, x, t, n);
+    nttPointwise(*plan, x, negInvHat.data());
+    nttInverse(*plan, u, n, x);
+    nttForward(*plan, x, u, n);
+    nttPointwise(*plan, x, mHat.data());
+    nttInverse(*plan, u, 2 * n, x);
+
+    // The low halves of t and q * m sum to 0 mod R, carrying 1 unless both are 0
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n && !carry; i++)
+        carry = t[i] != 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t s = (uint64_t)t[n + i] + u[n + i] + carry;
+        out[i] = (uint32_t)s;
+        carry = s >> 32;
+    }
+
+    // out < 2m: subtract m once if needed
+    bool ge = carry != 0;
+    if (!ge)
+    {
+        size_t i = n;
+        while (i-- > 0 && out[i] == m[i])
+            ;
+        ge = i == (size_t)-1 || out[i] > m[i];
+    }
+    if (ge)
+    {
+        uint64_t borrow = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t d = (uint64_t)out[i] - m[i] - borrow;
+            out[i] = (uint32_t)d;
+            borrow = d >> 63;
+        }
+    }
+}
+
+#endif
+
+#endif
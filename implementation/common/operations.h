@@ -0,0 +1,276 @@
+#ifndef OPERATIONS_H
+#define OPERATIONS_H
+
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "group_context.h"
+#include "primality.h"
+#include "signer_cache.h"
+#include "task_graph.h"
+
+// ========================== CLASS Operations ==========================
+
+// The four tools' computations on values already in memory: the tools run
+// them once per input, the daemon and the C ABI for many requests. Group
+// contexts and signer tables are kept between calls, so repeated groups and
+// keys cost no setup; a group's fixed-base table is only built once the group
+// comes back, so one-off groups never pay for it. The independent
+// exponentiations of one request run concurrently while cores are free
+// (task_graph.h). With setConstantTime, powers of private keys (dh, decrypt)
+// take the constant-time path. Not thread-safe: one instance per thread.
+class Operations
+{
+private:
+    struct Group
+    {
+        std::unique_ptr<GroupContext> ctx;
+        unsigned seen = 0;
+        int safePrime = -1; // p = 2q + 1 with p and q prime: 1 or 0, -1 until checked
+    };
+
+    std::map<std::string, Group> groups;
+    SignerCache signers;
+    bool constantTime = false;
+
+    Group &enter(const BigNum &p, const BigNum &g);
+    // g^x, and base^x for the group's p, for a secret x of at most `bits` bits
+    BigNum secretPowG(const GroupContext &ctx, const BigNum &x, int bits) const;
+    BigNum secretPow(const GroupContext &ctx, const BigNum &base, const BigNum &x, const BigNum &p, int bits) const;
+
+public:
+    static const size_t MAX_GROUPS = 256;
+
+    Operations(size_t signerCacheBytes = 64 << 20, unsigned signerThreshold = 2)
+        : signers(signerCacheBytes, signerThreshold)
+    {
+    }
+
+    const GroupContext &group(const BigNum &p, const BigNum &g);
+    void setConstantTime(bool on) { constantTime = on; }
+
+    // project1: is g a primitive root mod p, given the prime factors U of p - 1
+    bool primitiveRoot(const BigNum &p, const std::vector<BigNum> &U, const BigNum &g);
+    // project2: A = g^a, B = g^b, K = A^b, with a, b reduced mod q and the
+    // public keys checked when q is not 0. safePrime: the caller vouches that
+    // p = 2q + 1 with both prime (a named group, or one it proved), so the
+    // checks take Jacobi at once. Throws std::invalid_argument for inputs
+    // project2 rejects.
+    void dh(const BigNum &p, const BigNum &g, BigNum a, BigNum b, const BigNum &q, BigNum &A, BigNum &B, BigNum &K,
+            bool safePrime = false);
+    // project3: h = g^x, m = c2 * (c1^x)^-1
+    void decrypt(const BigNum &p, const BigNum &g, const BigNum &x, const BigNum &c1, const BigNum &c2, BigNum &h,
+                 BigNum &m);
+    // project4: g^m == y^r * r^s with 0 < r < p, 0 < s < p - 1
+    bool verify(const BigNum &p, const BigNum &g, const BigNum &y, const BigNum &m, const BigNum &r, const BigNum &s);
+
+    // g^m == y^r * rs, for callers that batch the r^s powers themselves; r and s
+    // must already be in range
+    bool verifyPowered(const BigNum &p, const BigNum &g, const BigNum &y, const BigNum &m, const BigNum &r,
+                       const BigNum &rs);
+
+    // The checks behind these, shared with the tools that print each step.
+    // inSubgroup: 1 < Y < p - 1 and Y is in the order-q subgroup; with
+    // safePrime (p = 2q + 1, both proven prime) Jacobi(Y, p) = 1 decides it.
+    // quadraticCharacter: Jacobi(g, p), which settles the k = 2 test when 2 is
+    // in U and p is odd and greater than 2; 0 otherwise.
+    static bool inSubgroup(const BigNum &Y, const BigNum &p, const BigNum &q, bool safePrime);
+    static int quadraticCharacter(const BigNum &p, const std::vector<BigNum> &U, const BigNum &g);
+    // isSafePrime, with a proof kept in the precomputation cache so that
+    // later runs do not repeat the Miller-Rabin rounds
+    static bool provenSafePrime(const BigNum &p, const BigNum &q);
+
+    size_t groupCount() const { return groups.size(); }
+    const SignerCache &getSignerCache() const { return signers; }
+};
+
+// Entry for (p, g): its context is built on first use (with a table only if
+// the cache holds one or an earlier process saw the group) and rebuilt with a
+// table on the second. The whole map is dropped once it holds MAX_GROUPS
+// groups, so a stream of one-off groups stays bounded.
+inline Operations::Group &Operations::enter(const BigNum &p, const BigNum &g)
+{
+    if (p.cmp(BigNum(1)) <= 0)
+        throw std::invalid_argument("Modulus must be greater than 1");
+    std::string key = p.toReversedHex() + "/" + g.toReversedHex();
+    auto found = groups.find(key);
+    if (found == groups.end())
+    {
+        if (groups.size() >= MAX_GROUPS)
+            groups.clear();
+        found = groups.emplace(key, Group()).first;
+    }
+    Group &entry = found->second;
+    if (++entry.seen <= 2 && (!entry.ctx || !entry.ctx->hasTable()))
+        entry.ctx.reset(
+            new GroupContext(p, g, entry.seen == 2 ? GroupContext::BUILD_TABLE : GroupContext::TABLE_IF_SEEN));
+    return entry;
+}
+
+inline const GroupContext &Operations::group(const BigNum &p, const BigNum &g)
+{
+    return *enter(p, g).ctx;
+}
+
+inline BigNum Operations::secretPowG(const GroupContext &ctx, const BigNum &x, int bits) const
+{
+    return constantTime ? ctx.powGConstTime(x, bits) : ctx.powG(x);
+}
+
+// Throws std::invalid_argument in constant-time mode for an even p
+inline BigNum Operations::secretPow(const GroupContext &ctx, const BigNum &base, const BigNum &x, const BigNum &p,
+                                    int bits) const
+{
+    const MontContext *mont = ctx.getMont();
+    if (constantTime && !mont)
+        throw std::invalid_argument("Constant-time exponentiation needs an odd modulus greater than 1");
+    if (constantTime)
+        return mont->powConstTime(base, x, bits);
+    return mont ? mont->pow(base, x) : BigNum::modPow(base, x, p);
+}
+
+// 1 < Y < p - 1 and Y^q = 1. For a safe prime p = 2q + 1 the order-q
+// subgroup is exactly the quadratic residues, so Jacobi(Y, p) = 1 replaces
+// the exponentiation; for a composite p or q it would not.
+inline bool Operations::inSubgroup(const BigNum &Y, const BigNum &p, const BigNum &q, bool safePrime)
+{
+    if (Y.cmp(BigNum(1)) <= 0 || Y.cmp(p - BigNum(1)) >= 0)
+        return false;
+    if (safePrime && (q + q + BigNum(1)).cmp(p) == 0)
+        return BigNum::jacobi(Y, p) == 1;
+    return BigNum::modPow(Y, q, p).cmp(BigNum(1)) == 0;
+}
+
+// g^((p-1)/2) = Jacobi(g, p) mod p for odd p, so no exponentiation for k = 2
+inline int Operations::quadraticCharacter(const BigNum &p, const std::vector<BigNum> &U, const BigNum &g)
+{
+    BigNum two(2);
+    if (!p.isOdd() || p.cmp(two) <= 0)
+        return 0;
+    for (const BigNum &k : U)
+        if (k.cmp(two) == 0)
+            return BigNum::jacobi(g, p);
+    return 0;
+}
+
+inline bool Operations::provenSafePrime(const BigNum &p, const BigNum &q)
+{
+    if ((q + q + BigNum(1)).cmp(p) != 0)
+        return false;
+    if (PrecompCache::knownSafePrime(p))
+        return true;
+    if (!isSafePrime(p, q))
+        return false;
+    PrecompCache::storeSafePrime(p);
+    return true;
+}
+
+inline bool Operations::primitiveRoot(const BigNum &p, const std::vector<BigNum> &U, const BigNum &g)
+{
+    BigNum one(1), two(2), pMinus1 = p - one;
+
+    // a residue fails k = 2; a non-residue passes it
+    int j = quadraticCharacter(p, U, g);
+    if (j == 1)
+        return false;
+
+    const GroupContext &ctx = group(p, g);
+    for (const BigNum &k : U)
+    {
+        if (k.isZero())
+            throw std::invalid_argument("Factor 0 of p - 1");
+        if (j != 0 && k.cmp(two) == 0)
+            continue;
+        if (ctx.powG(pMinus1 / k).cmp(one) == 0)
+            return false;
+    }
+    return true;
+}
+
+inline void Operations::dh(const BigNum &p, const BigNum &g, BigNum a, BigNum b, const BigNum &q, BigNum &A,
+                           BigNum &B, BigNum &K, bool safePrime)
+{
+    if (!q.isZero())
+    {
+        if (!((p - BigNum(1)) % q).isZero())
+            throw std::invalid_argument("q does not divide p - 1");
+        a = a % q;
+        b = b % q;
+        if (a.isZero() || b.isZero())
+            throw std::invalid_argument("Private key is 0 mod q");
+    }
+
+    // Jacobi replaces Y^q once p and q are proven prime. For a group nobody
+    // vouched for, that proof is, like the table, only paid for when the
+    // group comes back.
+    Group &entry = enter(p, g);
+    const GroupContext &ctx = *entry.ctx;
+    if (!safePrime && entry.seen >= 2 && (q + q + BigNum(1)).cmp(p) == 0)
+    {
+        if (entry.safePrime < 0)
+            entry.safePrime = provenSafePrime(p, q);
+        safePrime = entry.safePrime == 1;
+    }
+
+    // B and its check run beside A, A's check and K = A^b
+    int bits = (q.isZero() ? p : q).bitLength();
+    bool validA = true, validB = true;
+    TaskGraph graph;
+    size_t publicA = graph.add([&] { A = secretPowG(ctx, a, bits); });
+    graph.add([&] {
+        B = secretPowG(ctx, b, bits);
+        validB = q.isZero() || inSubgroup(B, p, q, safePrime);
+    });
+    graph.add([&] { validA = q.isZero() || inSubgroup(A, p, q, safePrime); }, {publicA});
+    graph.add([&] { K = secretPow(ctx, A, b, p, bits); }, {publicA});
+    graph.run();
+    if (!validA || !validB)
+        throw std::invalid_argument("Public key is not in the order-q subgroup");
+}
+
+inline void Operations::decrypt(const BigNum &p, const BigNum &g, const BigNum &x, const BigNum &c1,
+                                const BigNum &c2, BigNum &h, BigNum &m)
+{
+    const GroupContext &ctx = group(p, g);
+    BigNum c1x;
+    TaskGraph graph;
+    graph.add([&] { h = secretPowG(ctx, x, p.bitLength()); });
+    graph.add([&] { c1x = secretPow(ctx, c1, x, p, p.bitLength()); });
+    graph.run();
+    m = (c2 * BigNum::modInverse(c1x, p)) % p;
+}
+
+inline bool Operations::verify(const BigNum &p, const BigNum &g, const BigNum &y, const BigNum &m, const BigNum &r,
+                               const BigNum &s)
+{
+    if (r.cmp(BigNum(0)) <= 0 || r.cmp(p) >= 0)
+        return false;
+    if (s.cmp(BigNum(0)) <= 0 || s.cmp(p - BigNum(1)) >= 0)
+        return false;
+
+    // the three exponentiations are independent; only powY touches the signer cache
+    const GroupContext &ctx = group(p, g);
+    const MontContext *mont = ctx.getMont();
+    BigNum left, yr, rs;
+    TaskGraph graph;
+    graph.add([&] { left = ctx.powG(m); });
+    graph.add([&] { yr = signers.powY(p, y, r, mont); });
+    graph.add([&] { rs = mont ? mont->pow(r, s) : BigNum::modPow(r, s, p); });
+    graph.run();
+    BigNum right = mont ? mont->mulMod(yr, rs) : (yr * rs) % p;
+    return left.cmp(right) == 0;
+}
+
+inline bool Operations::verifyPowered(const BigNum &p, const BigNum &g, const BigNum &y, const BigNum &m,
+                                      const BigNum &r, const BigNum &rs)
+{
+    const GroupContext &ctx = group(p, g);
+    BigNum left = ctx.powG(m), yr = signers.powY(p, y, r, ctx.getMont());
+    BigNum right = ctx.getMont() ? ctx.getMont()->mulMod(yr, rs) : (yr * rs) % p;
+    return left.cmp(right) == 0;
+}
+
+#endif
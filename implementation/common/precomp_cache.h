@@ -0,0 +1,436 @@
+#ifndef PRECOMP_CACHE_H
+#define PRECOMP_CACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PRECOMP_CACHE_MMAP 1
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "bignum.h"
+
+// On-disk cache of per-group precomputation (Montgomery constants and the
+// fixed-base table for g), one file per (p, g) under $BIGNUM_CACHE_DIR
+// (default $XDG_CACHE_HOME/bignum or ~/.cache/bignum; set it empty to
+// disable). Files are mapped read-only, so concurrent processes share one
+// copy of the tables.
+//
+// A table costs several exponentiations to build and a file per group, so
+// it is only built for a group seen before: the first sighting leaves an
+// empty marker file (sighted()), and a later run, in this or another
+// process, builds and stores the table. The directory is kept under
+// $BIGNUM_CACHE_MAX_MB (default 256) by removing the least recently used
+// files; a load refreshes its file's time.
+//
+// A p proven a safe prime (Miller-Rabin on p and (p - 1) / 2, dozens of
+// exponentiations) is recorded in a <hash of p>.safe file holding p's limbs,
+// compared on lookup, so later runs skip the proof.
+//
+// Layout (little-endian, all offsets from the start of the file):
+//   CacheHeader | p limbs | g limbs | R^2 limbs | table limbs
+// The checksum covers everything after the header. R^2 is 1 for a
+// special-form p (special_mod.h), whose table entries are plain values;
+// version 2 keeps older builds from reading such a table as Montgomery form.
+
+const char CACHE_MAGIC[8] = {'B', 'N', 'P', 'R', 'E', 'C', 'M', 'P'};
+const uint32_t CACHE_VERSION = 2;
+
+struct CacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t limbs;      // 32-bit limbs per value
+    uint32_t n0inv;      // -p^-1 mod 2^32
+    uint32_t windowBits; // fixed-base window width
+    uint32_t windows;    // number of windows covered by the table
+    uint64_t pOffset;
+    uint64_t gOffset;
+    uint64_t r2Offset;
+    uint64_t tableOffset;
+    uint64_t fileSize;
+    uint64_t checksum;
+};
+
+// 64-bit multiply-xor hash over whole words, bytes for the tail
+inline uint64_t cacheHash(const void *data, size_t len, uint64_t h = 0xcbf29ce484222325ULL)
+{
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0x100000001b3ULL;
+        h ^= h >> 29;
+    }
+    for (; i < len; i++)
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+// Read-only mapping of one cache file, unmapped on destruction
+class MappedFile
+{
+private:
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+
+public:
+    MappedFile() {}
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string &path);
+    void close();
+    const unsigned char *bytes() const { return data; }
+    size_t length() const { return size; }
+};
+
+inline bool MappedFile::open(const std::string &path)
+{
+    close();
+#ifdef PRECOMP_CACHE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CacheHeader))
+    {
+        ::close(fd);
+        return false;
+    }
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+        return false;
+    data = static_cast<const unsigned char *>(p);
+    size = st.st_size;
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+inline void MappedFile::close()
+{
+#ifdef PRECOMP_CACHE_MMAP
+    if (data)
+        munmap(const_cast<unsigned char *>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+// ========================== CLASS PrecompCache ==========================
+
+class PrecompCache
+{
+public:
+    // Markers are empty; each is counted as a block so they stay bounded too
+    static const uint64_t MARKER_BYTES = 4096;
+
+    static std::string directory();
+    static std::string pathFor(const BigNum &p, const BigNum &g);
+    static uint64_t maxBytes();
+    // Records a sighting of (p, g); true if it had been seen (or its table
+    // stored) before
+    static bool sighted(const BigNum &p, const BigNum &g);
+    // Removes the least recently used files until the directory fits maxBytes()
+    static void trim(const std::string &dir);
+    static const CacheHeader *load(MappedFile &file, const BigNum &p, const BigNum &g);
+    static bool store(const std::string &path, const MontContext &mont, const BigNum &g,
+                      uint32_t windowBits, uint32_t windows, const std::vector<limb_t> &table);
+    // Whether p was recorded as a proven safe prime; records one
+    static bool knownSafePrime(const BigNum &p);
+    static void storeSafePrime(const BigNum &p);
+
+private:
+    static std::string safePrimePath(const BigNum &p);
+    static bool writeFile(const std::string &path, const void *data, size_t len);
+};
+
+inline std::string PrecompCache::directory()
+{
+#ifdef PRECOMP_CACHE_MMAP
+    if (const char *dir = getenv("BIGNUM_CACHE_DIR"))
+        return dir;
+    std::string base;
+    if (const char *xdg = getenv("XDG_CACHE_HOME"))
+        base = xdg;
+    else if (const char *home = getenv("HOME"))
+        base = std::string(home) + "/.cache";
+    else
+        return "";
+    mkdir(base.c_str(), 0755);
+    return base + "/bignum";
+#else
+    return "";
+#endif
+}
+
+// File name is a hash of (p, g); the contents are checked against both on load
+inline std::string PrecompCache::pathFor(const BigNum &p, const BigNum &g)
+{
+    std::string dir = directory();
+    if (dir.empty())
+        return "";
+    std::vector<limb_t> pl(p.limbCount()), gl(g.limbCount());
+    p.toLimbs(pl.data(), pl.size());
+    g.toLimbs(gl.data(), gl.size());
+    uint64_t h = cacheHash(pl.data(), pl.size() * sizeof(limb_t));
+    h = cacheHash(gl.data(), gl.size() * sizeof(limb_t), h ^ pl.size());
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bnpc", (unsigned long long)h);
+    return dir + name;
+}
+
+inline bool limbsEqual(const unsigned char *stored, const BigNum &x, size_t n)
+{
+    std::vector<limb_t> l(n);
+    x.toLimbs(l.data(), n);
+    return x.limbCount() <= n && memcmp(stored, l.data(), n * sizeof(limb_t)) == 0;
+}
+
+// Maps the cache file for (p, g); returns its header or nullptr if it is
+// missing, truncated, from another version, corrupt or for another group.
+inline const CacheHeader *PrecompCache::load(MappedFile &file, const BigNum &p, const BigNum &g)
+{
+    std::string path = pathFor(p, g);
+    if (path.empty() || !file.open(path))
+        return nullptr;
+
+    const CacheHeader *h = reinterpret_cast<const CacheHeader *>(file.bytes());
+    size_t n = p.limbCount();
+    uint64_t valueBytes = n * sizeof(limb_t), size = file.length();
+    // [offset, offset + len) inside the file, without overflow, limb-aligned
+    auto inFile = [&](uint64_t offset, uint64_t len) {
+        return offset <= size && len <= size - offset && offset % sizeof(limb_t) == 0;
+    };
+    bool ok = memcmp(h->magic, CACHE_MAGIC, 8) == 0 && h->version == CACHE_VERSION &&
+              h->headerSize == sizeof(CacheHeader) && h->fileSize == size && h->limbs == n && n > 0 &&
+              inFile(h->pOffset, valueBytes) && inFile(h->gOffset, valueBytes) && inFile(h->r2Offset, valueBytes) &&
+              h->windowBits > 0 && h->windowBits < 16 && inFile(h->tableOffset, 0);
+    // windows * (2^w - 1) entries fit in 64 bits (2^32 * 2^15); their bytes may not
+    ok = ok && (uint64_t)h->windows * ((1u << h->windowBits) - 1) <= (size - h->tableOffset) / valueBytes;
+    ok = ok && cacheHash(file.bytes() + h->headerSize, h->fileSize - h->headerSize) == h->checksum;
+    ok = ok && limbsEqual(file.bytes() + h->pOffset, p, n) && limbsEqual(file.bytes() + h->gOffset, g, n);
+    if (!ok)
+    {
+        file.close();
+        return nullptr;
+    }
+#ifdef PRECOMP_CACHE_MMAP
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0); // recently used
+#endif
+    return h;
+}
+
+inline uint64_t PrecompCache::maxBytes()
+{
+    const char *mb = getenv("BIGNUM_CACHE_MAX_MB");
+    return (mb && *mb ? strtoull(mb, nullptr, 10) : 256) << 20;
+}
+
+inline bool PrecompCache::sighted(const BigNum &p, const BigNum &g)
+{
+#ifdef PRECOMP_CACHE_MMAP
+    std::string path = pathFor(p, g);
+    if (path.empty())
+        return false;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0)
+        return true;
+    std::string marker = path.substr(0, path.rfind('.')) + ".seen";
+    if (stat(marker.c_str(), &st) == 0)
+        return true;
+    std::string dir = path.substr(0, path.rfind('/'));
+    mkdir(dir.c_str(), 0755);
+    int fd = ::open(marker.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd >= 0)
+        ::close(fd);
+    trim(dir);
+    return false;
+#else
+    (void)p, (void)g;
+    return false;
+#endif
+}
+
+inline void PrecompCache::trim(const std::string &dir)
+{
+#ifdef PRECOMP_CACHE_MMAP
+    struct Entry
+    {
+        std::string path;
+        uint64_t bytes;
+        int64_t mtime;
+    };
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        return;
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    while (struct dirent *e = readdir(d))
+    {
+        std::string name = e->d_name;
+        bool table = name.size() > 5 && name.compare(name.size() - 5, 5, ".bnpc") == 0;
+        bool marker = name.size() > 5 && (name.compare(name.size() - 5, 5, ".seen") == 0 ||
+                                          name.compare(name.size() - 5, 5, ".safe") == 0);
+        struct stat st;
+        std::string path = dir + "/" + name;
+        if ((!table && !marker) || stat(path.c_str(), &st) != 0)
+            continue;
+        uint64_t bytes = marker ? MARKER_BYTES : (uint64_t)st.st_size;
+        entries.push_back({path, bytes, (int64_t)st.st_mtime});
+        total += bytes;
+    }
+    closedir(d);
+    uint64_t cap = maxBytes();
+    if (total <= cap)
+        return;
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.mtime < b.mtime; });
+    for (const Entry &e : entries)
+    {
+        if (total <= cap)
+            break;
+        if (remove(e.path.c_str()) == 0)
+            total -= e.bytes;
+    }
+#else
+    (void)dir;
+#endif
+}
+
+// Writes to a temporary file and renames it into place, so readers never see
+// a partial file and concurrent writers of the same group are harmless.
+inline bool PrecompCache::store(const std::string &path, const MontContext &mont, const BigNum &g,
+                                uint32_t windowBits, uint32_t windows, const std::vector<limb_t> &table)
+{
+#ifdef PRECOMP_CACHE_MMAP
+    size_t n = mont.size();
+    uint64_t valueBytes = n * sizeof(limb_t);
+
+    CacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CACHE_MAGIC, 8);
+    h.version = CACHE_VERSION;
+    h.headerSize = sizeof(CacheHeader);
+    h.limbs = n;
+    h.n0inv = mont.getN0inv();
+    h.windowBits = windowBits;
+    h.windows = windows;
+    h.pOffset = sizeof(CacheHeader);
+    h.gOffset = h.pOffset + valueBytes;
+    h.r2Offset = h.gOffset + valueBytes;
+    h.tableOffset = h.r2Offset + valueBytes;
+    h.fileSize = h.tableOffset + table.size() * sizeof(limb_t);
+
+    std::vector<unsigned char> buf(h.fileSize);
+    std::vector<limb_t> l(n);
+    mont.getModulus().toLimbs(l.data(), n);
+    memcpy(&buf[h.pOffset], l.data(), valueBytes);
+    g.toLimbs(l.data(), n);
+    memcpy(&buf[h.gOffset], l.data(), valueBytes);
+    memcpy(&buf[h.r2Offset], mont.getR2(), valueBytes);
+    memcpy(&buf[h.tableOffset], table.data(), table.size() * sizeof(limb_t));
+    h.checksum = cacheHash(&buf[h.headerSize], h.fileSize - h.headerSize);
+    memcpy(&buf[0], &h, sizeof(h));
+
+    if (!writeFile(path, buf.data(), buf.size()))
+        return false;
+    remove((path.substr(0, path.rfind('.')) + ".seen").c_str());
+    trim(path.substr(0, path.rfind('/')));
+    return true;
+#else
+    (void)path, (void)mont, (void)g, (void)windowBits, (void)windows, (void)table;
+    return false;
+#endif
+}
+
+// Writes to a temporary file and renames it into place (see store)
+inline bool PrecompCache::writeFile(const std::string &path, const void *data, size_t len)
+{
+#ifdef PRECOMP_CACHE_MMAP
+    std::string dir = path.substr(0, path.rfind('/'));
+    mkdir(dir.c_str(), 0755);
+    // unique per writer, threads of one process included
+    static std::atomic<unsigned> serial(0);
+    std::string tmp = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(serial++);
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(data, 1, len, f) == len;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+#else
+    (void)path, (void)data, (void)len;
+    return false;
+#endif
+}
+
+inline std::string PrecompCache::safePrimePath(const BigNum &p)
+{
+    std::string dir = directory();
+    if (dir.empty())
+        return "";
+    std::vector<limb_t> pl(p.limbCount());
+    p.toLimbs(pl.data(), pl.size());
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.safe",
+             (unsigned long long)cacheHash(pl.data(), pl.size() * sizeof(limb_t)));
+    return dir + name;
+}
+
+inline bool PrecompCache::knownSafePrime(const BigNum &p)
+{
+    std::string path = safePrimePath(p);
+    if (path.empty())
+        return false;
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    size_t n = p.limbCount();
+    std::vector<limb_t> stored(n + 1), pl(n);
+    bool ok = fread(stored.data(), sizeof(limb_t), n + 1, f) == n;
+    fclose(f);
+    p.toLimbs(pl.data(), n);
+    if (!ok || !std::equal(pl.begin(), pl.end(), stored.begin()))
+        return false;
+#ifdef PRECOMP_CACHE_MMAP
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0); // recently used
+#endif
+    return true;
+}
+
+inline void PrecompCache::storeSafePrime(const BigNum &p)
+{
+    std::string path = safePrimePath(p);
+    if (path.empty())
+        return;
+    std::vector<limb_t> pl(p.limbCount());
+    p.toLimbs(pl.data(), pl.size());
+    if (writeFile(path, pl.data(), pl.size() * sizeof(limb_t)))
+        trim(path.substr(0, path.rfind('/')));
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef PRIMALITY_H
+#define PRIMALITY_H
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "bignum.h"
+
+// ========================== Primality ==========================
+
+// Primes below 2000, for trial division
+inline const std::vector<uint32_t> &smallPrimes()
+{
+    static const std::vector<uint32_t> primes = [] {
+        std::vector<uint32_t> out;
+        std::vector<bool> composite(2000);
+        for (uint32_t d = 2; d < composite.size(); d++)
+            if (!composite[d])
+            {
+                out.push_back(d);
+                for (uint32_t k = d * d; k < composite.size(); k += d)
+                    composite[k] = true;
+            }
+        return out;
+    }();
+    return primes;
+}
+
+// x mod d for little-endian limbs x
+inline uint32_t smallRemainder(const std::vector<limb_t> &x, uint32_t d)
+{
+    uint64_t r = 0;
+    for (size_t i = x.size(); i-- > 0;)
+        r = ((r << 32) | x[i]) % d;
+    return (uint32_t)r;
+}
+
+// Trial division, then Miller-Rabin with `rounds` bases uniform in
+// [2, n - 1) drawn from rng. A composite passes with probability at most
+// 4^-rounds, whoever chose n, as long as rng is not predictable to them.
+inline bool isProbablePrime(const BigNum &n, std::mt19937_64 &rng, int rounds = 24)
+{
+    std::vector<limb_t> limbs(n.limbCount());
+    n.toLimbs(limbs.data(), limbs.size());
+    for (uint32_t d : smallPrimes())
+        if (smallRemainder(limbs, d) == 0)
+            return n.cmp(BigNum(d)) == 0;
+    if (n.cmp(BigNum(2)) < 0)
+        return false;
+    if (n.cmp(BigNum((long long)smallPrimes().back() * smallPrimes().back())) < 0)
+        return true;
+
+    BigNum one(1), two(2), nMinus1 = n - one, d = nMinus1, span = n - BigNum(3);
+    int s = 0;
+    for (; !d.isOdd(); s++)
+        d = d.div2();
+    int spanBits = span.bitLength();
+    std::vector<limb_t> r((spanBits + 31) / 32);
+    auto randomBase = [&] {
+        for (;;)
+        {
+            for (limb_t &l : r)
+                l = (limb_t)rng();
+            if (spanBits % 32)
+                r.back() &= (limb_t(1) << (spanBits % 32)) - 1;
+            BigNum x = BigNum::fromLimbs(r.data(), r.size());
+            if (x.cmp(span) < 0)
+                return x + two;
+        }
+    };
+
+    MontContext mont(n);
+    for (int round = 0; round < rounds; round++)
+    {
+        BigNum x = mont.pow(randomBase(), d);
+        if (x.cmp(one) == 0 || x.cmp(nMinus1) == 0)
+            continue;
+        int i = 1;
+        for (; i < s; i++)
+        {
+            x = mont.mulMod(x, x);
+            if (x.cmp(nMinus1) == 0)
+                break;
+        }
+        if (i == s)
+            return false;
+    }
+    return true;
+}
+
+// p = 2q + 1 with p and q both prime, bases drawn from a fresh random_device
+// seed so that an adversary choosing p cannot predict them
+inline bool isSafePrime(const BigNum &p, const BigNum &q)
+{
+    if ((q + q + BigNum(1)).cmp(p) != 0)
+        return false;
+    std::random_device device;
+    std::mt19937_64 rng((uint64_t)device() << 32 | device());
+    return isProbablePrime(q, rng) && isProbablePrime(p, rng);
+}
+
+#endif
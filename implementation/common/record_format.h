@@ -0,0 +1,251 @@
+#ifndef RECORD_FORMAT_H
+#define RECORD_FORMAT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "batch_io.h"
+
+// Binary record files, the compact alternative to reversed-hex text. The
+// tools recognise one by its magic and answer in the same format.
+//
+// Layout (little-endian):
+//   RecordHeader | value | value | ...
+// where each value is a uint32 limb count followed by that many 32-bit limbs,
+// least significant first (zero has no limbs). Every field is a multiple of
+// 4 bytes, so values in a mapped file stay limb-aligned, and their bytes are
+// already in BigNum digit order: loading is one widening copy, no parsing.
+
+const char RECORD_MAGIC[8] = {'B', 'N', 'R', 'E', 'C', 'O', 'R', 'D'};
+const uint32_t RECORD_VERSION = 1;
+
+// What a record holds, in field order
+enum RecordLayout : uint32_t
+{
+    LAYOUT_PRIMITIVE_ROOT = 1,  // p, k, U_1 .. U_k, g (variable length)
+    LAYOUT_DH = 2,              // p, g, a, b, q (q = 0: order not given)
+    LAYOUT_ELGAMAL_DECRYPT = 3, // p, g, x, c1, c2
+    LAYOUT_ELGAMAL_VERIFY = 4,  // p, g, y, m, r, s
+    LAYOUT_VERDICT = 5,         // 1 or 0
+    LAYOUT_DH_KEYS = 6,         // A, B, K
+    LAYOUT_DH_SESSION = 7,      // a, b, A, B, K
+    LAYOUT_PLAINTEXT = 8,       // h, m
+};
+
+struct RecordHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t layout;
+    uint32_t fields; // values per record, 0 if it varies
+    uint64_t records;
+};
+
+struct RecordLayoutInfo
+{
+    RecordLayout layout;
+    const char *name;
+    uint32_t fields;
+};
+
+const RecordLayoutInfo RECORD_LAYOUTS[] = {
+    {LAYOUT_PRIMITIVE_ROOT, "primitive-root", 0},
+    {LAYOUT_DH, "dh", 5},
+    {LAYOUT_ELGAMAL_DECRYPT, "elgamal-decrypt", 5},
+    {LAYOUT_ELGAMAL_VERIFY, "elgamal-verify", 6},
+    {LAYOUT_VERDICT, "verdict", 1},
+    {LAYOUT_DH_KEYS, "dh-keys", 3},
+    {LAYOUT_DH_SESSION, "dh-session", 5},
+    {LAYOUT_PLAINTEXT, "plaintext", 2},
+};
+
+inline const RecordLayoutInfo *findRecordLayout(uint32_t layout)
+{
+    for (const RecordLayoutInfo &info : RECORD_LAYOUTS)
+        if (info.layout == layout)
+            return &info;
+    return nullptr;
+}
+
+inline const RecordLayoutInfo *findRecordLayout(std::string_view name)
+{
+    for (const RecordLayoutInfo &info : RECORD_LAYOUTS)
+        if (name == info.name)
+            return &info;
+    return nullptr;
+}
+
+// Bytes one value takes, and its encoding into out[0 .. recordValueSize(x))
+inline size_t recordValueSize(const BigNum &x)
+{
+    return sizeof(uint32_t) + (x.isZero() ? 0 : x.limbCount() * sizeof(limb_t));
+}
+
+inline void encodeRecordValue(const BigNum &x, char *out)
+{
+    const std::vector<int> &d = x.getDigits();
+    uint32_t limbs = x.isZero() ? 0 : (uint32_t)x.limbCount();
+    memcpy(out, &limbs, sizeof(limbs));
+    out += sizeof(limbs);
+    size_t i = 0;
+    for (; i < d.size() && i < limbs * sizeof(limb_t); i++)
+        out[i] = char(d[i]);
+    for (; i < limbs * sizeof(limb_t); i++)
+        out[i] = 0;
+}
+
+// ========================== CLASS RecordReader ==========================
+
+// Values of a record file in order, read in place from the caller's buffer
+// (normally an InputReader's mapping). Malformed files throw
+// std::invalid_argument, like malformed text.
+class RecordReader
+{
+private:
+    const char *data;
+    size_t size;
+    size_t pos;
+    RecordHeader header;
+
+    [[noreturn]] void fail(const std::string &what) const
+    {
+        throw std::invalid_argument("Malformed record file: " + what + " at offset " + std::to_string(pos));
+    }
+
+public:
+    static bool isRecordFile(std::string_view contents)
+    {
+        return contents.size() >= sizeof(RECORD_MAGIC) && memcmp(contents.data(), RECORD_MAGIC, sizeof(RECORD_MAGIC)) == 0;
+    }
+
+    explicit RecordReader(std::string_view contents);
+    // One record's values with no header, e.g. from a daemon request
+    RecordReader(RecordLayout layout, std::string_view values);
+
+    RecordLayout layout() const { return RecordLayout(header.layout); }
+    uint64_t recordCount() const { return header.records; }
+    bool atEnd() const { return pos >= size; }
+
+    // Throws unless the file holds `expected` records, and exactly `records`
+    // of them if that is not 0
+    void expect(RecordLayout expected, uint64_t records = 0) const;
+
+    void next(BigNum &x);
+    BigNum next()
+    {
+        BigNum x;
+        next(x);
+        return x;
+    }
+    // A small count stored as a value (k of a primitive-root record)
+    uint64_t nextCount();
+};
+
+inline RecordReader::RecordReader(std::string_view contents) : data(contents.data()), size(contents.size()), pos(0)
+{
+    if (size < sizeof(RecordHeader))
+        fail("truncated header");
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC)) != 0)
+        fail("bad magic");
+    if (header.version != RECORD_VERSION)
+        fail("unsupported version " + std::to_string(header.version));
+    if (header.headerSize < sizeof(RecordHeader) || header.headerSize % 4 != 0 || header.headerSize > size)
+        fail("bad header size");
+    const RecordLayoutInfo *info = findRecordLayout(header.layout);
+    if (!info || info->fields != header.fields)
+        fail("unknown layout " + std::to_string(header.layout));
+    pos = header.headerSize;
+    // Every value takes at least its length word
+    if (header.records > (size - pos) / sizeof(uint32_t) / std::max<uint32_t>(header.fields, 1))
+        fail("record count exceeds the file");
+}
+
+inline RecordReader::RecordReader(RecordLayout layout, std::string_view values)
+    : data(values.data()), size(values.size()), pos(0)
+{
+    memcpy(header.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    header.version = RECORD_VERSION;
+    header.headerSize = 0;
+    header.layout = layout;
+    const RecordLayoutInfo *info = findRecordLayout(layout);
+    if (!info)
+        fail("unknown layout " + std::to_string(layout));
+    header.fields = info->fields;
+    header.records = 1;
+}
+
+inline void RecordReader::expect(RecordLayout expected, uint64_t records) const
+{
+    if (header.layout != expected)
+        throw std::invalid_argument(std::string("Record file holds ") + findRecordLayout(header.layout)->name +
+                                    " records, expected " + findRecordLayout(expected)->name);
+    if (records && header.records != records)
+        throw std::invalid_argument("Record file holds " + std::to_string(header.records) + " records, expected " +
+                                    std::to_string(records));
+}
+
+inline void RecordReader::next(BigNum &x)
+{
+    uint32_t limbs;
+    if (size - pos < sizeof(limbs))
+        fail("missing value");
+    memcpy(&limbs, data + pos, sizeof(limbs));
+    if ((size - pos - sizeof(limbs)) / sizeof(limb_t) < limbs)
+        fail("truncated value");
+    pos += sizeof(limbs);
+    x.assignBytes(reinterpret_cast<const uint8_t *>(data + pos), limbs * sizeof(limb_t));
+    pos += limbs * sizeof(limb_t);
+}
+
+inline uint64_t RecordReader::nextCount()
+{
+    BigNum k;
+    next(k);
+    const std::vector<int> &d = k.getDigits();
+    if (d.size() > 4)
+        fail("count out of range");
+    uint64_t n = 0;
+    for (size_t i = d.size(); i-- > 0;)
+        n = n << 8 | d[i];
+    return n;
+}
+
+// ========================== CLASS RecordWriter ==========================
+
+// Writes a header for `records` records of `layout`, then values in order
+class RecordWriter
+{
+private:
+    OutputWriter &out;
+
+public:
+    RecordWriter(OutputWriter &out, RecordLayout layout, uint64_t records);
+
+    void write(const BigNum &x);
+    void writeCount(uint64_t n) { write(BigNum((long long)n)); }
+};
+
+inline RecordWriter::RecordWriter(OutputWriter &out, RecordLayout layout, uint64_t records) : out(out)
+{
+    RecordHeader header;
+    memcpy(header.magic, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    header.version = RECORD_VERSION;
+    header.headerSize = sizeof(RecordHeader);
+    header.layout = layout;
+    header.fields = findRecordLayout(layout)->fields;
+    header.records = records;
+    out.write(std::string_view(reinterpret_cast<const char *>(&header), sizeof(header)));
+}
+
+inline void RecordWriter::write(const BigNum &x)
+{
+    encodeRecordValue(x, out.reserve(recordValueSize(x)));
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Per-thread bump allocator for temporary limb buffers. Allocations are
+// released in LIFO order by ScratchArena::Frame; blocks are kept, so once
+// the arena has grown to the working-set size of an operation, repeating it
+// allocates nothing from the heap.
+
+// ========================== CLASS ScratchArena ==========================
+
+class ScratchArena
+{
+private:
+    struct Block
+    {
+        std::unique_ptr<unsigned char[]> data;
+        size_t size;
+    };
+
+    static constexpr size_t MIN_BLOCK = 64 * 1024;
+    static constexpr size_t MAX_BLOCKS = 32;
+
+    std::vector<Block> blocks;
+    size_t current = 0; // block being filled
+    size_t offset = 0;  // first free byte in it
+    size_t heapAllocations = 0;
+
+    ScratchArena() { blocks.reserve(MAX_BLOCKS); }
+
+    void *allocate(size_t bytes);
+
+public:
+    static ScratchArena &local()
+    {
+        thread_local ScratchArena arena;
+        return arena;
+    }
+
+    // Blocks taken from the heap since the thread started
+    size_t getHeapAllocations() const { return heapAllocations; }
+    size_t capacity() const;
+
+    // Scope of a group of allocations; everything allocated through the
+    // frame is released when it goes out of scope
+    class Frame
+    {
+    private:
+        ScratchArena &arena;
+        size_t block, offset;
+
+    public:
+        Frame() : arena(local()), block(arena.current), offset(arena.offset) {}
+        ~Frame()
+        {
+            arena.current = block;
+            arena.offset = offset;
+        }
+        Frame(const Frame &) = delete;
+        Frame &operator=(const Frame &) = delete;
+
+        // Uninitialised storage for n values of T
+        template <class T>
+        T *alloc(size_t n) { return static_cast<T *>(arena.allocate(n * sizeof(T))); }
+    };
+};
+
+inline void *ScratchArena::allocate(size_t bytes)
+{
+    bytes = (bytes + 15) & ~size_t(15);
+    while (current < blocks.size())
+    {
+        if (offset + bytes <= blocks[current].size)
+        {
+            void *p = blocks[current].data.get() + offset;
+            offset += bytes;
+            return p;
+        }
+        current++;
+        offset = 0;
+    }
+
+    // Out of blocks: each new one at least doubles the capacity
+    if (blocks.size() == MAX_BLOCKS)
+        throw std::bad_alloc();
+    size_t size = std::max(std::max(MIN_BLOCK, bytes), capacity());
+    blocks.push_back(Block{std::unique_ptr<unsigned char[]>(new unsigned char[size]), size});
+    heapAllocations++;
+    current = blocks.size() - 1;
+    offset = bytes;
+    return blocks[current].data.get();
+}
+
+inline size_t ScratchArena::capacity() const
+{
+    size_t total = 0;
+    for (const Block &b : blocks)
+        total += b.size;
+    return total;
+}
+
+// Building with -DBIGNUM_COUNT_ALLOCATIONS (or -DBIGNUM_STATS, see stats.h)
+// replaces the global operator new so heapAllocationCount() reports every heap
+// allocation in the process. Each tool is a single translation unit, so the
+// definitions here are the only ones.
+#if defined(BIGNUM_COUNT_ALLOCATIONS) || defined(BIGNUM_STATS)
+#include <atomic>
+
+inline std::atomic<size_t> &heapAllocationCounter()
+{
+    static std::atomic<size_t> count(0);
+    return count;
+}
+
+inline size_t heapAllocationCount() { return heapAllocationCounter().load(std::memory_order_relaxed); }
+
+// Both sides out of line, or GCC sees free() or malloc() meet a pointer from
+// the other family once one of them is inlined, and warns
+__attribute__((noinline)) void *operator new(size_t size)
+{
+    heapAllocationCounter().fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { std::free(p); }
+#endif
+
+#endif
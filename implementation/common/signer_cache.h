@@ -0,0 +1,127 @@
+#ifndef SIGNER_CACHE_H
+#define SIGNER_CACHE_H
+
+#include <iterator>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "group_context.h"
+
+// ========================== CLASS SignerCache ==========================
+
+// LRU of fixed-base tables for public keys y, keyed by (p, y). A key gets a
+// table, and the MontContext the table runs on, once it has been seen
+// `threshold` times, so one-off signers never pay for either: until then a
+// tracked key is just its name, and its powers use the caller's context for
+// p. Tables and their contexts are evicted least-recently-used first to stay
+// within `budgetBytes`.
+class SignerCache
+{
+private:
+    struct Entry
+    {
+        std::string key;
+        unsigned seen = 0;
+        std::unique_ptr<MontContext> mont; // only with a table
+        FixedBaseTable table;
+        size_t bytes = 0; // of both, counted in usedBytes
+    };
+
+    std::list<Entry> lru; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    size_t budgetBytes;
+    unsigned threshold;
+    size_t usedBytes = 0;
+    size_t hits = 0, misses = 0, builds = 0, evictions = 0;
+
+    void evictOver(size_t limit);
+    // A context's limb vectors for an n-limb modulus
+    static size_t montBytes(size_t n) { return sizeof(MontContext) + 4 * n * sizeof(limb_t); }
+
+public:
+    static const size_t MAX_TRACKED_KEYS = 4096;
+
+    SignerCache(size_t budgetBytes, unsigned threshold) : budgetBytes(budgetBytes), threshold(threshold) {}
+
+    // groupMont: a context for p to use while the key has no table
+    BigNum powY(const BigNum &p, const BigNum &y, const BigNum &exp, const MontContext *groupMont = nullptr);
+
+    size_t getHits() const { return hits; }
+    size_t getMisses() const { return misses; }
+    size_t getBuilds() const { return builds; }
+    size_t getEvictions() const { return evictions; }
+    size_t getUsedBytes() const { return usedBytes; }
+};
+
+// Drops least-recently-used tables (and stale keys) until the tables fit in
+// `limit` bytes and the key count is bounded
+inline void SignerCache::evictOver(size_t limit)
+{
+    // the front entry is the one being used; never evict it
+    auto it = lru.end();
+    while (it != std::next(lru.begin()) && (usedBytes > limit || lru.size() > MAX_TRACKED_KEYS))
+    {
+        --it;
+        if (it->table.empty() && lru.size() <= MAX_TRACKED_KEYS)
+            continue;
+        if (!it->table.empty())
+        {
+            usedBytes -= it->bytes;
+            evictions++;
+        }
+        index.erase(it->key);
+        it = lru.erase(it);
+    }
+}
+
+// y^exp mod p for odd p, through the key's table when it has one and
+// otherwise on groupMont (a context made here if the caller has none)
+inline BigNum SignerCache::powY(const BigNum &p, const BigNum &y, const BigNum &exp, const MontContext *groupMont)
+{
+    if (!p.isOdd() || p.cmp(BigNum(1)) <= 0 || y.cmp(p) >= 0)
+        return BigNum::modPow(y, exp, p);
+
+    std::string key = p.toReversedHex() + "/" + y.toReversedHex();
+    auto found = index.find(key);
+    if (found == index.end())
+    {
+        lru.emplace_front();
+        lru.front().key = key;
+        index[key] = lru.begin();
+        evictOver(budgetBytes);
+    }
+    else
+        lru.splice(lru.begin(), lru, found->second);
+
+    Entry &e = lru.front();
+    if (!e.table.empty() && e.table.covers(exp))
+    {
+        hits++;
+        return e.table.pow(exp);
+    }
+
+    misses++;
+    if (++e.seen >= threshold && e.table.empty())
+    {
+        size_t n = p.limbCount();
+        size_t bytes = FixedBaseTable::bytesFor(p.bitLength(), n) + montBytes(n);
+        if (bytes <= budgetBytes)
+        {
+            evictOver(budgetBytes - bytes);
+            e.mont.reset(new MontContext(p));
+            e.table.build(*e.mont, y, p.bitLength());
+            e.bytes = e.table.bytes() + montBytes(n);
+            usedBytes += e.bytes;
+            builds++;
+            if (e.table.covers(exp))
+                return e.table.pow(exp);
+        }
+    }
+    if (e.mont)
+        return e.mont->pow(y, exp);
+    return groupMont ? groupMont->pow(y, exp) : MontContext(p).pow(y, exp);
+}
+
+#endif
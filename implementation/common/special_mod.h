@@ -0,0 +1,314 @@
+#ifndef SPECIAL_MOD_H
+#define SPECIAL_MOD_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fixed_bignum.h"
+#include "scratch_arena.h"
+
+// Moduli of the form m = 2^k - d with d small (pseudo-Mersenne, e.g.
+// 2^255 - 19) or a short signed sum of powers of two (generalized Mersenne /
+// Solinas, e.g. NIST P-384). Since 2^k = d mod m, the bits of a product
+// above 2^k fold back in as (x >> k) * d: one word multiply, or a few shifted
+// adds and subtracts, instead of a Montgomery or Barrett step. d must be at
+// most half as wide as m, so two or three folds bring a product below 2^k.
+
+#ifdef FIXED_BIGNUM_AVAILABLE
+#define SPECIAL_MOD_AVAILABLE 1
+
+// ========================== CLASS SpecialMod ==========================
+
+class SpecialMod
+{
+private:
+    static const size_t MAX_TERMS = 6;
+
+    struct Term
+    {
+        uint32_t shift;
+        bool negative;
+    };
+
+    size_t n;               // 32-bit limbs of m
+    size_t N;               // 64-bit digits of m
+    uint32_t k;             // m < 2^k <= 2m
+    uint64_t dWord = 0;     // d, when it fits in a word
+    std::vector<Term> terms; // otherwise d = sum of +-2^shift
+    std::vector<uint64_t> m;
+
+    SpecialMod() = default;
+    void reduce(uint64_t *x, size_t len, uint64_t *h) const;
+
+public:
+    // A reducer for m (n limbs, odd), or null if m is not of a special form
+    static std::unique_ptr<SpecialMod> detect(const uint32_t *limbs, size_t n);
+
+    // out = a * b mod m for a, b < m; out may alias a or b
+    void mul(uint32_t *out, const uint32_t *a, const uint32_t *b) const;
+
+    // e.g. "2^255 - 19" or "2^384 - 2^128 - 2^96 + 2^32 - 1"
+    std::string describe() const;
+};
+
+inline std::unique_ptr<SpecialMod> SpecialMod::detect(const uint32_t *limbs, size_t n)
+{
+    size_t N = (n + 1) / 2;
+    std::vector<uint64_t> m(N, 0);
+    memcpy(m.data(), limbs, n * sizeof(uint32_t));
+    size_t top = N;
+    while (top > 0 && m[top - 1] == 0)
+        top--;
+    if (top == 0)
+        return nullptr;
+    uint32_t k = 64 * (uint32_t)top - __builtin_clzll(m[top - 1]);
+
+    // d = 2^k - m: the two's complement of m in k bits
+    std::vector<uint64_t> d(N, 0);
+    uint64_t carry = 1;
+    for (size_t i = 0; i < N; i++)
+    {
+        u128 s = (u128)~m[i] + carry;
+        d[i] = (uint64_t)s;
+        carry = (uint64_t)(s >> 64);
+    }
+    if (k % 64)
+        d[(k - 1) / 64] &= (uint64_t(1) << (k % 64)) - 1;
+    for (size_t i = (k + 63) / 64; i < N; i++)
+        d[i] = 0;
+    size_t dTop = N;
+    while (dTop > 0 && d[dTop - 1] == 0)
+        dTop--;
+    if (dTop == 0)
+        return nullptr;
+    uint32_t dBits = 64 * (uint32_t)dTop - __builtin_clzll(d[dTop - 1]);
+    if (dBits > k / 2)
+        return nullptr;
+
+    std::unique_ptr<SpecialMod> s(new SpecialMod());
+    s->n = n;
+    s->N = N;
+    s->k = k;
+    s->m = m;
+    if (dBits <= 64)
+    {
+        s->dWord = d[0];
+        return s;
+    }
+
+    // Non-adjacent form: the fewest signed powers of two summing to d
+    for (uint32_t shift = 0; dTop > 0; shift++)
+    {
+        if (d[0] & 1)
+        {
+            bool negative = (d[0] & 3) == 3;
+            if (s->terms.size() == MAX_TERMS)
+                return nullptr;
+            s->terms.push_back(Term{shift, negative});
+            // d -= 1, or d += 1 for a negative digit; d[0] is odd, so only
+            // the +1 can carry, and d is too short for it to leave the array
+            if (!negative)
+                d[0]--;
+            else
+            {
+                size_t i = 0;
+                while (++d[i] == 0)
+                    i++;
+                dTop = std::max(dTop, i + 1);
+            }
+        }
+        for (size_t i = 0; i < dTop; i++)
+            d[i] = d[i] >> 1 | (i + 1 < dTop ? d[i + 1] << 63 : 0);
+        while (dTop > 0 && d[dTop - 1] == 0)
+            dTop--;
+    }
+    return s;
+}
+
+// x (len digits) becomes x mod m; h is scratch of len digits. Each fold
+// replaces h * 2^k by the smaller h * d, so x never outgrows len.
+inline void SpecialMod::reduce(uint64_t *x, size_t len, uint64_t *h) const
+{
+    size_t ws = k / 64, bs = k % 64;
+    while (true)
+    {
+        while (len > 0 && x[len - 1] == 0)
+            len--;
+        if (len <= ws || (len == ws + 1 && (x[ws] >> bs) == 0))
+            break;
+
+        // h = x >> k, x = x mod 2^k
+        size_t hl = len - ws;
+        for (size_t i = 0; i < hl; i++)
+            h[i] = bs ? x[i + ws] >> bs | (i + ws + 1 < len ? x[i + ws + 1] << (64 - bs) : 0) : x[i + ws];
+        while (hl > 0 && h[hl - 1] == 0)
+            hl--;
+        x[ws] &= bs ? (uint64_t(1) << bs) - 1 : 0;
+        for (size_t i = ws + 1; i < len; i++)
+            x[i] = 0;
+
+        if (dWord)
+        {
+            // x += h * d
+            uint64_t carry = 0;
+            for (size_t i = 0; i < hl; i++)
+            {
+                u128 t = (u128)h[i] * dWord + x[i] + carry;
+                x[i] = (uint64_t)t;
+                carry = (uint64_t)(t >> 64);
+            }
+            for (size_t i = hl; carry; i++)
+            {
+                x[i] += carry;
+                carry = x[i] < carry;
+            }
+            continue;
+        }
+
+        // x += h * d as shifted adds, then the subtractions (the sum stays
+        // non-negative because d > 0)
+        for (int pass = 0; pass < 2; pass++)
+            for (const Term &t : terms)
+            {
+                if (t.negative != (pass == 1))
+                    continue;
+                size_t off = t.shift / 64, sh = t.shift % 64;
+                uint64_t carry = 0, prev = 0;
+                size_t i = 0;
+                for (; i <= hl; i++)
+                {
+                    uint64_t cur = i < hl ? h[i] : 0;
+                    uint64_t v = sh ? cur << sh | prev >> (64 - sh) : cur;
+                    prev = cur;
+                    uint64_t &dst = x[off + i];
+                    if (!t.negative)
+                    {
+                        u128 s = (u128)dst + v + carry;
+                        dst = (uint64_t)s;
+                        carry = (uint64_t)(s >> 64);
+                    }
+                    else
+                    {
+                        u128 s = (u128)dst - v - carry;
+                        dst = (uint64_t)s;
+                        carry = (uint64_t)(s >> 64) & 1;
+                    }
+                }
+                for (; carry; i++)
+                {
+                    uint64_t &dst = x[off + i];
+                    if (!t.negative)
+                    {
+                        dst += carry;
+                        carry = dst == 0;
+                    }
+                    else
+                    {
+                        carry = dst == 0;
+                        dst--;
+                    }
+                }
+            }
+    }
+
+    // now x < 2^k = m + d < 2m
+    bool ge = true;
+    for (size_t i = N; i-- > 0;)
+        if (x[i] != m[i])
+        {
+            ge = x[i] > m[i];
+            break;
+        }
+    if (ge)
+    {
+        uint64_t borrow = 0;
+        for (size_t i = 0; i < N; i++)
+        {
+            u128 s = (u128)x[i] - m[i] - borrow;
+            x[i] = (uint64_t)s;
+            borrow = (uint64_t)(s >> 64) & 1;
+        }
+    }
+}
+
+inline void SpecialMod::mul(uint32_t *out, const uint32_t *a, const uint32_t *b) const
+{
+    ScratchArena::Frame frame;
+    size_t len = 2 * N + 2;
+    uint64_t *x = frame.alloc<uint64_t>(N), *y = frame.alloc<uint64_t>(N);
+    uint64_t *p = frame.alloc<uint64_t>(len), *h = frame.alloc<uint64_t>(len);
+    x[N - 1] = y[N - 1] = 0;
+    memcpy(x, a, n * sizeof(uint32_t));
+    memcpy(y, b, n * sizeof(uint32_t));
+    std::fill(p, p + len, 0);
+
+    if (a == b)
+    {
+        // off-diagonal products once, doubled, plus the squares
+        for (size_t i = 0; i < N; i++)
+        {
+            uint64_t carry = 0;
+            for (size_t j = i + 1; j < N; j++)
+            {
+                u128 t = (u128)x[i] * x[j] + p[i + j] + carry;
+                p[i + j] = (uint64_t)t;
+                carry = (uint64_t)(t >> 64);
+            }
+            p[i + N] = carry;
+        }
+        uint64_t top = 0;
+        for (size_t i = 0; i < 2 * N; i++)
+        {
+            uint64_t next = p[i] >> 63;
+            p[i] = p[i] << 1 | top;
+            top = next;
+        }
+        uint64_t carry = 0;
+        for (size_t i = 0; i < N; i++)
+        {
+            u128 sq = (u128)x[i] * x[i];
+            u128 lo = (u128)p[2 * i] + (uint64_t)sq + carry;
+            u128 hi = (u128)p[2 * i + 1] + (uint64_t)(sq >> 64) + (uint64_t)(lo >> 64);
+            p[2 * i] = (uint64_t)lo;
+            p[2 * i + 1] = (uint64_t)hi;
+            carry = (uint64_t)(hi >> 64);
+        }
+    }
+    else
+        for (size_t i = 0; i < N; i++)
+        {
+            uint64_t carry = 0;
+            for (size_t j = 0; j < N; j++)
+            {
+                u128 t = (u128)x[i] * y[j] + p[i + j] + carry;
+                p[i + j] = (uint64_t)t;
+                carry = (uint64_t)(t >> 64);
+            }
+            p[i + N] = carry;
+        }
+
+    reduce(p, len, h);
+    memcpy(out, p, n * sizeof(uint32_t));
+}
+
+inline std::string SpecialMod::describe() const
+{
+    std::string s = "2^" + std::to_string(k);
+    if (dWord)
+        return s + " - " + std::to_string(dWord);
+    for (size_t i = terms.size(); i-- > 0;)
+    {
+        // m = 2^k - d, so each term of d enters with the opposite sign
+        s += terms[i].negative ? " + " : " - ";
+        s += terms[i].shift ? "2^" + std::to_string(terms[i].shift) : "1";
+    }
+    return s;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Optional instrumentation. Building with -DBIGNUM_STATS counts the primitive
+// operations below and times the phases of a run; without it every macro
+// expands to nothing and statsJson() reports only that it is off and the
+// peak RSS.
+//   STATS_COUNT(MUL)   one event, from the hot paths
+//   STATS_COUNT_N(POW, k)  k events
+//   STATS_PRODUCTS(a, b, k)  k modular products of a and b: squarings if a == b,
+//                      multiplications otherwise, and k reductions
+//   STATS_PHASE(PARSE) charges the rest of the enclosing scope's wall time to
+//                      a phase; a nested phase pauses the outer one, so each
+//                      nanosecond is charged once
+// Counters are process-wide relaxed atomics; phases are timed on the thread
+// that enters them (a request's helper threads work inside its caller's
+// exponentiate phase). Heap allocations come from the operator new counter in
+// scratch_arena.h, which BIGNUM_STATS turns on.
+
+// High-water resident set of this process image in KiB, from
+// /proc/self/status (0 where there is none). Unlike getrusage, this does not
+// include what the parent had mapped when it forked the process.
+inline long peakRssKb()
+{
+    long kb = 0;
+    if (FILE *f = std::fopen("/proc/self/status", "r"))
+    {
+        char line[256];
+        while (std::fgets(line, sizeof(line), f))
+            if (std::strncmp(line, "VmHWM:", 6) == 0)
+                kb = std::atol(line + 6);
+        std::fclose(f);
+    }
+    return kb;
+}
+
+#ifdef BIGNUM_STATS
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "scratch_arena.h"
+
+class Stats
+{
+public:
+    enum Counter
+    {
+        MUL,    // products of distinct operands, plain or modular
+        SQR,    // squarings
+        REDUCE, // modular reductions (Montgomery, fold or SIMD kernel)
+        DIV,    // divisions (BigNum / and %)
+        INV,    // modular inversions
+        POW,    // modular exponentiations
+        COUNTERS
+    };
+
+    enum Phase
+    {
+        PARSE,
+        PRECOMPUTE,
+        EXPONENTIATE,
+        FORMAT,
+        PHASES,
+        NONE = PHASES
+    };
+
+private:
+    static std::atomic<uint64_t> &slot(size_t i)
+    {
+        static std::atomic<uint64_t> values[COUNTERS + PHASES];
+        return values[i];
+    }
+
+    // The phase the current thread is in, and since when
+    static Phase &current()
+    {
+        thread_local Phase p = NONE;
+        return p;
+    }
+
+    static uint64_t &since()
+    {
+        thread_local uint64_t t = 0;
+        return t;
+    }
+
+    static uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // Charges the current phase up to t and makes `next` current
+    static void enter(Phase next, uint64_t t)
+    {
+        if (current() != NONE)
+            slot(COUNTERS + current()).fetch_add(t - since(), std::memory_order_relaxed);
+        current() = next;
+        since() = t;
+    }
+
+public:
+    static void count(Counter c, uint64_t k = 1) { slot(c).fetch_add(k, std::memory_order_relaxed); }
+    static uint64_t get(Counter c) { return slot(c).load(std::memory_order_relaxed); }
+    static uint64_t nanoseconds(Phase p) { return slot(COUNTERS + p).load(std::memory_order_relaxed); }
+
+    class PhaseScope
+    {
+    private:
+        Phase outer;
+
+    public:
+        explicit PhaseScope(Phase p) : outer(current()) { enter(p, now()); }
+        ~PhaseScope() { enter(outer, now()); }
+        PhaseScope(const PhaseScope &) = delete;
+        PhaseScope &operator=(const PhaseScope &) = delete;
+    };
+};
+
+#define STATS_COUNT(c) Stats::count(Stats::c)
+#define STATS_COUNT_N(c, k) Stats::count(Stats::c, k)
+#define STATS_PRODUCTS(a, b, k) \
+    (Stats::count((const void *)(a) == (const void *)(b) ? Stats::SQR : Stats::MUL, k), Stats::count(Stats::REDUCE, k))
+#define STATS_PHASE(p) Stats::PhaseScope statsPhase(Stats::p)
+
+// One line of JSON for --stats
+inline std::string statsJson(const char *tool)
+{
+    static const char *counters[] = {"mul", "sqr", "reduce", "div", "inv", "pow"};
+    static const char *phases[] = {"parse", "precompute", "exponentiate", "format"};
+    std::string s = std::string("{\"tool\":\"") + tool + "\",\"enabled\":true,\"counters\":{";
+    for (int c = 0; c < Stats::COUNTERS; c++)
+        s += std::string(c ? "," : "") + "\"" + counters[c] + "\":" + std::to_string(Stats::get(Stats::Counter(c)));
+    s += ",\"alloc\":" + std::to_string(heapAllocationCount()) + "},\"phases_ns\":{";
+    for (int p = 0; p < Stats::PHASES; p++)
+        s += std::string(p ? "," : "") + "\"" + phases[p] + "\":" + std::to_string(Stats::nanoseconds(Stats::Phase(p)));
+    return s + "},\"peak_rss_kb\":" + std::to_string(peakRssKb()) + "}";
+}
+
+#else
+
+#define STATS_COUNT(c) ((void)0)
+#define STATS_COUNT_N(c, k) ((void)0)
+#define STATS_PRODUCTS(a, b, k) ((void)0)
+#define STATS_PHASE(p) ((void)0)
+
+inline std::string statsJson(const char *tool)
+{
+    return std::string("{\"tool\":\"") + tool + "\",\"enabled\":false,\"peak_rss_kb\":" + std::to_string(peakRssKb()) +
+           "}";
+}
+
+#endif
+
+#endif
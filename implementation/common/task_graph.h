@@ -0,0 +1,250 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Concurrency inside one request: the independent exponentiations of a DH
+// exchange or a signature check run on helper threads while a core is free,
+// and on the calling thread otherwise.
+
+// ========================== CLASS TaskPool ==========================
+
+// Process-wide helper threads. Every thread doing work holds a Busy, and a
+// task is handed to a helper only while fewer threads than cores are busy;
+// otherwise tryPost fails and the caller runs it itself. A loaded daemon (one
+// worker per core) or a single-core machine therefore never oversubscribes,
+// and the helpers are not started until a task is first handed over.
+class TaskPool
+{
+private:
+    std::mutex lock;
+    std::condition_variable ready;
+    std::deque<std::function<void()>> queue;
+    std::vector<std::thread> helpers;
+    std::atomic<unsigned> busy{0};
+    unsigned cores;
+    bool stopping = false;
+
+    explicit TaskPool(unsigned cores) : cores(cores) {}
+    void run();
+
+    static unsigned &depth()
+    {
+        thread_local unsigned d = 0;
+        return d;
+    }
+
+public:
+    ~TaskPool();
+
+    static TaskPool &shared()
+    {
+        static TaskPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        return pool;
+    }
+
+    // Queues task for a helper if a core is free
+    bool tryPost(std::function<void()> task);
+
+    // Marks the current thread busy for its lifetime; nested holders count once
+    class Busy
+    {
+    public:
+        Busy()
+        {
+            if (depth()++ == 0)
+                shared().busy++;
+        }
+        ~Busy()
+        {
+            if (--depth() == 0)
+                shared().busy--;
+        }
+        Busy(const Busy &) = delete;
+        Busy &operator=(const Busy &) = delete;
+    };
+};
+
+inline TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (std::thread &t : helpers)
+        t.join();
+}
+
+// A posted task holds the busy slot reserved for it by tryPost
+inline void TaskPool::run()
+{
+    depth() = 1;
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [this] { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return;
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        task();
+        busy--;
+    }
+}
+
+inline bool TaskPool::tryPost(std::function<void()> task)
+{
+    unsigned n = busy.load();
+    do
+        if (n >= cores)
+            return false;
+    while (!busy.compare_exchange_weak(n, n + 1));
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (helpers.empty())
+            for (unsigned i = 1; i < cores; i++)
+                helpers.emplace_back(&TaskPool::run, this);
+        queue.push_back(std::move(task));
+    }
+    ready.notify_one();
+    return true;
+}
+
+// ========================== CLASS TaskGraph ==========================
+
+// Tasks with dependencies, run once by run(): a task starts when the tasks it
+// was added after have finished. The calling thread takes part and returns
+// when every task has run, rethrowing the first exception (tasks not yet
+// started when it is thrown are skipped). Tasks must not share mutable state
+// except through their dependencies.
+class TaskGraph
+{
+private:
+    struct Task
+    {
+        std::function<void()> fn;
+        std::vector<size_t> dependents;
+        unsigned waiting = 0;
+    };
+
+    struct State
+    {
+        std::mutex lock;
+        std::condition_variable changed;
+        std::vector<Task> tasks;
+        std::vector<size_t> ready;
+        size_t finished = 0;
+        size_t posted = 0; // helpers asked to join that have not started yet
+        std::exception_ptr error;
+    };
+
+    // Helpers keep the state alive past run() if they start late
+    std::shared_ptr<State> state = std::make_shared<State>();
+
+    static void offer(const std::shared_ptr<State> &s);
+    static void drain(const std::shared_ptr<State> &s, std::unique_lock<std::mutex> &guard);
+
+public:
+    size_t add(std::function<void()> fn, std::initializer_list<size_t> after = {});
+    void run();
+};
+
+inline size_t TaskGraph::add(std::function<void()> fn, std::initializer_list<size_t> after)
+{
+    size_t id = state->tasks.size();
+    state->tasks.emplace_back();
+    state->tasks.back().fn = std::move(fn);
+    for (size_t before : after)
+        state->tasks[before].dependents.push_back(id);
+    state->tasks.back().waiting = (unsigned)after.size();
+    if (after.size() == 0)
+        state->ready.push_back(id);
+    return id;
+}
+
+// Asks helpers to take the ready tasks the current thread will not reach
+// next; called with the state locked
+inline void TaskGraph::offer(const std::shared_ptr<State> &s)
+{
+    while (s->ready.size() > s->posted + 1)
+    {
+        std::shared_ptr<State> keep = s;
+        bool posted = TaskPool::shared().tryPost([keep] {
+            std::unique_lock<std::mutex> guard(keep->lock);
+            keep->posted--;
+            drain(keep, guard);
+        });
+        if (!posted)
+            break;
+        s->posted++;
+    }
+}
+
+// Runs ready tasks until there are none; called and returns with the state locked
+inline void TaskGraph::drain(const std::shared_ptr<State> &s, std::unique_lock<std::mutex> &guard)
+{
+    while (!s->ready.empty())
+    {
+        size_t id = s->ready.back();
+        s->ready.pop_back();
+        bool skip = s->error != nullptr;
+        guard.unlock();
+
+        std::exception_ptr error;
+        if (!skip)
+        {
+            try
+            {
+                s->tasks[id].fn();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        }
+
+        guard.lock();
+        if (error && !s->error)
+            s->error = error;
+        s->finished++;
+        for (size_t next : s->tasks[id].dependents)
+            if (--s->tasks[next].waiting == 0)
+                s->ready.push_back(next);
+        offer(s);
+        if (s->ready.size() > 1 || s->finished == s->tasks.size())
+            s->changed.notify_all();
+    }
+}
+
+inline void TaskGraph::run()
+{
+    TaskPool::Busy busy;
+    std::unique_lock<std::mutex> guard(state->lock);
+    offer(state);
+    while (true)
+    {
+        drain(state, guard);
+        if (state->finished == state->tasks.size())
+            break;
+        state->changed.wait(guard, [this] { return !state->ready.empty() || state->finished == state->tasks.size(); });
+    }
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
+
+#endif
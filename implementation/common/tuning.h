@@ -0,0 +1,213 @@
+#ifndef TUNING_H
+#define TUNING_H
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Machine-dependent thresholds of the arithmetic core. The defaults are the
+// values measured when the code was written; a profile written by the tune
+// tool (tune/main.cpp) replaces them. The profile is read once, on first use,
+// from $BIGNUM_TUNING, or else tuning.profile in the cache directory
+// ($BIGNUM_CACHE_DIR, else $XDG_CACHE_HOME/bignum or ~/.cache/bignum; none
+// if either variable is set empty). A missing file leaves the defaults;
+// unknown keys and bad lines are skipped.
+//
+// Profile format, one setting per line, '#' starts a comment:
+//   ntt_mul_limbs 192      products from this many limbs (smaller operand) by NTT
+//   ntt_mont_limbs 512     moduli from this many limbs multiply through NttMont
+//   newton_div_digits 32   divisors from this many bytes divide by reciprocal
+//   pow_window 128 3       sliding window for exponents of up to 128 bits (the
+//                          last entry also covers everything wider)
+//   comb_window 2048 4     fixed-base table window for moduli of up to 2048 bits
+//   simd_kernel 64 avx2    vector kernel for moduli of up to 64 limbs: ifma,
+//                          avx2 or scalar (none); never above what the CPU and
+//                          $BIGNUM_KERNEL allow. No entries: the best there is.
+
+// ========================== CLASS Tuning ==========================
+
+class Tuning
+{
+public:
+    // (largest size, value) in increasing size; lookups past the end take
+    // the last value
+    typedef std::vector<std::pair<size_t, unsigned>> SizeTable;
+
+    // Smaller operand size, in limbs, from which transform multiplication
+    // beats the quadratic loop (measured: even at 192 limbs, 1.6x at 256, 4x
+    // at 512)
+    size_t nttMulLimbs = 192;
+    // Modulus size, in limbs, from which NttMont beats montMul (measured: even
+    // at 8k bits, 1.6x at 16k, 3x at 32k, 5x at 64k)
+    size_t nttMontLimbs = 512;
+    // Divisor size, in digits, from which divMod uses a Newton reciprocal
+    // when the quotient is at least half as long. Even recomputing the
+    // reciprocal every time, that beats long division from about 16 digits
+    // (2.5x at 32, 18x cached); the cached case is the common one, reducing
+    // by one modulus.
+    size_t newtonDivDigits = 32;
+    SizeTable powWindows = {{24, 1}, {128, 3}, {512, 4}, {4096, 5}};
+    SizeTable combWindows = {{INT_MAX, 4}};
+    std::vector<std::pair<size_t, std::string>> simdKernels;
+
+    // Widest fixed-base window: its 2^w - 1 entries must fit one masked scan
+    // (CT_MAX_ENTRIES)
+    static const unsigned MAX_COMB_WINDOW = 6;
+
+    static unsigned lookup(const SizeTable &table, size_t size);
+    unsigned powWindow(int expBits) const { return lookup(powWindows, (size_t)expBits); }
+    unsigned combWindow(int modBits) const { return lookup(combWindows, (size_t)modBits); }
+    // Kernel name for a modulus of `limbs` limbs, nullptr for the best available
+    const char *simdKernel(size_t limbs) const;
+
+    bool parseLine(const std::string &line);
+    bool load(const std::string &path);
+    std::string format(const std::string &comment) const;
+    bool save(const std::string &path, const std::string &comment) const;
+
+    static std::string profilePath();
+    // The process-wide settings, loaded from profilePath() on first use. Only
+    // the tune tool writes to them, between measurements.
+    static Tuning &current();
+};
+
+inline const Tuning &tuning() { return Tuning::current(); }
+
+inline unsigned Tuning::lookup(const SizeTable &table, size_t size)
+{
+    for (const auto &entry : table)
+        if (size <= entry.first)
+            return entry.second;
+    return table.back().second;
+}
+
+inline const char *Tuning::simdKernel(size_t limbs) const
+{
+    for (const auto &entry : simdKernels)
+        if (limbs <= entry.first)
+            return entry.second.c_str();
+    return simdKernels.empty() ? nullptr : simdKernels.back().second.c_str();
+}
+
+// Adds one profile line; false if it is not a setting this build knows
+inline bool Tuning::parseLine(const std::string &line)
+{
+    char key[32], name[16];
+    unsigned long a, b;
+    std::string s = line.substr(0, line.find('#'));
+    if (std::sscanf(s.c_str(), "%31s", key) != 1)
+        return true; // blank or comment
+    if (std::sscanf(s.c_str(), "%31s %lu %lu", key, &a, &b) == 3 && a > 0)
+    {
+        SizeTable *table = !std::strcmp(key, "pow_window") ? &powWindows
+                           : !std::strcmp(key, "comb_window") ? &combWindows
+                                                              : nullptr;
+        unsigned most = table == &combWindows ? MAX_COMB_WINDOW : 8;
+        if (!table || b < 1 || b > most || (!table->empty() && table->back().first >= a))
+            return false;
+        table->emplace_back(a, (unsigned)b);
+        return true;
+    }
+    if (std::sscanf(s.c_str(), "%31s %lu %15s", key, &a, name) == 3 && !std::strcmp(key, "simd_kernel"))
+    {
+        if ((std::strcmp(name, "ifma") && std::strcmp(name, "avx2") && std::strcmp(name, "scalar")) ||
+            (!simdKernels.empty() && simdKernels.back().first >= a))
+            return false;
+        simdKernels.emplace_back(a, name);
+        return true;
+    }
+    if (std::sscanf(s.c_str(), "%31s %lu", key, &a) != 2 || a == 0)
+        return false;
+    if (!std::strcmp(key, "ntt_mul_limbs"))
+        nttMulLimbs = a;
+    else if (!std::strcmp(key, "ntt_mont_limbs"))
+        nttMontLimbs = a;
+    else if (!std::strcmp(key, "newton_div_digits"))
+        newtonDivDigits = a;
+    else
+        return false;
+    return true;
+}
+
+// Settings in the file replace the defaults (a table named in the file
+// replaces the whole default table); false if it cannot be read
+inline bool Tuning::load(const std::string &path)
+{
+    FILE *f = std::fopen(path.c_str(), "r");
+    if (!f)
+        return false;
+    Tuning t;
+    t.powWindows.clear();
+    t.combWindows.clear();
+    char buf[256];
+    while (std::fgets(buf, sizeof(buf), f))
+        t.parseLine(buf);
+    std::fclose(f);
+    if (t.powWindows.empty())
+        t.powWindows = powWindows;
+    if (t.combWindows.empty())
+        t.combWindows = combWindows;
+    *this = t;
+    return true;
+}
+
+// The profile text for these settings, after a comment line
+inline std::string Tuning::format(const std::string &comment) const
+{
+    std::string s = comment.empty() ? "" : "# " + comment + "\n";
+    s += "ntt_mul_limbs " + std::to_string(nttMulLimbs) + "\n";
+    s += "ntt_mont_limbs " + std::to_string(nttMontLimbs) + "\n";
+    s += "newton_div_digits " + std::to_string(newtonDivDigits) + "\n";
+    for (const auto &e : powWindows)
+        s += "pow_window " + std::to_string(e.first) + " " + std::to_string(e.second) + "\n";
+    for (const auto &e : combWindows)
+        s += "comb_window " + std::to_string(e.first) + " " + std::to_string(e.second) + "\n";
+    for (const auto &e : simdKernels)
+        s += "simd_kernel " + std::to_string(e.first) + " " + e.second + "\n";
+    return s;
+}
+
+// Written beside the target and renamed over it, so a tool starting
+// meanwhile reads the old profile or the new one, never half of one
+inline bool Tuning::save(const std::string &path, const std::string &comment) const
+{
+    std::string tmp = path + ".tmp", text = format(comment);
+    FILE *f = std::fopen(tmp.c_str(), "w");
+    if (!f)
+        return false;
+    bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = std::fclose(f) == 0 && ok;
+    return ok && std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// "" for none, as when $BIGNUM_CACHE_DIR is set empty to disable the cache
+inline std::string Tuning::profilePath()
+{
+    if (const char *file = std::getenv("BIGNUM_TUNING"))
+        return file;
+    if (const char *dir = std::getenv("BIGNUM_CACHE_DIR"))
+        return *dir ? std::string(dir) + "/tuning.profile" : "";
+    if (const char *xdg = std::getenv("XDG_CACHE_HOME"))
+        return std::string(xdg) + "/bignum/tuning.profile";
+    if (const char *home = std::getenv("HOME"))
+        return std::string(home) + "/.cache/bignum/tuning.profile";
+    return "";
+}
+
+inline Tuning &Tuning::current()
+{
+    static Tuning t = [] {
+        Tuning loaded;
+        std::string path = profilePath();
+        if (!path.empty())
+            loaded.load(path);
+        return loaded;
+    }();
+    return t;
+}
+
+#endif
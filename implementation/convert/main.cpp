@@ -0,0 +1,183 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include "../common/record_format.h"
+using namespace std;
+
+// Converts between the tools' reversed-hex text files and binary record
+// files (common/record_format.h). A record file is turned into text; text
+// needs --layout to say what its values are.
+
+// Verdicts are written "1"/"0" in text, not as hex
+BigNum parseValue(RecordLayout layout, string_view token)
+{
+    if (layout != LAYOUT_VERDICT)
+        return BigNum(token);
+    if (token != "0" && token != "1")
+        throw invalid_argument("Malformed verdict: " + string(token));
+    return BigNum(token == "1" ? 1 : 0);
+}
+
+void writeValue(OutputWriter &out, RecordLayout layout, const BigNum &x)
+{
+    if (layout == LAYOUT_VERDICT)
+        out.put(x.isZero() ? '0' : '1');
+    else
+        out.writeHex(x);
+}
+
+// ========================== Text to records ==========================
+
+// The text layouts of the tools: primitive-root is p, a count line, the
+// factors on one line, g; dh may leave out q; the rest are whitespace-separated
+// values, any number of whole records
+void textToRecords(InputReader &in, OutputWriter &out, const RecordLayoutInfo &info)
+{
+    if (info.layout == LAYOUT_PRIMITIVE_ROOT)
+    {
+        string_view p, count, factors, g, t;
+        in.nextLine(p);
+        in.nextLine(count);
+        in.nextLine(factors);
+        in.nextLine(g);
+        vector<BigNum> U;
+        while (splitToken(factors, t))
+            U.push_back(BigNum(t));
+
+        RecordWriter records(out, info.layout, 1);
+        records.write(BigNum(p));
+        records.writeCount(U.size());
+        for (const BigNum &k : U)
+            records.write(k);
+        records.write(BigNum(g));
+        return;
+    }
+
+    vector<string_view> tokens;
+    string_view t;
+    while (in.nextToken(t))
+        tokens.push_back(t);
+    if (info.layout == LAYOUT_DH && tokens.size() == 4)
+        tokens.push_back("00");
+    if (tokens.size() % info.fields != 0)
+        throw invalid_argument(to_string(tokens.size()) + " values do not make whole " + info.name + " records");
+
+    RecordWriter records(out, info.layout, tokens.size() / info.fields);
+    for (string_view token : tokens)
+        records.write(parseValue(info.layout, token));
+}
+
+// ========================== Records to text ==========================
+
+void recordsToText(RecordReader &records, OutputWriter &out)
+{
+    RecordLayout layout = records.layout();
+    const RecordLayoutInfo &info = *findRecordLayout(layout);
+    BigNum x;
+    for (uint64_t r = 0; r < records.recordCount(); r++)
+    {
+        if (layout == LAYOUT_PRIMITIVE_ROOT)
+        {
+            out.writeHex(records.next());
+            uint64_t k = records.nextCount();
+            out.write("\n" + to_string(k) + "\n");
+            for (uint64_t i = 0; i < k; i++)
+            {
+                if (i > 0)
+                    out.put(' ');
+                out.writeHex(records.next());
+            }
+            out.put('\n');
+            out.writeHex(records.next());
+            out.put('\n');
+            continue;
+        }
+
+        for (uint32_t f = 0; f < info.fields; f++)
+        {
+            records.next(x);
+            if (layout == LAYOUT_DH && f == 4 && x.isZero())
+                continue; // no q line
+            writeValue(out, layout, x);
+            out.put('\n');
+        }
+    }
+}
+
+// ========================== MAIN FUNCTION ==========================
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        cerr << "Usage: " << argv[0] << " inputFile outputFile [--layout NAME]\n"
+             << "Layouts:";
+        for (const RecordLayoutInfo &info : RECORD_LAYOUTS)
+            cerr << " " << info.name;
+        cerr << "\n";
+        return 1;
+    }
+
+    const RecordLayoutInfo *layout = nullptr;
+    for (int i = 3; i < argc; i++)
+    {
+        string opt = argv[i];
+        if (opt == "--layout" && i + 1 < argc)
+        {
+            layout = findRecordLayout(string_view(argv[++i]));
+            if (!layout)
+            {
+                cerr << "Unknown layout: " << argv[i] << "\n";
+                return 1;
+            }
+        }
+        else
+        {
+            cerr << "Unknown option: " << opt << "\n";
+            return 1;
+        }
+    }
+
+    InputReader in;
+    if (!in.open(argv[1]))
+    {
+        cerr << "Cannot open input file\n";
+        return 1;
+    }
+    bool toText = RecordReader::isRecordFile(in.contents());
+    if (!toText && !layout)
+    {
+        cerr << "Text input needs --layout\n";
+        return 1;
+    }
+
+    OutputWriter out;
+    if (!out.open(argv[2]))
+    {
+        cerr << "Cannot open output file\n";
+        return 1;
+    }
+
+    try
+    {
+        if (toText)
+        {
+            RecordReader records(in.contents());
+            recordsToText(records, out);
+        }
+        else
+            textToRecords(in, out, *layout);
+    }
+    catch (const invalid_argument &e)
+    {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+
+    if (!out.close())
+    {
+        cerr << "Cannot write output file\n";
+        return 1;
+    }
+    return 0;
+}
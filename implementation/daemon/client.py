@@ -0,0 +1,117 @@
+"""
+Client for the operation daemon (daemon/main.cpp).
+
+Start the daemon once, e.g. `./daemon /tmp/bignum.sock &`, then:
+
+    from client import DaemonClient
+    with DaemonClient("/tmp/bignum.sock") as d:
+        A, B, K = d.dh(p, g, a, b)
+        ok = d.verify(p, g, y, m, r, s)
+        results = d.run([(ELGAMAL_VERIFY, [p, g, y, m, r, s]), ...])
+
+run() keeps many requests in flight on the one connection, which is where
+the daemon is fastest. Values are Python ints.
+"""
+import socket
+import struct
+
+# Record layouts (common/record_format.h)
+PRIMITIVE_ROOT, DH, ELGAMAL_DECRYPT, ELGAMAL_VERIFY = 1, 2, 3, 4
+VERDICT, DH_KEYS, PLAINTEXT = 5, 6, 8
+ERROR = 0
+
+
+class DaemonError(Exception):
+    pass
+
+
+def encode_value(x):
+    limbs = (x.bit_length() + 31) // 32
+    return struct.pack("<I", limbs) + x.to_bytes(4 * limbs, "little")
+
+
+def decode_values(body):
+    values, pos = [], 0
+    while pos < len(body):
+        (limbs,) = struct.unpack_from("<I", body, pos)
+        pos += 4
+        values.append(int.from_bytes(body[pos:pos + 4 * limbs], "little"))
+        pos += 4 * limbs
+    return values
+
+
+class DaemonClient:
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.buffer = b""
+        self.next_id = 0
+
+    def close(self):
+        self.sock.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def _send(self, layout, values):
+        request_id = self.next_id
+        self.next_id = (self.next_id + 1) & 0xFFFFFFFF
+        body = b"".join(encode_value(v) for v in values)
+        self.sock.sendall(struct.pack("<III", 8 + len(body), request_id, layout) + body)
+        return request_id
+
+    def _receive(self):
+        while True:
+            if len(self.buffer) >= 4:
+                (length,) = struct.unpack_from("<I", self.buffer)
+                if len(self.buffer) >= 4 + length:
+                    frame, self.buffer = self.buffer[4:4 + length], self.buffer[4 + length:]
+                    request_id, layout = struct.unpack_from("<II", frame)
+                    return request_id, layout, frame[8:]
+            chunk = self.sock.recv(1 << 16)
+            if not chunk:
+                raise DaemonError("connection closed by the daemon")
+            self.buffer += chunk
+
+    @staticmethod
+    def _result(layout, body):
+        if layout == ERROR:
+            return DaemonError(body.decode(errors="replace"))
+        values = decode_values(body)
+        return values[0] == 1 if layout == VERDICT else tuple(values)
+
+    def run(self, requests, window=256):
+        """(layout, values) pairs -> results in the same order. A failed
+        request's result is a DaemonError instance rather than raised."""
+        results = [None] * len(requests)
+        slot = {}
+        for i, (layout, values) in enumerate(requests):
+            slot[self._send(layout, values)] = i
+            while len(slot) >= window:
+                request_id, layout, body = self._receive()
+                results[slot.pop(request_id)] = self._result(layout, body)
+        while slot:
+            request_id, layout, body = self._receive()
+            results[slot.pop(request_id)] = self._result(layout, body)
+        return results
+
+    def call(self, layout, values):
+        result = self.run([(layout, values)])[0]
+        if isinstance(result, DaemonError):
+            raise result
+        return result
+
+    def primitive_root(self, p, factors, g):
+        return self.call(PRIMITIVE_ROOT, [p, len(factors)] + list(factors) + [g])
+
+    def dh(self, p, g, a, b, q=0):
+        return self.call(DH, [p, g, a, b, q])
+
+    def decrypt(self, p, g, x, c1, c2):
+        return self.call(ELGAMAL_DECRYPT, [p, g, x, c1, c2])
+
+    def verify(self, p, g, y, m, r, s):
+        return self.call(ELGAMAL_VERIFY, [p, g, y, m, r, s])
@@ -0,0 +1,593 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../common/operations.h"
+#include "../common/record_format.h"
+#include "../common/stats.h"
+using namespace std;
+
+// Serves the four tools' operations over a Unix domain socket, so a harness
+// issuing many operations pays process start-up and group setup once and
+// each request costs only its arithmetic.
+//
+// Frames are little-endian in both directions:
+//   uint32 length (of the rest of the frame) | uint32 id | uint32 layout | values
+// A request holds one record of an input layout (primitive-root, dh,
+// elgamal-decrypt, elgamal-verify), values encoded as in record files. The
+// response carries the request's id and one record of the result layout
+// (verdict, dh-keys, plaintext), or layout 0 and an error message. Requests
+// on a connection may be pipelined; responses come back as they complete,
+// not necessarily in order.
+
+const uint32_t MAX_FRAME = 64 << 20;
+const uint32_t LAYOUT_ERROR = 0;
+const size_t MAX_IN_FLIGHT = 4096;    // per connection; reading pauses above it
+const size_t MAX_UNSENT = 16 << 20;   // likewise for responses the peer has not read
+
+struct Job
+{
+    uint64_t conn;
+    uint32_t id;
+    uint32_t layout;
+    string values;
+};
+
+struct Completion
+{
+    uint64_t conn;
+    string frame;
+};
+
+void appendWord(string &out, uint32_t w)
+{
+    out.append(reinterpret_cast<const char *>(&w), sizeof(w));
+}
+
+// Runs one request and frames its response; any exception (bad input,
+// out of memory) becomes an error frame rather than ending the worker
+string respond(Operations &ops, const Job &job)
+{
+    vector<BigNum> results;
+    uint32_t layout;
+    string error;
+    try
+    {
+        RecordReader in(RecordLayout(job.layout), job.values);
+        switch (job.layout)
+        {
+        case LAYOUT_PRIMITIVE_ROOT:
+        {
+            BigNum p = in.next();
+            vector<BigNum> U;
+            for (uint64_t k = in.nextCount(); k > 0; k--)
+                U.push_back(in.next());
+            BigNum g = in.next();
+            results.push_back(BigNum(ops.primitiveRoot(p, U, g) ? 1 : 0));
+            layout = LAYOUT_VERDICT;
+            break;
+        }
+        case LAYOUT_DH:
+        {
+            BigNum p = in.next(), g = in.next(), a = in.next(), b = in.next(), q = in.next();
+            results.resize(3);
+            ops.dh(p, g, a, b, q, results[0], results[1], results[2]);
+            layout = LAYOUT_DH_KEYS;
+            break;
+        }
+        case LAYOUT_ELGAMAL_DECRYPT:
+        {
+            BigNum p = in.next(), g = in.next(), x = in.next(), c1 = in.next(), c2 = in.next();
+            results.resize(2);
+            ops.decrypt(p, g, x, c1, c2, results[0], results[1]);
+            layout = LAYOUT_PLAINTEXT;
+            break;
+        }
+        case LAYOUT_ELGAMAL_VERIFY:
+        {
+            BigNum p = in.next(), g = in.next(), y = in.next(), m = in.next(), r = in.next(), s = in.next();
+            results.push_back(BigNum(ops.verify(p, g, y, m, r, s) ? 1 : 0));
+            layout = LAYOUT_VERDICT;
+            break;
+        }
+        default:
+            throw invalid_argument(string("Not a request layout: ") + findRecordLayout(job.layout)->name);
+        }
+        if (!in.atEnd())
+            throw invalid_argument("Extra bytes after the request's values");
+    }
+    catch (const exception &e)
+    {
+        layout = LAYOUT_ERROR;
+        error = e.what();
+        results.clear();
+    }
+
+    size_t bodySize = error.size();
+    for (const BigNum &x : results)
+        bodySize += recordValueSize(x);
+    string frame;
+    frame.reserve(12 + bodySize);
+    appendWord(frame, uint32_t(8 + bodySize));
+    appendWord(frame, job.id);
+    appendWord(frame, layout);
+    if (layout == LAYOUT_ERROR)
+        frame += error;
+    else
+        for (const BigNum &x : results)
+        {
+            size_t at = frame.size();
+            frame.resize(at + recordValueSize(x));
+            encodeRecordValue(x, &frame[at]);
+        }
+    return frame;
+}
+
+// ========================== CLASS ComputePool ==========================
+
+// Worker threads, each with its own Operations (warm groups and signer
+// tables, no locking around them). Finished frames are collected for the
+// event loop, which is woken through an eventfd. A worker counts as a busy
+// core, so a request only spreads over helper threads while workers idle.
+class ComputePool
+{
+private:
+    vector<thread> workers;
+    mutex jobLock;
+    condition_variable jobReady;
+    deque<Job> jobs;
+    bool stopping = false;
+
+    mutex doneLock;
+    vector<Completion> done;
+    int wakeFd;
+
+    void run(size_t signerCacheBytes, bool constantTime);
+
+public:
+    ComputePool(unsigned threads, size_t signerCacheBytes, bool constantTime, int wakeFd);
+    ~ComputePool();
+
+    void submit(vector<Job> &batch);
+    void cancel(uint64_t conn);
+    void takeDone(vector<Completion> &out);
+};
+
+ComputePool::ComputePool(unsigned threads, size_t signerCacheBytes, bool constantTime, int wakeFd) : wakeFd(wakeFd)
+{
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back(&ComputePool::run, this, signerCacheBytes, constantTime);
+}
+
+ComputePool::~ComputePool()
+{
+    {
+        lock_guard<mutex> guard(jobLock);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (thread &t : workers)
+        t.join();
+}
+
+void ComputePool::run(size_t signerCacheBytes, bool constantTime)
+{
+    Operations ops(signerCacheBytes);
+    ops.setConstantTime(constantTime);
+    while (true)
+    {
+        Job job;
+        {
+            unique_lock<mutex> guard(jobLock);
+            jobReady.wait(guard, [this] { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = move(jobs.front());
+            jobs.pop_front();
+        }
+
+        Completion c;
+        {
+            TaskPool::Busy busy;
+            STATS_PHASE(EXPONENTIATE);
+            c = Completion{job.conn, respond(ops, job)};
+        }
+        {
+            lock_guard<mutex> guard(doneLock);
+            done.push_back(move(c));
+        }
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            perror("eventfd");
+    }
+}
+
+void ComputePool::submit(vector<Job> &batch)
+{
+    if (batch.empty())
+        return;
+    {
+        lock_guard<mutex> guard(jobLock);
+        for (Job &job : batch)
+            jobs.push_back(move(job));
+    }
+    if (batch.size() == 1)
+        jobReady.notify_one();
+    else
+        jobReady.notify_all();
+    batch.clear();
+}
+
+// Drops the queued jobs of a connection that has gone away
+void ComputePool::cancel(uint64_t conn)
+{
+    lock_guard<mutex> guard(jobLock);
+    jobs.erase(remove_if(jobs.begin(), jobs.end(), [conn](const Job &job) { return job.conn == conn; }), jobs.end());
+}
+
+void ComputePool::takeDone(vector<Completion> &out)
+{
+    lock_guard<mutex> guard(doneLock);
+    out.swap(done);
+}
+
+// ========================== CLASS Server ==========================
+
+// Single-threaded epoll loop: accepts connections, cuts requests out of the
+// byte stream, hands them to the pool, and writes responses back. Connection
+// ids are never reused, so responses for a connection that has gone away
+// are dropped.
+class Server
+{
+private:
+    enum : uint64_t { TAG_LISTEN, TAG_WAKE, TAG_SIGNAL, FIRST_CONNECTION };
+
+    struct Connection
+    {
+        int fd;
+        string in, out;
+        size_t inPos = 0, outPos = 0;
+        size_t inFlight = 0;
+        uint32_t events = 0;
+        bool eof = false;
+    };
+
+    int listenFd = -1, epollFd = -1, wakeFd = -1, signalFd = -1;
+    string path;
+    unique_ptr<ComputePool> pool;
+    unordered_map<uint64_t, Connection> connections;
+    uint64_t nextConnection = FIRST_CONNECTION;
+    vector<Job> batch;
+
+    void watch(int fd, uint64_t tag, uint32_t events);
+    void accept();
+    void readFrom(uint64_t id, Connection &c);
+    void flush(uint64_t id, Connection &c);
+    void update(uint64_t id, Connection &c);
+    void drop(uint64_t id);
+    void deliver();
+
+public:
+    ~Server();
+    bool open(const string &socketPath, unsigned workers, size_t signerCacheBytes, bool constantTime);
+    void serve();
+};
+
+Server::~Server()
+{
+    pool.reset();
+    for (auto &entry : connections)
+        close(entry.second.fd);
+    for (int fd : {listenFd, epollFd, wakeFd, signalFd})
+        if (fd >= 0)
+            close(fd);
+    if (!path.empty())
+        unlink(path.c_str());
+}
+
+void Server::watch(int fd, uint64_t tag, uint32_t events)
+{
+    epoll_event ev = {};
+    ev.events = events;
+    ev.data.u64 = tag;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+bool Server::open(const string &socketPath, unsigned workers, size_t signerCacheBytes, bool constantTime)
+{
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path))
+    {
+        cerr << "Socket path too long\n";
+        return false;
+    }
+    memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(socketPath.c_str());
+    if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        listen(listenFd, SOMAXCONN) != 0)
+    {
+        perror(socketPath.c_str());
+        return false;
+    }
+    path = socketPath;
+
+    // SIGINT/SIGTERM arrive through the loop, which then shuts down cleanly
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (signalFd < 0 || wakeFd < 0 || epollFd < 0)
+    {
+        perror("daemon");
+        return false;
+    }
+    watch(listenFd, TAG_LISTEN, EPOLLIN);
+    watch(wakeFd, TAG_WAKE, EPOLLIN);
+    watch(signalFd, TAG_SIGNAL, EPOLLIN);
+
+    // Signals are blocked first so the workers inherit the mask
+    pool.reset(new ComputePool(workers, signerCacheBytes, constantTime, wakeFd));
+    return true;
+}
+
+void Server::accept()
+{
+    while (true)
+    {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("accept");
+            return;
+        }
+        uint64_t id = nextConnection++;
+        Connection &c = connections[id];
+        c.fd = fd;
+        c.events = EPOLLIN;
+        watch(fd, id, EPOLLIN);
+    }
+}
+
+// Reads what is available and queues every complete request
+void Server::readFrom(uint64_t id, Connection &c)
+{
+    char chunk[1 << 16];
+    while (true)
+    {
+        ssize_t got = read(c.fd, chunk, sizeof(chunk));
+        if (got > 0)
+        {
+            c.in.append(chunk, got);
+            continue;
+        }
+        if (got == 0)
+            c.eof = true;
+        else if (errno == EINTR)
+            continue;
+        else if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            drop(id);
+            return;
+        }
+        break;
+    }
+
+    while (c.in.size() - c.inPos >= 4)
+    {
+        uint32_t length, header[2];
+        memcpy(&length, c.in.data() + c.inPos, 4);
+        if (length < 8 || length > MAX_FRAME)
+        {
+            cerr << "Dropping connection: bad frame length " << length << "\n";
+            drop(id);
+            return;
+        }
+        if (c.in.size() - c.inPos - 4 < length)
+            break;
+        memcpy(header, c.in.data() + c.inPos + 4, 8);
+        batch.push_back(Job{id, header[0], header[1], c.in.substr(c.inPos + 12, length - 8)});
+        c.inPos += 4 + length;
+        c.inFlight++;
+    }
+    if (c.inPos == c.in.size())
+    {
+        c.in.clear();
+        c.inPos = 0;
+    }
+    else if (c.inPos > c.in.size() / 2)
+    {
+        c.in.erase(0, c.inPos);
+        c.inPos = 0;
+    }
+    pool->submit(batch);
+    update(id, c);
+}
+
+void Server::flush(uint64_t id, Connection &c)
+{
+    while (c.outPos < c.out.size())
+    {
+        ssize_t sent = send(c.fd, c.out.data() + c.outPos, c.out.size() - c.outPos, MSG_NOSIGNAL);
+        if (sent > 0)
+            c.outPos += sent;
+        else if (sent < 0 && errno == EINTR)
+            continue;
+        else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        else
+        {
+            drop(id);
+            return;
+        }
+    }
+    if (c.outPos == c.out.size())
+    {
+        c.out.clear();
+        c.outPos = 0;
+    }
+    update(id, c);
+}
+
+// Interest follows state: read unless at EOF or over a limit, write while
+// output is pending; a finished connection is closed here
+void Server::update(uint64_t id, Connection &c)
+{
+    size_t unsent = c.out.size() - c.outPos;
+    if (c.eof && c.inFlight == 0 && unsent == 0)
+    {
+        drop(id);
+        return;
+    }
+    uint32_t events = 0;
+    if (!c.eof && c.inFlight < MAX_IN_FLIGHT && unsent < MAX_UNSENT)
+        events |= EPOLLIN;
+    if (unsent)
+        events |= EPOLLOUT;
+    if (events != c.events)
+    {
+        epoll_event ev = {};
+        ev.events = events;
+        ev.data.u64 = id;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+        c.events = events;
+    }
+}
+
+void Server::drop(uint64_t id)
+{
+    auto found = connections.find(id);
+    if (found == connections.end())
+        return;
+    close(found->second.fd); // also removes it from the epoll set
+    if (found->second.inFlight)
+        pool->cancel(id);
+    connections.erase(found);
+}
+
+// Moves finished responses to their connections' output
+void Server::deliver()
+{
+    uint64_t count;
+    while (read(wakeFd, &count, sizeof(count)) > 0)
+        ;
+    vector<Completion> done;
+    pool->takeDone(done);
+    vector<uint64_t> touched;
+    for (Completion &r : done)
+    {
+        auto found = connections.find(r.conn);
+        if (found == connections.end())
+            continue;
+        Connection &c = found->second;
+        c.inFlight--;
+        c.out += r.frame;
+        touched.push_back(r.conn);
+    }
+    for (uint64_t id : touched)
+    {
+        auto found = connections.find(id);
+        if (found != connections.end())
+            flush(id, found->second);
+    }
+}
+
+void Server::serve()
+{
+    epoll_event events[64];
+    while (true)
+    {
+        int n = epoll_wait(epollFd, events, 64, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            return;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            uint64_t tag = events[i].data.u64;
+            if (tag == TAG_SIGNAL)
+                return;
+            if (tag == TAG_LISTEN)
+                accept();
+            else if (tag == TAG_WAKE)
+                deliver();
+            else
+            {
+                auto found = connections.find(tag);
+                if (found == connections.end())
+                    continue;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    readFrom(tag, found->second);
+                found = connections.find(tag);
+                if (found != connections.end() && (events[i].events & EPOLLOUT))
+                    flush(tag, found->second);
+            }
+        }
+    }
+}
+
+// ========================== MAIN FUNCTION ==========================
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " socketPath [--workers N] [--signer-cache-mb N] [--constant-time] [--stats]\n";
+        return 1;
+    }
+
+    unsigned workers = max(1u, thread::hardware_concurrency());
+    size_t cacheMb = 64;
+    bool constantTime = false;
+    bool stats = false;  // --stats: counters and phase times as JSON on stderr at shutdown
+    for (int i = 2; i < argc; i++)
+    {
+        string opt = argv[i];
+        if (opt == "--workers" && i + 1 < argc)
+            workers = max(1, atoi(argv[++i]));
+        else if (opt == "--signer-cache-mb" && i + 1 < argc)
+            cacheMb = strtoul(argv[++i], nullptr, 10);
+        else if (opt == "--constant-time")
+            constantTime = true;
+        else if (opt == "--stats")
+            stats = true;
+        else
+        {
+            cerr << "Unknown option: " << opt << "\n";
+            return 1;
+        }
+    }
+
+    Server server;
+    if (!server.open(argv[1], workers, cacheMb << 20, constantTime))
+        return 1;
+    cerr << "Listening on " << argv[1] << " with " << workers << " workers\n";
+    server.serve();
+    if (stats)
+        cerr << statsJson("daemon") << "\n";
+    return 0;
+}
@@ -0,0 +1,491 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <memory>
+#include <cstdint>
+#include "../common/record_format.h"
+#include "../common/primality.h"
+using namespace std;
+
+// Seeded workloads for the four tools, in their text format or as record
+// files (common/record_format.h), with the answers the tools must give:
+//   primitive-root   p, the prime factors of p - 1, g      -> verdict
+//   dh               p, g, a, b, q (g of prime order q)    -> A, B, K
+//   elgamal-decrypt  p, g, x, c1, c2                       -> h, m
+//   elgamal-verify   p, g, y, m, r, s                      -> verdict
+// Each group is a prime p = 2kq + 1 with q prime and k below 2^19, so p - 1
+// is fully factored and has a subgroup of prime order q. Records cycle
+// through --groups groups; signatures come from --signers keys per group.
+// --invalid is the share of negative records: g not a primitive root, or a
+// signature with one value altered (its verdict is recomputed, since for a
+// tiny p the altered one may still verify). DH and decryption records are
+// always well formed.
+//
+// Every group and every record draws from its own stream of the seed, so the
+// output depends only on the arguments, not on --threads. Records are made in
+// blocks across the threads and written in order, so memory stays bounded for
+// any --count. Expected values are computed with plain BigNum::modPow, not
+// the tools' precomputed paths.
+//   g++ -O2 -std=c++17 gen/main.cpp -o gen/gen -lpthread
+//   ./gen/gen LAYOUT inputFile [expectedFile] [--count N] [--bits B] [--groups G]
+//       [--signers S] [--invalid F] [--seed S] [--threads T] [--records]
+
+const size_t BLOCK = 4096;
+
+struct Options
+{
+    const RecordLayoutInfo *layout = nullptr;
+    uint64_t count = 1;
+    int bits = 512;
+    unsigned groups = 1;
+    unsigned signers = 4;
+    double invalid = 0.1;
+    uint64_t seed = 1;
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    bool records = false;
+};
+
+// ========================== Randomness ==========================
+
+enum Stream : uint32_t
+{
+    STREAM_GROUP = 1,
+    STREAM_RECORD = 2,
+};
+
+// The stream of one group or record of a seed
+mt19937_64 streamFor(uint64_t seed, Stream kind, uint64_t index)
+{
+    seed_seq seq{uint32_t(seed), uint32_t(seed >> 32), uint32_t(kind), uint32_t(index), uint32_t(index >> 32)};
+    return mt19937_64(seq);
+}
+
+// Uniform below 2^bits, or with exactly `bits` bits if topBit
+BigNum randomBits(int bits, mt19937_64 &rng, bool topBit = true)
+{
+    vector<limb_t> x((bits + 31) / 32);
+    for (limb_t &l : x)
+        l = (limb_t)rng();
+    if (bits % 32)
+        x.back() &= (limb_t(1) << (bits % 32)) - 1;
+    if (topBit)
+        x.back() |= limb_t(1) << ((bits - 1) % 32);
+    return BigNum::fromLimbs(x.data(), x.size());
+}
+
+// Uniform in [lo, hi), by rejection
+BigNum randomRange(const BigNum &lo, const BigNum &hi, mt19937_64 &rng)
+{
+    BigNum span = hi - lo;
+    for (;;)
+    {
+        BigNum x = randomBits(span.bitLength(), rng, false);
+        if (x.cmp(span) < 0)
+            return lo + x;
+    }
+}
+
+// ========================== Primes ==========================
+
+BigNum randomPrime(int bits, mt19937_64 &rng)
+{
+    for (;;)
+    {
+        BigNum p = randomBits(bits, rng);
+        if (!p.isOdd())
+            p = p + BigNum(1);
+        if (p.bitLength() == bits && isProbablePrime(p, rng))
+            return p;
+    }
+}
+
+// ========================== Groups ==========================
+
+struct Group
+{
+    BigNum p, q;
+    vector<BigNum> factors; // distinct primes of p - 1, increasing
+    BigNum root;            // a primitive root
+    BigNum sub;             // an element of order q
+    vector<BigNum> keys;    // signers' private keys
+    vector<BigNum> publicKeys;
+    unique_ptr<MontContext> mont;
+};
+
+// p = 2kq + 1 of exactly `bits` bits
+Group makeGroup(int bits, unsigned signers, mt19937_64 &rng)
+{
+    Group G;
+    int kBits = min(19, bits / 4);
+    uint64_t k = 0;
+    for (bool found = false; !found;)
+    {
+        G.q = randomPrime(bits - kBits, rng);
+        for (int tries = 0; tries < 64 * bits && !found; tries++)
+        {
+            k = (uint64_t(1) << (kBits - 1)) | (rng() & ((uint64_t(1) << (kBits - 1)) - 1));
+            G.p = BigNum((long long)(2 * k)) * G.q + BigNum(1);
+            found = G.p.bitLength() == bits && isProbablePrime(G.p, rng);
+        }
+    }
+
+    G.factors.push_back(BigNum(2));
+    uint64_t rest = k;
+    while (rest % 2 == 0)
+        rest /= 2;
+    for (uint64_t d = 3; d * d <= rest; d += 2)
+        if (rest % d == 0)
+        {
+            G.factors.push_back(BigNum((long long)d));
+            while (rest % d == 0)
+                rest /= d;
+        }
+    if (rest > 1)
+        G.factors.push_back(BigNum((long long)rest));
+    G.factors.push_back(G.q);
+
+    G.mont.reset(new MontContext(G.p));
+    BigNum one(1), pMinus1 = G.p - one;
+    for (;;)
+    {
+        G.root = randomRange(BigNum(2), pMinus1, rng);
+        bool primitive = true;
+        for (const BigNum &f : G.factors)
+            primitive = primitive && G.mont->pow(G.root, pMinus1 / f).cmp(one) != 0;
+        if (primitive)
+            break;
+    }
+    G.sub = G.mont->pow(G.root, BigNum((long long)(2 * k)));
+
+    for (unsigned i = 0; i < signers; i++)
+    {
+        G.keys.push_back(randomRange(BigNum(2), pMinus1, rng));
+        G.publicKeys.push_back(G.mont->pow(G.root, G.keys.back()));
+    }
+    return G;
+}
+
+// ========================== Records ==========================
+
+struct Record
+{
+    vector<BigNum> input;    // in layout order; primitive-root: p, U_1 .. U_k, g
+    vector<BigNum> expected; // in the result layout's order
+};
+
+// gcd(e, p - 1) = 1, by the known factors of p - 1
+bool coprimeToOrder(const Group &G, const BigNum &e)
+{
+    for (const BigNum &f : G.factors)
+        if ((e % f).isZero())
+            return false;
+    return true;
+}
+
+// k^-1 mod p - 1 for k coprime to it, through the odd-modulus inverse: with
+// u = (p - 1)^-1 mod k, (p - 1) u = 1 + k t and k (p - 1 - t) = 1 mod p - 1
+BigNum inverseModOrder(const BigNum &k, const BigNum &pMinus1)
+{
+    BigNum u = BigNum::modInverse(pMinus1 % k, k);
+    return pMinus1 - (pMinus1 * u - BigNum(1)) / k;
+}
+
+// g^m == y^r * r^s with 0 < r < p and 0 < s < p - 1, as project4 decides it
+bool signatureHolds(const BigNum &p, const BigNum &g, const BigNum &y, const BigNum &m, const BigNum &r,
+                    const BigNum &s)
+{
+    if (r.isZero() || r.cmp(p) >= 0 || s.isZero() || s.cmp(p - BigNum(1)) >= 0)
+        return false;
+    BigNum right = (BigNum::modPow(y, r, p) * BigNum::modPow(r, s, p)) % p;
+    return BigNum::modPow(g, m, p).cmp(right) == 0;
+}
+
+Record primitiveRootRecord(const Group &G, bool invalid, mt19937_64 &rng)
+{
+    BigNum pMinus1 = G.p - BigNum(1), e;
+    // root^e is primitive exactly when gcd(e, p - 1) = 1
+    do
+        e = randomRange(BigNum(1), pMinus1, rng);
+    while (!coprimeToOrder(G, e));
+    if (invalid)
+        e = (e * G.factors[rng() % G.factors.size()]) % pMinus1;
+
+    Record rec;
+    rec.input.push_back(G.p);
+    rec.input.insert(rec.input.end(), G.factors.begin(), G.factors.end());
+    rec.input.push_back(G.mont->pow(G.root, e));
+    rec.expected.push_back(BigNum(invalid ? 0 : 1));
+    return rec;
+}
+
+Record dhRecord(const Group &G, mt19937_64 &rng)
+{
+    BigNum a = randomRange(BigNum(1), G.q, rng), b = randomRange(BigNum(1), G.q, rng);
+    BigNum A = G.mont->pow(G.sub, a);
+    return {{G.p, G.sub, a, b, G.q}, {A, G.mont->pow(G.sub, b), G.mont->pow(A, b)}};
+}
+
+Record decryptRecord(const Group &G, mt19937_64 &rng)
+{
+    BigNum pMinus1 = G.p - BigNum(1);
+    BigNum x = randomRange(BigNum(1), pMinus1, rng), k = randomRange(BigNum(1), pMinus1, rng);
+    BigNum m = randomRange(BigNum(1), G.p, rng), h = G.mont->pow(G.root, x);
+    BigNum c1 = G.mont->pow(G.root, k), c2 = G.mont->mulMod(m, G.mont->pow(h, k));
+    return {{G.p, G.root, x, c1, c2}, {h, m}};
+}
+
+Record verifyRecord(const Group &G, bool invalid, mt19937_64 &rng)
+{
+    BigNum one(1), pMinus1 = G.p - one;
+    size_t signer = rng() % G.keys.size();
+    const BigNum &x = G.keys[signer];
+    BigNum y = G.publicKeys[signer], m = randomRange(one, pMinus1, rng), r, s;
+    do
+    {
+        BigNum k;
+        do
+            k = randomRange(BigNum(2), pMinus1, rng);
+        while (!coprimeToOrder(G, k));
+        BigNum kInv = inverseModOrder(k, pMinus1);
+        r = G.mont->pow(G.root, k);
+        // s = (m - x r) / k mod p - 1
+        s = ((m + pMinus1 - (x * r) % pMinus1) * kInv) % pMinus1;
+    } while (s.isZero());
+
+    bool holds = true;
+    if (invalid)
+    {
+        switch (rng() % 4)
+        {
+        case 0:
+            m = (m + one) % pMinus1;
+            break;
+        case 1:
+            r = r + one; // may reach p, out of range
+            break;
+        case 2:
+            s = (s + one) % pMinus1;
+            break;
+        default:
+            y = G.mont->mulMod(y, G.root); // another key
+            break;
+        }
+        holds = signatureHolds(G.p, G.root, y, m, r, s);
+    }
+    return {{G.p, G.root, y, m, r, s}, {BigNum(holds ? 1 : 0)}};
+}
+
+Record makeRecord(const Options &opt, const Group &G, mt19937_64 &rng)
+{
+    bool invalid = uniform_real_distribution<double>(0, 1)(rng) < opt.invalid;
+    switch (opt.layout->layout)
+    {
+    case LAYOUT_PRIMITIVE_ROOT:
+        return primitiveRootRecord(G, invalid, rng);
+    case LAYOUT_DH:
+        return dhRecord(G, rng);
+    case LAYOUT_ELGAMAL_DECRYPT:
+        return decryptRecord(G, rng);
+    default:
+        return verifyRecord(G, invalid, rng);
+    }
+}
+
+// ========================== Output ==========================
+
+RecordLayout resultLayout(RecordLayout layout)
+{
+    switch (layout)
+    {
+    case LAYOUT_DH:
+        return LAYOUT_DH_KEYS;
+    case LAYOUT_ELGAMAL_DECRYPT:
+        return LAYOUT_PLAINTEXT;
+    default:
+        return LAYOUT_VERDICT;
+    }
+}
+
+// One file of records, as a record file or in the tools' text layout
+class RecordOutput
+{
+private:
+    OutputWriter out;
+    RecordLayout layout;
+    unique_ptr<RecordWriter> records;
+
+public:
+    bool open(const string &path, RecordLayout layout, uint64_t count, bool binary)
+    {
+        this->layout = layout;
+        if (!out.open(path))
+            return false;
+        if (binary)
+            records.reset(new RecordWriter(out, layout, count));
+        return true;
+    }
+
+    void write(const vector<BigNum> &values)
+    {
+        if (records)
+        {
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                if (layout == LAYOUT_PRIMITIVE_ROOT && i == 1)
+                    records->writeCount(values.size() - 2);
+                records->write(values[i]);
+            }
+            return;
+        }
+        if (layout == LAYOUT_VERDICT)
+        {
+            out.write(values[0].isZero() ? "0\n" : "1\n");
+            return;
+        }
+        if (layout == LAYOUT_PRIMITIVE_ROOT)
+        {
+            // p, a count line, the factors on one line, g
+            out.writeHex(values[0]);
+            out.write("\n" + to_string(values.size() - 2) + "\n");
+            for (size_t i = 1; i + 1 < values.size(); i++)
+            {
+                if (i > 1)
+                    out.put(' ');
+                out.writeHex(values[i]);
+            }
+            out.put('\n');
+            out.writeHex(values.back());
+            out.put('\n');
+            return;
+        }
+        for (const BigNum &x : values)
+        {
+            out.writeHex(x);
+            out.put('\n');
+        }
+    }
+
+    bool close() { return out.close(); }
+};
+
+// ========================== MAIN FUNCTION ==========================
+
+// Runs f(i) for i in [0, n) on `threads` threads
+template <class F>
+void parallelFor(size_t n, unsigned threads, F f)
+{
+    atomic<size_t> next(0);
+    auto work = [&] {
+        for (size_t i; (i = next++) < n;)
+            f(i);
+    };
+    vector<thread> pool;
+    for (unsigned t = 1; t < min<size_t>(threads, n); t++)
+        pool.emplace_back(work);
+    work();
+    for (thread &t : pool)
+        t.join();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        cerr << "Usage: " << argv[0]
+             << " LAYOUT inputFile [expectedFile] [--count N] [--bits B] [--groups G] [--signers S] [--invalid F]"
+                " [--seed S] [--threads T] [--records]\n"
+             << "Layouts: primitive-root dh elgamal-decrypt elgamal-verify\n";
+        return 1;
+    }
+
+    Options opt;
+    opt.layout = findRecordLayout(string_view(argv[1]));
+    if (!opt.layout || opt.layout->layout > LAYOUT_ELGAMAL_VERIFY)
+    {
+        cerr << "Unknown layout: " << argv[1] << "\n";
+        return 1;
+    }
+    string inputPath = argv[2], expectedPath;
+    int i = 3;
+    if (i < argc && argv[i][0] != '-')
+        expectedPath = argv[i++];
+    for (; i < argc; i++)
+    {
+        string o = argv[i];
+        if (o == "--count" && i + 1 < argc)
+            opt.count = strtoull(argv[++i], nullptr, 10);
+        else if (o == "--bits" && i + 1 < argc)
+            opt.bits = atoi(argv[++i]);
+        else if (o == "--groups" && i + 1 < argc)
+            opt.groups = strtoul(argv[++i], nullptr, 10);
+        else if (o == "--signers" && i + 1 < argc)
+            opt.signers = strtoul(argv[++i], nullptr, 10);
+        else if (o == "--invalid" && i + 1 < argc)
+            opt.invalid = atof(argv[++i]);
+        else if (o == "--seed" && i + 1 < argc)
+            opt.seed = strtoull(argv[++i], nullptr, 10);
+        else if (o == "--threads" && i + 1 < argc)
+            opt.threads = max(1ul, strtoul(argv[++i], nullptr, 10));
+        else if (o == "--records")
+            opt.records = true;
+        else
+        {
+            cerr << "Unknown option: " << o << "\n";
+            return 1;
+        }
+    }
+    if (opt.bits < 16 || opt.count == 0 || opt.groups == 0 || opt.signers == 0)
+    {
+        cerr << "Need --bits of at least 16 and a nonzero --count, --groups and --signers\n";
+        return 1;
+    }
+
+    using clock = chrono::steady_clock;
+    auto start = clock::now();
+    vector<Group> groups(min<uint64_t>(opt.groups, opt.count));
+    parallelFor(groups.size(), opt.threads, [&](size_t g) {
+        mt19937_64 rng = streamFor(opt.seed, STREAM_GROUP, g);
+        groups[g] = makeGroup(opt.bits, opt.signers, rng);
+    });
+    double groupSeconds = chrono::duration<double>(clock::now() - start).count();
+
+    RecordOutput input, expected;
+    RecordLayout layout = opt.layout->layout;
+    if (!input.open(inputPath, layout, opt.count, opt.records) ||
+        (!expectedPath.empty() && !expected.open(expectedPath, resultLayout(layout), opt.count, opt.records)))
+    {
+        cerr << "Cannot open output file\n";
+        return 1;
+    }
+
+    vector<Record> block;
+    for (uint64_t first = 0; first < opt.count; first += BLOCK)
+    {
+        block.assign(min<uint64_t>(BLOCK, opt.count - first), Record());
+        parallelFor(block.size(), opt.threads, [&](size_t k) {
+            mt19937_64 rng = streamFor(opt.seed, STREAM_RECORD, first + k);
+            block[k] = makeRecord(opt, groups[(first + k) % groups.size()], rng);
+        });
+        for (const Record &rec : block)
+        {
+            input.write(rec.input);
+            if (!expectedPath.empty())
+                expected.write(rec.expected);
+        }
+    }
+    if (!input.close() || (!expectedPath.empty() && !expected.close()))
+    {
+        cerr << "Cannot write output file\n";
+        return 1;
+    }
+
+    double seconds = chrono::duration<double>(clock::now() - start).count();
+    cout << opt.count << " " << opt.layout->name << " records, " << groups.size() << " groups of " << opt.bits
+         << " bits, in " << seconds << " s (groups " << groupSeconds << " s, " << opt.threads << " threads)\n";
+    return 0;
+}
@@ -5,300 +5,77 @@
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#include "../common/record_format.h"
+#include "../common/operations.h"
+#include "../common/stats.h"
 using namespace std;
-// using u32 = uint32_t;
-// using u64 = uint64_t;
-// using u128 = __uint128_t;
-// using Big = vector<u32>;
-class BigNum
-{
-private:
-    vector<int> digits;
-
-public:
-    BigNum();
-    BigNum(long long val);
-    BigNum(string hexStr);
-
-    void fromReversedHex(string hexStr);
-    string toReversedHex() const;
-    int cmp(const BigNum &b) const;
-    bool isZero() const;
-    bool isOdd() const;
-    BigNum div2() const;
-
-    BigNum operator+(const BigNum &b) const;
-    BigNum operator-(const BigNum &b) const;
-    BigNum operator*(const BigNum &b) const;
-    BigNum operator%(const BigNum &b) const;
-    BigNum operator/(const BigNum &b) const;
-    static BigNum modPow(const BigNum &base, const BigNum &exp, const BigNum &mod);
-    const vector<int> &getDigits() const { return digits; }
-};
-
-BigNum::BigNum() { digits = {0}; }
-
-BigNum::BigNum(long long val)
-{
-    digits.clear();
-    if (val == 0)
-    {
-        digits.push_back(0);
-        return;
-    }
-    while (val > 0)
-    {
-        digits.push_back(val % 256);
-        val /= 256;
-    }
-}
-
-BigNum::BigNum(string hexStr) { fromReversedHex(hexStr); }
-
-void BigNum::fromReversedHex(string hexStr)
-{
-    string s;
-    for (char c : hexStr)
-        if (!isspace((unsigned char)c))
-            s += c;
-    reverse(s.begin(), s.end());
-    if (s.empty())
-    {
-        digits = {0};
-        return;
-    }
-    if (s.size() % 2 != 0)
-        s = "0" + s;
-    digits.clear();
-    for (int i = s.size() - 2; i >= 0; i -= 2)
-    {
-        char hi_c = s[i];
-        char lo_c = s[i + 1];
-        int hi = isdigit(static_cast<unsigned char>(hi_c)) ? (hi_c - '0')
-                                                           : (toupper(static_cast<unsigned char>(hi_c)) - 'A' + 10);
-        int lo = isdigit(static_cast<unsigned char>(lo_c)) ? (lo_c - '0')
-                                                           : (toupper(static_cast<unsigned char>(lo_c)) - 'A' + 10);
-        digits.push_back(((hi << 4) | lo) & 0xFF);
-    }
-    while (digits.size() > 1 && digits.back() == 0)
-        digits.pop_back();
-}
-
-string BigNum::toReversedHex() const
-{
-    static const char HEX[] = "0123456789ABCDEF";
-    if (digits.empty())
-        return "00";
-
-    string out;
-    for (int i = static_cast<int>(digits.size()) - 1; i >= 0; --i)
-    {
-        int b = digits[i];
-        out += HEX[(b >> 4) & 0xF];
-        out += HEX[b & 0xF];
-    }
-    if (out.empty())
-        return "00";
-    size_t pos = out.find_first_not_of('0');
-    if (pos == string::npos)
-        return "00";
-    return out.substr(pos);
-}
-
-int BigNum::cmp(const BigNum &b) const
-{
-    if (digits.size() != b.digits.size())
-        return digits.size() < b.digits.size() ? -1 : 1;
-    for (int i = digits.size() - 1; i >= 0; i--)
-        if (digits[i] != b.digits[i])
-            return digits[i] < b.digits[i] ? -1 : 1;
-    return 0;
-}
-
-bool BigNum::isZero() const { return digits.empty() || digits.size() == 1 && digits[0] == 0; }
-bool BigNum::isOdd() const { return digits[0] & 1; }
-
-BigNum BigNum::div2() const
-{
-    BigNum r = *this;
-    int carry = 0;
-    for (int i = r.digits.size() - 1; i >= 0; i--)
-    {
-        int cur = r.digits[i] + carry * 256;
-        r.digits[i] = cur / 2;
-        carry = cur % 2;
-    }
-    while (r.digits.size() > 1 && r.digits.back() == 0)
-        r.digits.pop_back();
-    return r;
-}
-
-BigNum BigNum::operator+(const BigNum &b) const
-{
-    BigNum r;
-    r.digits.assign(max(digits.size(), b.digits.size()) + 1, 0);
-    int carry = 0;
-    for (size_t i = 0; i < r.digits.size(); i++)
-    {
-        int sum = carry;
-        if (i < digits.size())
-            sum += digits[i];
-        if (i < b.digits.size())
-            sum += b.digits[i];
-        r.digits[i] = sum % 256;
-        carry = sum / 256;
-    }
-    while (r.digits.size() > 1 && r.digits.back() == 0)
-        r.digits.pop_back();
-    return r;
-}
-
-BigNum BigNum::operator-(const BigNum &b) const
-{
-    BigNum r;
-    r.digits.assign(digits.size(), 0);
-    int borrow = 0;
-    for (size_t i = 0; i < digits.size(); i++)
-    {
-        int diff = digits[i] - (i < b.digits.size() ? b.digits[i] : 0) - borrow;
-        if (diff < 0)
-        {
-            diff += 256;
-            borrow = 1;
-        }
-        else
-            borrow = 0;
-        r.digits[i] = diff;
-    }
-    while (r.digits.size() > 1 && r.digits.back() == 0)
-        r.digits.pop_back();
-    return r;
-}
 
-BigNum BigNum::operator*(const BigNum &b) const
+// 10^(9 * 2^k), grown on demand and kept for later calls. References stay
+// valid until the table next grows.
+const BigNum &decimalPower(size_t k)
 {
-    BigNum r;
-    r.digits.assign(digits.size() + b.digits.size(), 0);
-    for (size_t i = 0; i < digits.size(); i++)
+    static vector<BigNum> powers = {BigNum(1000000000)};
+    while (powers.size() <= k)
     {
-        long long carry = 0;
-        for (size_t j = 0; j < b.digits.size() || carry; j++)
-        {
-            long long cur = r.digits[i + j] +
-                            (long long)digits[i] * (j < b.digits.size() ? b.digits[j] : 0) + carry;
-            r.digits[i + j] = cur % 256;
-            carry = cur / 256;
-        }
+        BigNum sq;
+        BigNum::sqrTo(sq, powers.back());
+        powers.push_back(sq);
     }
-    while (r.digits.size() > 1 && r.digits.back() == 0)
-        r.digits.pop_back();
-    return r;
+    return powers[k];
 }
 
-BigNum BigNum::operator%(const BigNum &m) const
+// Divide and conquer: each level splits every piece into high and low halves
+// by one power from the table (so the divisor's reciprocal is reused across
+// the level), until pieces are below 10^72. Each of those then yields 9
+// digits per single-limb division by 10^9 of its limbs.
+string toDecimalString(const BigNum &x)
 {
-    if (m.isZero())
-        return BigNum(0);
-    if (this->cmp(m) < 0)
-        return *this;
-
-    BigNum dividend = *this;
-    BigNum divisor = m;
-    BigNum current(0);
+    const size_t LEAF = 3;
+    if (x.isZero())
+        return "0";
 
-    for (int i = dividend.digits.size() - 1; i >= 0; i--)
+    size_t top = 0;
+    while (decimalPower(top).cmp(x) <= 0)
+        top++;
+    vector<BigNum> pieces = {x}, next;
+    for (size_t k = top; k-- > LEAF;)
     {
-        current = current * BigNum(256);
-        current = current + BigNum(dividend.digits[i]);
-        int x = 0, left = 0, right = 255;
-        while (left <= right)
+        const BigNum &d = decimalPower(k);
+        next.clear();
+        for (const BigNum &piece : pieces)
         {
-            int mid = (left + right) / 2;
-            BigNum t = divisor * BigNum(mid);
-            if (t.cmp(current) <= 0)
-            {
-                x = mid;
-                left = mid + 1;
-            }
-            else
-                right = mid - 1;
+            next.emplace_back();
+            next.emplace_back();
+            piece.divideInto(next[next.size() - 2], next.back(), d);
         }
-        current = current - divisor * BigNum(x);
+        swap(pieces, next);
     }
-    return current;
-}
-
-BigNum BigNum::operator/(const BigNum &b) const
-{
-    if (b.isZero())
-        throw runtime_error("Division by zero");
-    if (this->cmp(b) < 0)
-        return BigNum(0);
-
-    BigNum dividend = *this;
-    BigNum divisor = b;
-    BigNum quotient;
-    quotient.digits.assign(dividend.digits.size(), 0);
 
-    BigNum current;
-    for (int i = dividend.digits.size() - 1; i >= 0; i--)
+    size_t chunks = size_t(1) << min(top, LEAF), width = 9 * chunks;
+    string s(pieces.size() * width, '0');
+    vector<limb_t> limbs;
+    for (size_t i = 0; i < pieces.size(); i++)
     {
-        current = current * BigNum(256) + BigNum(dividend.digits[i]);
-
-        int left = 0, right = 255, x = 0;
-        while (left <= right)
+        size_t n = pieces[i].limbCount();
+        limbs.resize(n);
+        pieces[i].toLimbs(limbs.data(), n);
+        char *end = &s[0] + (i + 1) * width;
+        for (size_t c = 0; c < chunks && n > 0; c++)
         {
-            int mid = (left + right) / 2;
-            BigNum t = divisor * BigNum(mid);
-            if (t.cmp(current) <= 0)
+            uint64_t rem = 0;
+            for (size_t j = n; j-- > 0;)
             {
-                x = mid;
-                left = mid + 1;
+                uint64_t cur = rem << 32 | limbs[j];
+                limbs[j] = (limb_t)(cur / 1000000000);
+                rem = cur % 1000000000;
             }
-            else
-                right = mid - 1;
+            while (n > 0 && limbs[n - 1] == 0)
+                n--;
+            for (int d = 0; d < 9; d++, rem /= 10)
+                *--end = char('0' + rem % 10);
         }
-
-        quotient.digits[i] = x;
-        current = current - divisor * BigNum(x);
-    }
-    while (quotient.digits.size() > 1 && quotient.digits.back() == 0)
-        quotient.digits.pop_back();
-    return quotient;
-}
-
-BigNum BigNum::modPow(const BigNum &base, const BigNum &exp, const BigNum &mod)
-{
-    BigNum result(1);
-    BigNum b = base % mod;
-    BigNum e = exp;
-    
-    while (!e.isZero())
-    {
-        if (e.isOdd())
-            result = (result * b) % mod;
-        e = e.div2();
-        b = (b * b) % mod;
-    }
-    return result;
-}
-
-string toDecimalString(BigNum x)
-{
-    if (x.isZero())
-        return "0";
-    BigNum ten(10);
-    string s;
-    while (!x.isZero())
-    {
-        BigNum rem = x % ten;
-        const auto &rd = rem.getDigits();
-        int d = (rd.empty() ? 0 : rd[0]);
-        s.push_back(char('0' + d));
-        x = x / ten;
     }
-    reverse(s.begin(), s.end());
-    return s;
+    return s.substr(s.find_first_not_of('0'));
 }
 
 // ========================== CLASS PrimitiveRootChecker ==========================
@@ -310,6 +87,7 @@ private:
     BigNum pMinus1;
     vector<BigNum> U;
     bool result;
+    bool binary = false; // record file in, record file out
 
 public:
     bool readInput(const string &filename);
@@ -326,29 +104,34 @@ public:
 // ========================== PrimitiveRootChecker Implementation ==========================
 
 bool PrimitiveRootChecker::readInput(const string &filename) {
-    ifstream fin(filename);
-    if (!fin) return false;
-
-    string pStr, nStr;
-    getline(fin, pStr);
-    getline(fin, nStr);
-
-    p = BigNum(pStr);
+    InputReader in;
+    if (!in.open(filename)) return false;
+
+    if (RecordReader::isRecordFile(in.contents())) {
+        RecordReader records(in.contents());
+        records.expect(LAYOUT_PRIMITIVE_ROOT, 1);
+        binary = true;
+        p = records.next();
+        pMinus1 = p - BigNum(1);
+        for (uint64_t k = records.nextCount(); k > 0; k--)
+            U.push_back(records.next());
+        g = records.next();
+        return true;
+    }
+
+    string_view line, t;
+    in.nextLine(line);
+    p = BigNum(line);
     BigNum one(1);
     pMinus1 = p - one;
 
-    string line;
-    getline(fin, line);
-    stringstream ss(line);
-    string t;
-    while (ss >> t)
+    in.nextLine(line); // count of factors; the next line holds them all
+    in.nextLine(line);
+    while (splitToken(line, t))
         U.push_back(BigNum(t));
 
-    string gStr;
-    getline(fin, gStr);
-    g = BigNum(gStr);
-    
-    fin.close();
+    in.nextLine(line);
+    g = BigNum(line);
     return true;
 }
 
@@ -364,9 +147,26 @@ void PrimitiveRootChecker::check() {
     cout << "\n\n";
 
     result = true;
+
+    // 2 in U: a quadratic residue is rejected and a non-residue passes this
+    // factor without exponentiating
+    BigNum two(2);
+    int j = Operations::quadraticCharacter(p, U, g);
+    if (j != 0) {
+        cout << "k       = 2\n";
+        cout << "Jacobi(g, p) = " << j << "\n\n";
+        if (j == 1) {
+            result = false;
+            return;
+        }
+    }
+
+    GroupContext group(p, g);
     for (auto &k : U) {
+        if (j != 0 && k.cmp(two) == 0)
+            continue;
         BigNum exp = pMinus1 / k;
-        BigNum res = BigNum::modPow(g, exp, p);
+        BigNum res = group.powG(exp);
 
         cout << "k       = " << k.toReversedHex() << "\n";
         cout << "(p-1)/k = " << exp.toReversedHex() << "\n";
@@ -380,11 +180,14 @@ void PrimitiveRootChecker::check() {
 }
 
 void PrimitiveRootChecker::writeOutput(const string &filename) {
-    ofstream fout(filename);
-    if (!fout) return;
-    
-    fout << (result ? 1 : 0) << "\n";
-    fout.close();
+    OutputWriter out;
+    if (!out.open(filename)) return;
+
+    if (binary)
+        RecordWriter(out, LAYOUT_VERDICT, 1).write(BigNum(result ? 1 : 0));
+    else
+        out.write(result ? "1\n" : "0\n");
+    out.close();
     
     cout << "Result written to output file: " << (result ? 1 : 0) << "\n";
 }
@@ -398,23 +201,52 @@ int main(int argc, char *argv[])
 
     if (argc < 3)
     {
-        cerr << "Usage: " << argv[0] << " inputFile outputFile\n";
+        cerr << "Usage: " << argv[0] << " inputFile outputFile [--stats]\n";
         return 1;
     }
 
+    bool stats = false;  // --stats: counters and phase times as JSON on stderr
+    for (int i = 3; i < argc; i++)
+    {
+        if (string(argv[i]) != "--stats")
+        {
+            cerr << "Unknown option: " << argv[i] << "\n";
+            return 1;
+        }
+        stats = true;
+    }
+
     PrimitiveRootChecker checker;
     
-    if (!checker.readInput(argv[1]))
+    try
+    {
+        STATS_PHASE(PARSE);
+        if (!checker.readInput(argv[1]))
+        {
+            cerr << "Cannot open input file\n";
+            return 1;
+        }
+    }
+    catch (const invalid_argument &e)
     {
-        cerr << "Cannot open input file\n";
+        cerr << e.what() << "\n";
         return 1;
     }
     
     // Check if g is a primitive root of p
-    checker.check();
+    {
+        STATS_PHASE(EXPONENTIATE);
+        checker.check();
+    }
     
     // Write result to output file
-    checker.writeOutput(argv[2]);
+    {
+        STATS_PHASE(FORMAT);
+        checker.writeOutput(argv[2]);
+    }
+
+    if (stats)
+        cerr << statsJson("project1") << "\n";
 
     return 0;
 }
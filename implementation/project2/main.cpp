@@ -5,306 +5,380 @@
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#include <random>
+#include <array>
+#include <cstdint>
+#include <cerrno>
+#include <climits>
+#include "../common/record_format.h"
+#include "../common/operations.h"
+#include "../common/stats.h"
 using namespace std;
-class BigNum
-{
-private:
-    vector<int> digits;
-
-public:
-    BigNum();
-    BigNum(long long val);
-    BigNum(string hexStr);
-
-    void fromReversedHex(string hexStr);
-    string toReversedHex() const;
-    int cmp(const BigNum &b) const;
-    bool isZero() const;
-    bool isOdd() const;
-    BigNum div2() const;
-
-    BigNum operator+(const BigNum &b) const;
-    BigNum operator-(const BigNum &b) const;
-    BigNum operator*(const BigNum &b) const;
-    BigNum operator%(const BigNum &b) const;
-    BigNum operator/(const BigNum &b) const;
-    static BigNum modPow(const BigNum &base, const BigNum &exp, const BigNum &mod);
-    const vector<int> &getDigits() const { return digits; }
-};
-
-BigNum::BigNum() { digits = {0}; }
-
-BigNum::BigNum(long long val)
-{
-    digits.clear();
-    if (val == 0)
-    {
-        digits.push_back(0);
-        return;
-    }
-    while (val > 0)
-    {
-        digits.push_back(val % 256);
-        val /= 256;
-    }
-}
-
-BigNum::BigNum(string hexStr) { fromReversedHex(hexStr); }
-
-void BigNum::fromReversedHex(string hexStr)
-{
-    string s;
-    for (char c : hexStr)
-        if (!isspace((unsigned char)c))
-            s += c;
-    reverse(s.begin(), s.end());
-    if (s.empty())
-    {
-        digits = {0};
-        return;
-    }
-    if (s.size() % 2 != 0)
-        s = "0" + s;
-    digits.clear();
-    for (int i = s.size() - 2; i >= 0; i -= 2)
-    {
-        char hi_c = s[i];
-        char lo_c = s[i + 1];
-        int hi = isdigit(static_cast<unsigned char>(hi_c)) ? (hi_c - '0')
-                                                           : (toupper(static_cast<unsigned char>(hi_c)) - 'A' + 10);
-        int lo = isdigit(static_cast<unsigned char>(lo_c)) ? (lo_c - '0')
-                                                           : (toupper(static_cast<unsigned char>(lo_c)) - 'A' + 10);
-        digits.push_back(((hi << 4) | lo) & 0xFF);
-    }
-    while (digits.size() > 1 && digits.back() == 0)
-        digits.pop_back();
-}
 
-string BigNum::toReversedHex() const
-{
-    static const char HEX[] = "0123456789ABCDEF";
-    if (digits.empty())
-        return "00";
-
-    string out;
-    for (int i = static_cast<int>(digits.size()) - 1; i >= 0; --i)
-    {
-        int b = digits[i];
-        out += HEX[(b >> 4) & 0xF];
-        out += HEX[b & 0xF];
-    }
-    if (out.empty())
-        return "00";
-    size_t pos = out.find_first_not_of('0');
-    if (pos == string::npos)
-        return "00";
-    return out.substr(pos);
-}
-
-int BigNum::cmp(const BigNum &b) const
-{
-    if (digits.size() != b.digits.size())
-        return digits.size() < b.digits.size() ? -1 : 1;
-    for (int i = digits.size() - 1; i >= 0; i--)
-        if (digits[i] != b.digits[i])
-            return digits[i] < b.digits[i] ? -1 : 1;
-    return 0;
-}
-
-bool BigNum::isZero() const { return digits.size() == 1 && digits[0] == 0; }
-bool BigNum::isOdd() const { return digits[0] & 1; }
-
-BigNum BigNum::div2() const
+string reverseHex(const string &s)
 {
-    BigNum r = *this;
-    int carry = 0;
-    for (int i = r.digits.size() - 1; i >= 0; i--)
-    {
-        int cur = r.digits[i] + carry * 256;
-        r.digits[i] = cur / 2;
-        carry = cur % 2;
-    }
-    while (r.digits.size() > 1 && r.digits.back() == 0)
-        r.digits.pop_back();
-    return r;
+    string t = s;
+    reverse(t.begin(), t.end());
+    return t;
 }
 
-BigNum BigNum::operator+(const BigNum &b) const
+// A positive decimal option value spanning the whole argument; 0 otherwise
+int positiveOption(const char *text)
 {
-    BigNum r;
-    r.digits.assign(max(digits.size(), b.digits.size()) + 1, 0);
-    int carry = 0;
-    for (size_t i = 0; i < r.digits.size(); i++)
-    {
-        int sum = carry;
-        if (i < digits.size())
-            sum += digits[i];
-        if (i < b.digits.size())
-            sum += b.digits[i];
-        r.digits[i] = sum % 256;
-        carry = sum / 256;
-    }
-    while (r.digits.size() > 1 && r.digits.back() == 0)
-        r.digits.pop_back();
-    return r;
+    char *end;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || value <= 0 || value > INT_MAX)
+        return 0;
+    return (int)value;
 }
 
-BigNum BigNum::operator-(const BigNum &b) const
+// Uniform random value with exactly `bits` bits (top bit set)
+BigNum randomBits(int bits)
 {
-    BigNum r;
-    r.digits.assign(digits.size(), 0);
-    int borrow = 0;
-    for (size_t i = 0; i < digits.size(); i++)
+    static random_device rd;
+    int nbytes = (bits + 7) / 8;
+    string hex;
+    for (int i = 0; i < nbytes; i++)
     {
-        int diff = digits[i] - (i < b.digits.size() ? b.digits[i] : 0) - borrow;
-        if (diff < 0)
+        int byte = rd() & 0xFF;
+        if (i == nbytes - 1)
         {
-            diff += 256;
-            borrow = 1;
+            int topBits = bits - 8 * i;
+            byte &= (1 << topBits) - 1;
+            byte |= 1 << (topBits - 1);
         }
-        else
-            borrow = 0;
-        r.digits[i] = diff;
+        static const char HEX[] = "0123456789ABCDEF";
+        hex += HEX[byte & 0xF];
+        hex += HEX[(byte >> 4) & 0xF];
     }
-    while (r.digits.size() > 1 && r.digits.back() == 0)
-        r.digits.pop_back();
-    return r;
+    return BigNum(hex);
 }
 
-BigNum BigNum::operator*(const BigNum &b) const
+// ========================== Named groups (RFC 3526 / RFC 7919) ==========================
+
+// Safe primes p = 2q + 1 with generator g = 2, written as in the RFCs (big-endian hex).
+constexpr char MODP1536_HEX[] =
+    "FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74"
+    "020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F1437"
+    "4FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+    "EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF05"
+    "98DA48361C55D39A69163FA8FD24CF5F83655D23DCA3AD961C62F356208552BB"
+    "9ED529077096966D670C354E4ABC9804F1746C08CA237327FFFFFFFFFFFFFFFF";
+
+constexpr char MODP2048_HEX[] =
+    "FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74"
+    "020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F1437"
+    "4FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+    "EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF05"
+    "98DA48361C55D39A69163FA8FD24CF5F83655D23DCA3AD961C62F356208552BB"
+    "9ED529077096966D670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+    "E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9DE2BCBF695581718"
+    "3995497CEA956AE515D2261898FA051015728E5A8AACAA68FFFFFFFFFFFFFFFF";
+
+constexpr char MODP3072_HEX[] =
+    "FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74"
+    "020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F1437"
+    "4FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+    "EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF05"
+    "98DA48361C55D39A69163FA8FD24CF5F83655D23DCA3AD961C62F356208552BB"
+    "9ED529077096966D670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+    "E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9DE2BCBF695581718"
+    "3995497CEA956AE515D2261898FA051015728E5A8AAAC42DAD33170D04507A33"
+    "A85521ABDF1CBA64ECFB850458DBEF0A8AEA71575D060C7DB3970F85A6E1E4C7"
+    "ABF5AE8CDB0933D71E8C94E04A25619DCEE3D2261AD2EE6BF12FFA06D98A0864"
+    "D87602733EC86A64521F2B18177B200CBBE117577A615D6C770988C0BAD946E2"
+    "08E24FA074E5AB3143DB5BFCE0FD108E4B82D120A93AD2CAFFFFFFFFFFFFFFFF";
+
+constexpr char MODP4096_HEX[] =
+    "FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74"
+    "020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F1437"
+    "4FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+    "EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF05"
+    "98DA48361C55D39A69163FA8FD24CF5F83655D23DCA3AD961C62F356208552BB"
+    "9ED529077096966D670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+    "E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9DE2BCBF695581718"
+    "3995497CEA956AE515D2261898FA051015728E5A8AAAC42DAD33170D04507A33"
+    "A85521ABDF1CBA64ECFB850458DBEF0A8AEA71575D060C7DB3970F85A6E1E4C7"
+    "ABF5AE8CDB0933D71E8C94E04A25619DCEE3D2261AD2EE6BF12FFA06D98A0864"
+    "D87602733EC86A64521F2B18177B200CBBE117577A615D6C770988C0BAD946E2"
+    "08E24FA074E5AB3143DB5BFCE0FD108E4B82D120A92108011A723C12A787E6D7"
+    "88719A10BDBA5B2699C327186AF4E23C1A946834B6150BDA2583E9CA2AD44CE8"
+    "DBBBC2DB04DE8EF92E8EFC141FBECAA6287C59474E6BC05D99B2964FA090C3A2"
+    "233BA186515BE7ED1F612970CEE2D7AFB81BDD762170481CD0069127D5B05AA9"
+    "93B4EA988D8FDDC186FFB7DC90A6C08F4DF435C934063199FFFFFFFFFFFFFFFF";
+
+constexpr char MODP6144_HEX[] =
+    "FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74"
+    "020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F1437"
+    "4FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+    "EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF05"
+    "98DA48361C55D39A69163FA8FD24CF5F83655D23DCA3AD961C62F356208552BB"
+    "9ED529077096966D670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+    "E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9DE2BCBF695581718"
+    "3995497CEA956AE515D2261898FA051015728E5A8AAAC42DAD33170D04507A33"
+    "A85521ABDF1CBA64ECFB850458DBEF0A8AEA71575D060C7DB3970F85A6E1E4C7"
+    "ABF5AE8CDB0933D71E8C94E04A25619DCEE3D2261AD2EE6BF12FFA06D98A0864"
+    "D87602733EC86A64521F2B18177B200CBBE117577A615D6C770988C0BAD946E2"
+    "08E24FA074E5AB3143DB5BFCE0FD108E4B82D120A92108011A723C12A787E6D7"
+    "88719A10BDBA5B2699C327186AF4E23C1A946834B6150BDA2583E9CA2AD44CE8"
+    "DBBBC2DB04DE8EF92E8EFC141FBECAA6287C59474E6BC05D99B2964FA090C3A2"
+    "233BA186515BE7ED1F612970CEE2D7AFB81BDD762170481CD0069127D5B05AA9"
+    "93B4EA988D8FDDC186FFB7DC90A6C08F4DF435C93402849236C3FAB4D27C7026"
+    "C1D4DCB2602646DEC9751E763DBA37BDF8FF9406AD9E530EE5DB382F413001AE"
+    "B06A53ED9027D831179727B0865A8918DA3EDBEBCF9B14ED44CE6CBACED4BB1B"
+    "DB7F1447E6CC254B332051512BD7AF426FB8F401378CD2BF5983CA01C64B92EC"
+    "F032EA15D1721D03F482D7CE6E74FEF6D55E702F46980C82B5A84031900B1C9E"
+    "59E7C97FBEC7E8F323A97A7E36CC88BE0F1D45B7FF585AC54BD407B22B4154AA"
+    "CC8F6D7EBF48E1D814CC5ED20F8037E0A79715EEF29BE32806A1D58BB7C5DA76"
+    "F550AA3D8A1FBFF0EB19CCB1A313D55CDA56C9EC2EF29632387FE8D76E3C0468"
+    "043E8F663F4860EE12BF2D5B0B7474D6E694F91E6DCC4024FFFFFFFFFFFFFFFF";
+
+constexpr char MODP8192_HEX[] =
+    "FFFFFFFFFFFFFFFFC90FDAA22168C234C4C6628B80DC1CD129024E088A67CC74"
+    "020BBEA63B139B22514A08798E3404DDEF9519B3CD3A431B302B0A6DF25F1437"
+    "4FE1356D6D51C245E485B576625E7EC6F44C42E9A637ED6B0BFF5CB6F406B7ED"
+    "EE386BFB5A899FA5AE9F24117C4B1FE649286651ECE45B3DC2007CB8A163BF05"
+    "98DA48361C55D39A69163FA8FD24CF5F83655D23DCA3AD961C62F356208552BB"
+    "9ED529077096966D670C354E4ABC9804F1746C08CA18217C32905E462E36CE3B"
+    "E39E772C180E86039B2783A2EC07A28FB5C55DF06F4C52C9DE2BCBF695581718"
+    "3995497CEA956AE515D2261898FA051015728E5A8AAAC42DAD33170D04507A33"
+    "A85521ABDF1CBA64ECFB850458DBEF0A8AEA71575D060C7DB3970F85A6E1E4C7"
+    "ABF5AE8CDB0933D71E8C94E04A25619DCEE3D2261AD2EE6BF12FFA06D98A0864"
+    "D87602733EC86A64521F2B18177B200CBBE117577A615D6C770988C0BAD946E2"
+    "08E24FA074E5AB3143DB5BFCE0FD108E4B82D120A92108011A723C12A787E6D7"
+    "88719A10BDBA5B2699C327186AF4E23C1A946834B6150BDA2583E9CA2AD44CE8"
+    "DBBBC2DB04DE8EF92E8EFC141FBECAA6287C59474E6BC05D99B2964FA090C3A2"
+    "233BA186515BE7ED1F612970CEE2D7AFB81BDD762170481CD0069127D5B05AA9"
+    "93B4EA988D8FDDC186FFB7DC90A6C08F4DF435C93402849236C3FAB4D27C7026"
+    "C1D4DCB2602646DEC9751E763DBA37BDF8FF9406AD9E530EE5DB382F413001AE"
+    "B06A53ED9027D831179727B0865A8918DA3EDBEBCF9B14ED44CE6CBACED4BB1B"
+    "DB7F1447E6CC254B332051512BD7AF426FB8F401378CD2BF5983CA01C64B92EC"
+    "F032EA15D1721D03F482D7CE6E74FEF6D55E702F46980C82B5A84031900B1C9E"
+    "59E7C97FBEC7E8F323A97A7E36CC88BE0F1D45B7FF585AC54BD407B22B4154AA"
+    "CC8F6D7EBF48E1D814CC5ED20F8037E0A79715EEF29BE32806A1D58BB7C5DA76"
+    "F550AA3D8A1FBFF0EB19CCB1A313D55CDA56C9EC2EF29632387FE8D76E3C0468"
+    "043E8F663F4860EE12BF2D5B0B7474D6E694F91E6DBE115974A3926F12FEE5E4"
+    "38777CB6A932DF8CD8BEC4D073B931BA3BC832B68D9DD300741FA7BF8AFC47ED"
+    "2576F6936BA424663AAB639C5AE4F5683423B4742BF1C978238F16CBE39D652D"
+    "E3FDB8BEFC848AD922222E04A4037C0713EB57A81A23F0C73473FC646CEA306B"
+    "4BCBC8862F8385DDFA9D4B7FA2C087E879683303ED5BDD3A062B3CF5B3A278A6"
+    "6D2A13F83F44F82DDF310EE074AB6A364597E899A0255DC164F31CC50846851D"
+    "F9AB48195DED7EA1B1D510BD7EE74D73FAF36BC31ECFA268359046F4EB879F92"
+    "4009438B481C6CD7889A002ED5EE382BC9190DA6FC026E479558E4475677E9AA"
+    "9E3050E2765694DFC81F56E880B96E7160C980DD98EDD3DFFFFFFFFFFFFFFFFF";
+
+constexpr char FFDHE2048_HEX[] =
+    "FFFFFFFFFFFFFFFFADF85458A2BB4A9AAFDC5620273D3CF1D8B9C583CE2D3695"
+    "A9E13641146433FBCC939DCE249B3EF97D2FE363630C75D8F681B202AEC4617A"
+    "D3DF1ED5D5FD65612433F51F5F066ED0856365553DED1AF3B557135E7F57C935"
+    "984F0C70E0E68B77E2A689DAF3EFE8721DF158A136ADE73530ACCA4F483A797A"
+    "BC0AB182B324FB61D108A94BB2C8E3FBB96ADAB760D7F4681D4F42A3DE394DF4"
+    "AE56EDE76372BB190B07A7C8EE0A6D709E02FCE1CDF7E2ECC03404CD28342F61"
+    "9172FE9CE98583FF8E4F1232EEF28183C3FE3B1B4C6FAD733BB5FCBC2EC22005"
+    "C58EF1837D1683B2C6F34A26C1B2EFFA886B423861285C97FFFFFFFFFFFFFFFF";
+
+constexpr char FFDHE3072_HEX[] =
+    "FFFFFFFFFFFFFFFFADF85458A2BB4A9AAFDC5620273D3CF1D8B9C583CE2D3695"
+    "A9E13641146433FBCC939DCE249B3EF97D2FE363630C75D8F681B202AEC4617A"
+    "D3DF1ED5D5FD65612433F51F5F066ED0856365553DED1AF3B557135E7F57C935"
+    "984F0C70E0E68B77E2A689DAF3EFE8721DF158A136ADE73530ACCA4F483A797A"
+    "BC0AB182B324FB61D108A94BB2C8E3FBB96ADAB760D7F4681D4F42A3DE394DF4"
+    "AE56EDE76372BB190B07A7C8EE0A6D709E02FCE1CDF7E2ECC03404CD28342F61"
+    "9172FE9CE98583FF8E4F1232EEF28183C3FE3B1B4C6FAD733BB5FCBC2EC22005"
+    "C58EF1837D1683B2C6F34A26C1B2EFFA886B4238611FCFDCDE355B3B6519035B"
+    "BC34F4DEF99C023861B46FC9D6E6C9077AD91D2691F7F7EE598CB0FAC186D91C"
+    "AEFE130985139270B4130C93BC437944F4FD4452E2D74DD364F2E21E71F54BFF"
+    "5CAE82AB9C9DF69EE86D2BC522363A0DABC521979B0DEADA1DBF9A42D5C4484E"
+    "0ABCD06BFA53DDEF3C1B20EE3FD59D7C25E41D2B66C62E37FFFFFFFFFFFFFFFF";
+
+constexpr char FFDHE4096_HEX[] =
+    "FFFFFFFFFFFFFFFFADF85458A2BB4A9AAFDC5620273D3CF1D8B9C583CE2D3695"
+    "A9E13641146433FBCC939DCE249B3EF97D2FE363630C75D8F681B202AEC4617A"
+    "D3DF1ED5D5FD65612433F51F5F066ED0856365553DED1AF3B557135E7F57C935"
+    "984F0C70E0E68B77E2A689DAF3EFE8721DF158A136ADE73530ACCA4F483A797A"
+    "BC0AB182B324FB61D108A94BB2C8E3FBB96ADAB760D7F4681D4F42A3DE394DF4"
+    "AE56EDE76372BB190B07A7C8EE0A6D709E02FCE1CDF7E2ECC03404CD28342F61"
+    "9172FE9CE98583FF8E4F1232EEF28183C3FE3B1B4C6FAD733BB5FCBC2EC22005"
+    "C58EF1837D1683B2C6F34A26C1B2EFFA886B4238611FCFDCDE355B3B6519035B"
+    "BC34F4DEF99C023861B46FC9D6E6C9077AD91D2691F7F7EE598CB0FAC186D91C"
+    "AEFE130985139270B4130C93BC437944F4FD4452E2D74DD364F2E21E71F54BFF"
+    "5CAE82AB9C9DF69EE86D2BC522363A0DABC521979B0DEADA1DBF9A42D5C4484E"
+    "0ABCD06BFA53DDEF3C1B20EE3FD59D7C25E41D2B669E1EF16E6F52C3164DF4FB"
+    "7930E9E4E58857B6AC7D5F42D69F6D187763CF1D5503400487F55BA57E31CC7A"
+    "7135C886EFB4318AED6A1E012D9E6832A907600A918130C46DC778F971AD0038"
+    "092999A333CB8B7A1A1DB93D7140003C2A4ECEA9F98D0ACC0A8291CDCEC97DCF"
+    "8EC9B55A7F88A46B4DB5A851F44182E1C68A007E5E655F6AFFFFFFFFFFFFFFFF";
+
+constexpr char FFDHE6144_HEX[] =
+    "FFFFFFFFFFFFFFFFADF85458A2BB4A9AAFDC5620273D3CF1D8B9C583CE2D3695"
+    "A9E13641146433FBCC939DCE249B3EF97D2FE363630C75D8F681B202AEC4617A"
+    "D3DF1ED5D5FD65612433F51F5F066ED0856365553DED1AF3B557135E7F57C935"
+    "984F0C70E0E68B77E2A689DAF3EFE8721DF158A136ADE73530ACCA4F483A797A"
+    "BC0AB182B324FB61D108A94BB2C8E3FBB96ADAB760D7F4681D4F42A3DE394DF4"
+    "AE56EDE76372BB190B07A7C8EE0A6D709E02FCE1CDF7E2ECC03404CD28342F61"
+    "9172FE9CE98583FF8E4F1232EEF28183C3FE3B1B4C6FAD733BB5FCBC2EC22005"
+    "C58EF1837D1683B2C6F34A26C1B2EFFA886B4238611FCFDCDE355B3B6519035B"
+    "BC34F4DEF99C023861B46FC9D6E6C9077AD91D2691F7F7EE598CB0FAC186D91C"
+    "AEFE130985139270B4130C93BC437944F4FD4452E2D74DD364F2E21E71F54BFF"
+    "5CAE82AB9C9DF69EE86D2BC522363A0DABC521979B0DEADA1DBF9A42D5C4484E"
+    "0ABCD06BFA53DDEF3C1B20EE3FD59D7C25E41D2B669E1EF16E6F52C3164DF4FB"
+    "7930E9E4E58857B6AC7D5F42D69F6D187763CF1D5503400487F55BA57E31CC7A"
+    "7135C886EFB4318AED6A1E012D9E6832A907600A918130C46DC778F971AD0038"
+    "092999A333CB8B7A1A1DB93D7140003C2A4ECEA9F98D0ACC0A8291CDCEC97DCF"
+    "8EC9B55A7F88A46B4DB5A851F44182E1C68A007E5E0DD9020BFD64B645036C7A"
+    "4E677D2C38532A3A23BA4442CAF53EA63BB454329B7624C8917BDD64B1C0FD4C"
+    "B38E8C334C701C3ACDAD0657FCCFEC719B1F5C3E4E46041F388147FB4CFDB477"
+    "A52471F7A9A96910B855322EDB6340D8A00EF092350511E30ABEC1FFF9E3A26E"
+    "7FB29F8C183023C3587E38DA0077D9B4763E4E4B94B2BBC194C6651E77CAF992"
+    "EEAAC0232A281BF6B3A739C1226116820AE8DB5847A67CBEF9C9091B462D538C"
+    "D72B03746AE77F5E62292C311562A846505DC82DB854338AE49F5235C95B9117"
+    "8CCF2DD5CACEF403EC9D1810C6272B045B3B71F9DC6B80D63FDD4A8E9ADB1E69"
+    "62A69526D43161C1A41D570D7938DAD4A40E329CD0E40E65FFFFFFFFFFFFFFFF";
+
+constexpr char FFDHE8192_HEX[] =
+    "FFFFFFFFFFFFFFFFADF85458A2BB4A9AAFDC5620273D3CF1D8B9C583CE2D3695"
+    "A9E13641146433FBCC939DCE249B3EF97D2FE363630C75D8F681B202AEC4617A"
+    "D3DF1ED5D5FD65612433F51F5F066ED0856365553DED1AF3B557135E7F57C935"
+    "984F0C70E0E68B77E2A689DAF3EFE8721DF158A136ADE73530ACCA4F483A797A"
+    "BC0AB182B324FB61D108A94BB2C8E3FBB96ADAB760D7F4681D4F42A3DE394DF4"
+    "AE56EDE76372BB190B07A7C8EE0A6D709E02FCE1CDF7E2ECC03404CD28342F61"
+    "9172FE9CE98583FF8E4F1232EEF28183C3FE3B1B4C6FAD733BB5FCBC2EC22005"
+    "C58EF1837D1683B2C6F34A26C1B2EFFA886B4238611FCFDCDE355B3B6519035B"
+    "BC34F4DEF99C023861B46FC9D6E6C9077AD91D2691F7F7EE598CB0FAC186D91C"
+    "AEFE130985139270B4130C93BC437944F4FD4452E2D74DD364F2E21E71F54BFF"
+    "5CAE82AB9C9DF69EE86D2BC522363A0DABC521979B0DEADA1DBF9A42D5C4484E"
+    "0ABCD06BFA53DDEF3C1B20EE3FD59D7C25E41D2B669E1EF16E6F52C3164DF4FB"
+    "7930E9E4E58857B6AC7D5F42D69F6D187763CF1D5503400487F55BA57E31CC7A"
+    "7135C886EFB4318AED6A1E012D9E6832A907600A918130C46DC778F971AD0038"
+    "092999A333CB8B7A1A1DB93D7140003C2A4ECEA9F98D0ACC0A8291CDCEC97DCF"
+    "8EC9B55A7F88A46B4DB5A851F44182E1C68A007E5E0DD9020BFD64B645036C7A"
+    "4E677D2C38532A3A23BA4442CAF53EA63BB454329B7624C8917BDD64B1C0FD4C"
+    "B38E8C334C701C3ACDAD0657FCCFEC719B1F5C3E4E46041F388147FB4CFDB477"
+    "A52471F7A9A96910B855322EDB6340D8A00EF092350511E30ABEC1FFF9E3A26E"
+    "7FB29F8C183023C3587E38DA0077D9B4763E4E4B94B2BBC194C6651E77CAF992"
+    "EEAAC0232A281BF6B3A739C1226116820AE8DB5847A67CBEF9C9091B462D538C"
+    "D72B03746AE77F5E62292C311562A846505DC82DB854338AE49F5235C95B9117"
+    "8CCF2DD5CACEF403EC9D1810C6272B045B3B71F9DC6B80D63FDD4A8E9ADB1E69"
+    "62A69526D43161C1A41D570D7938DAD4A40E329CCFF46AAA36AD004CF600C838"
+    "1E425A31D951AE64FDB23FCEC9509D43687FEB69EDD1CC5E0B8CC3BDF64B10EF"
+    "86B63142A3AB8829555B2F747C932665CB2C0F1CC01BD70229388839D2AF05E4"
+    "54504AC78B7582822846C0BA35C35F5C59160CC046FD8251541FC68C9C86B022"
+    "BB7099876A460E7451A8A93109703FEE1C217E6C3826E52C51AA691E0E423CFC"
+    "99E9E31650C1217B624816CDAD9A95F9D5B8019488D9C0A0A1FE3075A577E231"
+    "83F81D4A3F2FA4571EFC8CE0BA8A4FE8B6855DFE72B0A66EDED2FBABFBE58A30"
+    "FAFABE1C5D71A87E2F741EF8C1FE86FEA6BBFDE530677F0D97D11D49F7A8443D"
+    "0822E506A9F4614E011E2A94838FF88CD68C8BB7C5C6424CFFFFFFFFFFFFFFFF";
+
+// p and q = (p - 1) / 2 as little-endian bytes, decoded at compile time.
+// Only these are embedded: MontContext derives n0inv and R^2 from p at
+// startup at a tiny fraction of one exponentiation, and the comb table for
+// g = 2 (megabytes at 8192 bits) is built or loaded through the precomputed
+// table cache (precomp_cache.h) like any other group's.
+template <size_t Bits>
+struct GroupBytes
 {
-    BigNum r;
-    r.digits.assign(digits.size() + b.digits.size(), 0);
-    for (size_t i = 0; i < digits.size(); i++)
-    {
-        long long carry = 0;
-        for (size_t j = 0; j < b.digits.size() || carry; j++)
-        {
-            long long cur = r.digits[i + j] +
-                            (long long)digits[i] * (j < b.digits.size() ? b.digits[j] : 0) + carry;
-            r.digits[i + j] = cur % 256;
-            carry = cur / 256;
-        }
-    }
-    while (r.digits.size() > 1 && r.digits.back() == 0)
-        r.digits.pop_back();
-    return r;
-}
+    array<uint8_t, Bits / 8> p{};
+    array<uint8_t, Bits / 8> q{};
+};
 
-BigNum BigNum::operator%(const BigNum &m) const
+template <size_t Bits>
+constexpr GroupBytes<Bits> decodeGroup(const char (&hex)[Bits / 4 + 1])
 {
-    if (m.isZero())
-        return BigNum(0);
-    if (this->cmp(m) < 0)
-        return *this;
-
-    BigNum dividend = *this;
-    BigNum divisor = m;
-    BigNum current(0);
-
-    for (int i = dividend.digits.size() - 1; i >= 0; i--)
+    GroupBytes<Bits> g;
+    for (size_t i = 0; i < Bits / 8; i++)
     {
-        current = current * BigNum(256);
-        current = current + BigNum(dividend.digits[i]);
-        int x = 0, left = 0, right = 255;
-        while (left <= right)
-        {
-            int mid = (left + right) / 2;
-            BigNum t = divisor * BigNum(mid);
-            if (t.cmp(current) <= 0)
-            {
-                x = mid;
-                left = mid + 1;
-            }
-            else
-                right = mid - 1;
-        }
-        current = current - divisor * BigNum(x);
+        size_t pos = Bits / 4 - 2 * (i + 1);
+        g.p[i] = hexValue(hex[pos]) << 4 | hexValue(hex[pos + 1]);
     }
-    return current;
+    for (size_t i = 0; i < Bits / 8; i++)
+        g.q[i] = (g.p[i] >> 1) | (i + 1 < Bits / 8 ? (g.p[i + 1] & 1) << 7 : 0);
+    return g;
 }
 
-BigNum BigNum::operator/(const BigNum &b) const
+constexpr auto MODP1536 = decodeGroup<1536>(MODP1536_HEX);
+constexpr auto MODP2048 = decodeGroup<2048>(MODP2048_HEX);
+constexpr auto MODP3072 = decodeGroup<3072>(MODP3072_HEX);
+constexpr auto MODP4096 = decodeGroup<4096>(MODP4096_HEX);
+constexpr auto MODP6144 = decodeGroup<6144>(MODP6144_HEX);
+constexpr auto MODP8192 = decodeGroup<8192>(MODP8192_HEX);
+constexpr auto FFDHE2048 = decodeGroup<2048>(FFDHE2048_HEX);
+constexpr auto FFDHE3072 = decodeGroup<3072>(FFDHE3072_HEX);
+constexpr auto FFDHE4096 = decodeGroup<4096>(FFDHE4096_HEX);
+constexpr auto FFDHE6144 = decodeGroup<6144>(FFDHE6144_HEX);
+constexpr auto FFDHE8192 = decodeGroup<8192>(FFDHE8192_HEX);
+
+struct NamedGroup
 {
-    if (b.isZero())
-        throw runtime_error("Division by zero");
-    if (this->cmp(b) < 0)
-        return BigNum(0);
-
-    BigNum dividend = *this;
-    BigNum divisor = b;
-    BigNum quotient;
-    quotient.digits.assign(dividend.digits.size(), 0);
-
-    BigNum current;
-    for (int i = dividend.digits.size() - 1; i >= 0; i--)
-    {
-        current = current * BigNum(256) + BigNum(dividend.digits[i]);
-
-        int left = 0, right = 255, x = 0;
-        while (left <= right)
-        {
-            int mid = (left + right) / 2;
-            BigNum t = divisor * BigNum(mid);
-            if (t.cmp(current) <= 0)
-            {
-                x = mid;
-                left = mid + 1;
-            }
-            else
-                right = mid - 1;
-        }
+    const char *name;
+    const uint8_t *p;
+    const uint8_t *q;
+    size_t bytes;
+};
 
-        quotient.digits[i] = x;
-        current = current - divisor * BigNum(x);
-    }
-    while (quotient.digits.size() > 1 && quotient.digits.back() == 0)
-        quotient.digits.pop_back();
-    return quotient;
-}
+const NamedGroup NAMED_GROUPS[] = {
+    {"modp1536", MODP1536.p.data(), MODP1536.q.data(), 192},
+    {"modp2048", MODP2048.p.data(), MODP2048.q.data(), 256},
+    {"modp3072", MODP3072.p.data(), MODP3072.q.data(), 384},
+    {"modp4096", MODP4096.p.data(), MODP4096.q.data(), 512},
+    {"modp6144", MODP6144.p.data(), MODP6144.q.data(), 768},
+    {"modp8192", MODP8192.p.data(), MODP8192.q.data(), 1024},
+    {"ffdhe2048", FFDHE2048.p.data(), FFDHE2048.q.data(), 256},
+    {"ffdhe3072", FFDHE3072.p.data(), FFDHE3072.q.data(), 384},
+    {"ffdhe4096", FFDHE4096.p.data(), FFDHE4096.q.data(), 512},
+    {"ffdhe6144", FFDHE6144.p.data(), FFDHE6144.q.data(), 768},
+    {"ffdhe8192", FFDHE8192.p.data(), FFDHE8192.q.data(), 1024},
+};
 
-BigNum BigNum::modPow(const BigNum &base, const BigNum &exp, const BigNum &mod)
+const NamedGroup *findNamedGroup(string_view name)
 {
-    BigNum result(1);
-    BigNum b = base % mod;
-    BigNum e = exp;
-    
-    while (!e.isZero())
-    {
-        if (e.isOdd())
-            result = (result * b) % mod;
-        e = e.div2();
-        b = (b * b) % mod;
-    }
-    return result;
-}
-
-string reverseHex(const string &s)
-{
-    string t = s;
-    reverse(t.begin(), t.end());
-    return t;
+    for (const NamedGroup &grp : NAMED_GROUPS)
+        if (name == grp.name)
+            return &grp;
+    return nullptr;
 }
 
 // ========================== CLASS DiffieHellmanKeyExchange ==========================
 
+// One exchange of a batch run
+struct DhSession {
+    BigNum a, b;  // private keys
+    BigNum A, B;  // public keys
+    BigNum K;     // shared secret
+};
+
 class DiffieHellmanKeyExchange {
 private:
     BigNum p;  // Prime modulus
     BigNum g;  // Generator
+    BigNum q;  // Order of g (prime-order subgroup), 0 if the group does not carry one
     BigNum a;  // Alice's private key
     BigNum b;  // Bob's private key
     BigNum A;  // Alice's public key: A = g^a mod p
     BigNum B;  // Bob's public key: B = g^b mod p
     BigNum K;  // Shared secret key: K = A^b mod p = B^a mod p
+    vector<DhSession> sessions;  // --batch runs
+    bool binary = false;  // record file in, record file out
+    bool constantTime = false;  // --constant-time: private-key powers in fixed time
+    bool safePrime = false;  // p = 2q + 1 with p and q prime: Jacobi(Y, p) checks keys
+
+    BigNum generatePrivateKey(int bits) const;
+    bool isValidPublicKey(const BigNum &Y) const;
 
 public:
     bool readInput(const string &filename);
-    void computeKeys();
+    void useNamedGroup(const NamedGroup &grp);
+    bool useSafePrimeGroup();
+    void generateKeys(int bits);
+    void setConstantTime(bool on) { constantTime = on; }
+    bool computeKeys();
+    bool computeBatch(int count, int bits);
     void writeOutput(const string &filename);
+    void writeBatchOutput(const string &filename);
     
     BigNum getP() const { return p; }
     BigNum getG() const { return g; }
+    BigNum getQ() const { return q; }
     BigNum getA() const { return a; }
     BigNum getB() const { return b; }
     BigNum getPublicA() const { return A; }
@@ -314,54 +388,257 @@ public:
 
 // ========================== DiffieHellmanKeyExchange Implementation ==========================
 
+// Input: p, g, a, b and an optional 5th line q (order of g, e.g. from a DSA-style group),
+// or a named group ID followed by a, b, or one dh record (q = 0 when not given)
 bool DiffieHellmanKeyExchange::readInput(const string &filename) {
-    ifstream fin(filename);
-    if (!fin) return false;
+    InputReader in;
+    if (!in.open(filename)) return false;
+
+    if (RecordReader::isRecordFile(in.contents()))
+    {
+        RecordReader records(in.contents());
+        records.expect(LAYOUT_DH, 1);
+        binary = true;
+        for (BigNum *v : {&p, &g, &a, &b, &q})
+            records.next(*v);
+        return true;
+    }
 
-    string pStr, gStr, aStr, bStr;
-    getline(fin, pStr);
-    getline(fin, gStr);
-    getline(fin, aStr);
-    getline(fin, bStr);
+    string_view pStr, gStr, aStr, bStr, qStr;
+    in.nextLine(pStr);
+
+    string_view rest = pStr, name;
+    splitToken(rest, name);
+    if (const NamedGroup *grp = findNamedGroup(name))
+    {
+        in.nextLine(aStr);
+        in.nextLine(bStr);
+        useNamedGroup(*grp);
+        a = BigNum(aStr);
+        b = BigNum(bStr);
+        return true;
+    }
+
+    in.nextLine(gStr);
+    in.nextLine(aStr);
+    in.nextLine(bStr);
+    in.nextLine(qStr);
 
     p = BigNum(pStr);
     g = BigNum(gStr);
     a = BigNum(aStr);
     b = BigNum(bStr);
-    
-    fin.close();
+    q = BigNum(qStr);
     return true;
 }
 
-void DiffieHellmanKeyExchange::computeKeys() {
+// Built-in group: no parsing, q is embedded next to p. The RFC 3526 and
+// RFC 7919 moduli are safe primes.
+void DiffieHellmanKeyExchange::useNamedGroup(const NamedGroup &grp) {
+    p = BigNum::fromBytes(grp.p, grp.bytes);
+    q = BigNum::fromBytes(grp.q, grp.bytes);
+    g = BigNum(2);
+    safePrime = true;
+}
+
+// Safe prime p = 2q + 1: g generates the subgroup of order q = (p - 1) / 2.
+// p and q must pass Miller-Rabin first, since for a composite either one
+// Jacobi(Y, p) = 1 does not put Y in that subgroup; the proof is cached per
+// p, and lets the key checks take Jacobi.
+bool DiffieHellmanKeyExchange::useSafePrimeGroup() {
+    if (!p.isOdd() || p.cmp(BigNum(5)) < 0)
+        return false;
+    BigNum half = (p - BigNum(1)).div2();
+    if (!Operations::provenSafePrime(p, half))
+        return false;
+    q = half;
+    safePrime = true;
+    return true;
+}
+
+// Short exponent: `bits` random bits, or uniform in [1, q - 1] when q is not longer than that
+BigNum DiffieHellmanKeyExchange::generatePrivateKey(int bits) const {
+    if (!q.isZero() && bits >= q.bitLength())
+    {
+        while (true)
+        {
+            BigNum x = randomBits(q.bitLength());
+            if (!x.isZero() && x.cmp(q) < 0)
+                return x;
+        }
+    }
+    return randomBits(bits);
+}
+
+void DiffieHellmanKeyExchange::generateKeys(int bits) {
+    a = generatePrivateKey(bits);
+    b = generatePrivateKey(bits);
+}
+
+// Peer key must lie in the order-q subgroup (Operations::inSubgroup)
+bool DiffieHellmanKeyExchange::isValidPublicKey(const BigNum &Y) const {
+    return Operations::inSubgroup(Y, p, q, safePrime);
+}
+
+// Public keys, each side's check of the peer's key, and the shared key
+// K = A^b, as Operations::dh runs them. A named or --safe-prime group is
+// passed as proven, so the key checks take Jacobi rather than Y^q.
+bool DiffieHellmanKeyExchange::computeKeys() {
+    Operations ops;
+    ops.setConstantTime(constantTime);
+    try
+    {
+        ops.dh(p, g, a, b, q, A, B, K, safePrime);
+    }
+    catch (const invalid_argument &e)
+    {
+        cerr << e.what() << "\n";
+        return false;
+    }
+    // g has order q, so exponents only matter mod q
+    if (!q.isZero())
+    {
+        a = a % q;
+        b = b % q;
+    }
+
     cout << "Input values:\n";
     cout << "p = " << p.toReversedHex() << "\n";
     cout << "g = " << g.toReversedHex() << "\n";
+    if (!q.isZero())
+        cout << "q = " << q.toReversedHex() << "\n";
     cout << "a = " << a.toReversedHex() << "\n";
     cout << "b = " << b.toReversedHex() << "\n\n";
 
-    // Compute public keys
-    A = BigNum::modPow(g, a, p);
-    B = BigNum::modPow(g, b, p);
-    
-    // Compute shared secret key
-    K = BigNum::modPow(A, b, p);
-
     cout << "Output values:\n";
     cout << "A = " << reverseHex(A.toReversedHex()) << "\n";
     cout << "B = " << reverseHex(B.toReversedHex()) << "\n";
     cout << "K = " << reverseHex(K.toReversedHex()) << "\n\n";
+    return true;
 }
 
 void DiffieHellmanKeyExchange::writeOutput(const string &filename) {
-    ofstream fout(filename);
-    if (!fout) return;
-    
-    fout << reverseHex(A.toReversedHex()) << "\n";
-    fout << reverseHex(B.toReversedHex()) << "\n";
-    fout << reverseHex(K.toReversedHex()) << "\n";
-    
-    fout.close();
+    OutputWriter out;
+    if (!out.open(filename)) return;
+
+    if (binary)
+    {
+        RecordWriter records(out, LAYOUT_DH_KEYS, 1);
+        for (const BigNum *v : {&A, &B, &K})
+            records.write(*v);
+        out.close();
+        return;
+    }
+
+    for (const BigNum *v : {&A, &B, &K})
+    {
+        out.writeHex(*v);
+        out.put('\n');
+    }
+    out.close();
+}
+
+// `count` independent exchanges in this group with fresh keys. The public
+// keys share the base g; the shared secrets A_i^b_i are independent
+// exponentiations with one modulus, so they go through the multi-buffer
+// engine a lane-width at a time (one by one with --constant-time, the engine
+// skipping zero windows).
+bool DiffieHellmanKeyExchange::computeBatch(int count, int bits) {
+    if (bits <= 0)
+    {
+        if (q.isZero())
+        {
+            cerr << "--batch needs --exp-bits or a group with a known order\n";
+            return false;
+        }
+        bits = q.bitLength();
+    }
+
+    // Every key here is g^x with 0 < x < q, which lies in the order-q
+    // subgroup exactly when g does, so one check of g stands for all 2 * count
+    if (!q.isZero() && !isValidPublicKey(g))
+    {
+        cerr << "g is not in the order-q subgroup\n";
+        return false;
+    }
+
+    sessions.assign(count, DhSession());
+    vector<BigNum> privA(count), privB(count), pubA(count), pubB(count), shared(count);
+    for (int i = 0; i < count; i++)
+    {
+        privA[i] = generatePrivateKey(bits);
+        privB[i] = generatePrivateKey(bits);
+    }
+
+    GroupContext group(p, g);
+    if (constantTime)
+    {
+        if (!group.getMont())
+        {
+            cerr << "--constant-time needs an odd p\n";
+            return false;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            pubA[i] = group.powGConstTime(privA[i], bits);
+            pubB[i] = group.powGConstTime(privB[i], bits);
+        }
+    }
+    else
+    {
+        group.powGBatch(pubA.data(), privA.data(), count);
+        group.powGBatch(pubB.data(), privB.data(), count);
+    }
+
+    size_t lanes = 0;
+    if (constantTime)
+        for (int i = 0; i < count; i++)
+            shared[i] = group.getMont()->powConstTime(pubA[i], privB[i], bits);
+    else if (const MontContext *mont = group.getMont())
+    {
+        MultiExp engine(*mont);
+        engine.pow(shared.data(), pubA.data(), privB.data(), count);
+        lanes = engine.lanes();
+    }
+    else
+        for (int i = 0; i < count; i++)
+            shared[i] = BigNum::modPow(pubA[i], privB[i], p);
+
+    for (int i = 0; i < count; i++)
+        sessions[i] = DhSession{privA[i], privB[i], pubA[i], pubB[i], shared[i]};
+
+    cout << "Batch: " << count << " exchanges, " << bits << "-bit private keys";
+    if (constantTime)
+        cout << ", constant time";
+    else if (lanes)
+        cout << ", " << lanes << "-lane " << simdKernelName(simdKernel()) << " multi-buffer";
+    cout << "\n";
+    return true;
+}
+
+// a, b, A, B, K for each exchange in turn: the keys were generated here, so
+// they are part of the result
+void DiffieHellmanKeyExchange::writeBatchOutput(const string &filename) {
+    OutputWriter out;
+    if (!out.open(filename)) return;
+
+    if (binary)
+    {
+        RecordWriter records(out, LAYOUT_DH_SESSION, sessions.size());
+        for (const DhSession &s : sessions)
+            for (const BigNum *v : {&s.a, &s.b, &s.A, &s.B, &s.K})
+                records.write(*v);
+        out.close();
+        return;
+    }
+
+    for (const DhSession &s : sessions)
+        for (const BigNum *v : {&s.a, &s.b, &s.A, &s.B, &s.K})
+        {
+            out.writeHex(*v);
+            out.put('\n');
+        }
+    out.close();
 }
 
 // ========================== MAIN FUNCTION ==========================
@@ -373,23 +650,98 @@ int main(int argc, char *argv[])
 
     if (argc < 3)
     {
-        cerr << "Usage: " << argv[0] << " inputFile outputFile\n";
+        cerr << "Usage: " << argv[0]
+             << " inputFile outputFile [--safe-prime] [--exp-bits N] [--batch N] [--constant-time] [--stats]\n";
         return 1;
     }
 
+    bool safePrime = false;
+    int expBits = 0;
+    int batch = 0;
+    bool constantTime = false;
+    bool stats = false;  // --stats: counters and phase times as JSON on stderr
+    for (int i = 3; i < argc; i++)
+    {
+        string opt = argv[i];
+        if (opt == "--safe-prime")
+            safePrime = true;
+        else if ((opt == "--exp-bits" || opt == "--batch") && i + 1 < argc)
+        {
+            int value = positiveOption(argv[++i]);
+            if (value == 0)
+            {
+                cerr << opt << " needs a positive integer, not " << argv[i] << "\n";
+                return 1;
+            }
+            (opt == "--batch" ? batch : expBits) = value;
+        }
+        else if (opt == "--constant-time")
+            constantTime = true;
+        else if (opt == "--stats")
+            stats = true;
+        else
+        {
+            cerr << "Unknown option: " << opt << "\n";
+            return 1;
+        }
+    }
+
     DiffieHellmanKeyExchange dh;
+    dh.setConstantTime(constantTime);
     
-    if (!dh.readInput(argv[1]))
+    try
     {
-        cerr << "Cannot open input file\n";
+        STATS_PHASE(PARSE);
+        if (!dh.readInput(argv[1]))
+        {
+            cerr << "Cannot open input file\n";
+            return 1;
+        }
+    }
+    catch (const invalid_argument &e)
+    {
+        cerr << e.what() << "\n";
         return 1;
     }
-    
-    // Compute public keys and shared secret
-    dh.computeKeys();
-    
-    // Write output: A, B, K
-    dh.writeOutput(argv[2]);
 
+    if (safePrime && dh.getQ().isZero() && !dh.useSafePrimeGroup())
+    {
+        cerr << "p is not a safe prime\n";
+        return 1;
+    }
+
+    // Many exchanges in one group: keys are always generated
+    if (batch > 0)
+    {
+        {
+            STATS_PHASE(EXPONENTIATE);
+            if (!dh.computeBatch(batch, expBits))
+                return 1;
+        }
+        {
+            STATS_PHASE(FORMAT);
+            dh.writeBatchOutput(argv[2]);
+        }
+    }
+    else
+    {
+        {
+            STATS_PHASE(EXPONENTIATE);
+            // Generate private keys of the requested length (e.g. 2 * security bits)
+            if (expBits > 0)
+                dh.generateKeys(expBits);
+
+            // Compute public keys and shared secret
+            if (!dh.computeKeys())
+                return 1;
+        }
+
+        // Write output: A, B, K
+        STATS_PHASE(FORMAT);
+        dh.writeOutput(argv[2]);
+    }
+
+    if (stats)
+        cerr << statsJson("project2") << "\n";
     return 0;
-}
\ No newline at end of file
+}
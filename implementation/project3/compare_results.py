@@ -126,6 +126,20 @@ def run_exe_with_timeout(exe_path, input_file, output_file, timeout=60):
     except Exception as e:
         return False, "", f"ERROR: {str(e)}"
 
+# Client of a running daemon (../daemon) when BIGNUM_DAEMON names its socket,
+# or the in-process library (../capi/bignum.py) when BIGNUM_LIB names it
+SERVICE = None
+
+def run_with_service(values, output_file):
+    """Decrypt through the daemon or library and write the output file a.exe would"""
+    try:
+        h, m = SERVICE.decrypt(*values)
+        with open(output_file, 'w') as f:
+            f.write(f"{int_to_reversed_hex(h)}\n{int_to_reversed_hex(m)}")
+        return True, "", ""
+    except Exception as e:
+        return False, "", f"ERROR: {str(e)}"
+
 def compare_test(exe_path, test_input, test_num):
     """Compare results for a single test case"""
     print(f"\n{'='*60}")
@@ -191,7 +205,10 @@ def compare_test(exe_path, test_input, test_num):
     print(f"\n💻 Running a.exe...")
     output_file = test_input.replace('.inp', '_temp.out')
     start_time = time.time()
-    success, stdout, stderr = run_exe_with_timeout(exe_path, test_input, output_file, timeout=60)
+    if SERVICE:
+        success, stdout, stderr = run_with_service((p, g, x, c1, c2), output_file)
+    else:
+        success, stdout, stderr = run_exe_with_timeout(exe_path, test_input, output_file, timeout=60)
     exe_time = time.time() - start_time
     
     if not success:
@@ -244,6 +261,7 @@ def compare_test(exe_path, test_input, test_num):
 
 def main():
     import sys
+    global SERVICE
     
     # Get the script directory
     script_dir = Path(__file__).parent
@@ -260,8 +278,18 @@ def main():
 
         test_dir = test_dir_default
     
+    if os.environ.get("BIGNUM_DAEMON"):
+        sys.path.insert(0, str(script_dir.parent / "daemon"))
+        from client import DaemonClient
+        SERVICE = DaemonClient(os.environ["BIGNUM_DAEMON"])
+        print(f"Using daemon at {os.environ['BIGNUM_DAEMON']}")
+    elif os.environ.get("BIGNUM_LIB"):
+        sys.path.insert(0, str(script_dir.parent / "capi"))
+        import bignum
+        SERVICE = bignum
+        print(f"Using library {os.environ['BIGNUM_LIB']}")
     # Check if a.exe exists
-    if not exe_path.exists():
+    elif not exe_path.exists():
         print(f"❌ Error: a.exe not found at {exe_path}")
         print(f"Please compile main.cpp first")
         return
@@ -5,422 +5,571 @@
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "../common/record_format.h"
+#include "../common/operations.h"
+#include "../common/multi_exp.h"
+#include "../common/stats.h"
 using namespace std;
 
-// ========================== CLASS BigNum ==========================
+struct SignatureRecord
+{
+    BigNum p, g, y;
+    BigNum m, r, s;
+};
 
-class BigNum
+class ElgamalVerifier
 {
 private:
-    vector<int> digits;
+    vector<SignatureRecord> records;
+    // Groups and signer tables kept across batches: a group's table is built
+    // once it comes back, and the group map is bounded (Operations::group)
+    Operations ops;
+    bool binary = false; // record file in, record file out
+    ostream *log = &cout;
 
 public:
-    BigNum();
-    BigNum(long long val);
-    BigNum(string hexStr);
-
-    void fromReversedHex(string hexStr);
-    string toReversedHex() const;
-    int cmp(const BigNum &b) const;
-    bool isZero() const;
-    bool isOdd() const;
-    BigNum div2() const;
-
-    BigNum operator+(const BigNum &b) const;
-    BigNum operator-(const BigNum &b) const;
-    BigNum operator*(const BigNum &b) const;
-    BigNum operator%(const BigNum &b) const;
-    BigNum operator/(const BigNum &b) const;
-    static BigNum gcd(const BigNum &a, const BigNum &b);
-    static BigNum modInverse(const BigNum &a, const BigNum &m);
-    static BigNum modPow(const BigNum &base, BigNum exp, const BigNum &mod);
+    ElgamalVerifier(size_t cacheBytes, unsigned threshold) : ops(cacheBytes, threshold) {}
 
-};
+    // Where range failures are reported (stdout by default)
+    void setLog(ostream &out) { log = &out; }
 
-// ========================== BigNum Implementation ==========================
+    // One or more records of six values: p g y m r s, as text or an
+    // elgamal-verify record file
+    bool readInput(const string &input_path)
+    {
+        InputReader in;
+        if (!in.open(input_path))
+        {
+            cerr << "Error: Cannot open input file " << input_path << endl;
+            return false;
+        }
 
-BigNum::BigNum() { digits = {0}; }
+        if (RecordReader::isRecordFile(in.contents()))
+        {
+            try
+            {
+                RecordReader file(in.contents());
+                file.expect(LAYOUT_ELGAMAL_VERIFY);
+                binary = true;
+                records.resize(file.recordCount());
+                for (SignatureRecord &rec : records)
+                    for (BigNum *v : {&rec.p, &rec.g, &rec.y, &rec.m, &rec.r, &rec.s})
+                        file.next(*v);
+            }
+            catch (const invalid_argument &e)
+            {
+                cerr << "Error: " << input_path << ": " << e.what() << endl;
+                return false;
+            }
+            if (records.empty())
+                records.push_back(SignatureRecord());
+            return true;
+        }
 
-BigNum::BigNum(long long val)
-{
-    digits.clear();
-    if (val == 0)
+        string_view p_hex, g_hex, y_hex, m_hex, r_hex, s_hex;
+        while (in.nextToken(p_hex))
+        {
+            if (!(in.nextToken(g_hex) && in.nextToken(y_hex) && in.nextToken(m_hex) && in.nextToken(r_hex) &&
+                  in.nextToken(s_hex)) &&
+                !records.empty())
+            {
+                cerr << "Warning: ignoring incomplete record at the end of " << input_path << endl;
+                break;
+            }
+
+            SignatureRecord rec;
+            try
+            {
+                rec.p = BigNum(p_hex);
+                rec.g = BigNum(g_hex);
+                rec.y = BigNum(y_hex);
+                rec.m = BigNum(m_hex);
+                rec.r = BigNum(r_hex);
+                rec.s = BigNum(s_hex);
+            }
+            catch (const invalid_argument &e)
+            {
+                cerr << "Error: record " << records.size() + 1 << " of " << input_path << ": " << e.what() << endl;
+                return false;
+            }
+            records.push_back(rec);
+            p_hex = g_hex = y_hex = m_hex = r_hex = s_hex = string_view();
+        }
+
+        if (records.empty())
+            records.push_back(SignatureRecord());
+        return true;
+    }
+
+    bool inRange(const SignatureRecord &rec) const
     {
-        digits.push_back(0);
-        return;
+        const BigNum &p = rec.p, &r = rec.r, &s = rec.s;
+        if (r.cmp(BigNum(0)) <= 0 || r.cmp(p) >= 0)
+        {
+            *log << "Invalid r value" << endl;
+            return false;
+        }
+
+        if (s.cmp(BigNum(0)) <= 0 || s.cmp(p - BigNum(1)) >= 0)
+        {
+            *log << "Invalid s value" << endl;
+            return false;
+        }
+        return true;
     }
-    bool negative = val < 0;
-    if (negative)
-        val = -val;
-    while (val > 0)
+
+    // g^m == y^r * r^s mod p, with r^s supplied by the caller
+    bool elgamalVerify(const SignatureRecord &rec, const BigNum &rs)
     {
-        digits.push_back(val % 256);
-        val /= 256;
+        return ops.verifyPowered(rec.p, rec.g, rec.y, rec.m, rec.r, rs);
     }
-    if (negative)
+
+    // A lone signature is latency-bound: Operations::verify runs g^m, y^r
+    // and r^s concurrently and joins them at the comparison
+    bool verifyOne(const SignatureRecord &rec)
     {
-        digits.push_back(0xFF);
-        digits.push_back(0);
+        return ops.verify(rec.p, rec.g, rec.y, rec.m, rec.r, rec.s);
     }
-}
 
-BigNum::BigNum(string hexStr) { fromReversedHex(hexStr); }
+    // r^s differs for every signature, so those exponentiations are batched
+    // per modulus through the multi-buffer engine (lanes of independent jobs)
+    vector<bool> verifyAll()
+    {
+        if (records.size() == 1)
+            return {inRange(records[0]) && verifyOne(records[0])};
 
-void BigNum::fromReversedHex(string hexStr)
-{
-    string s;
-    for (char c : hexStr)
-        if (!isspace((unsigned char)c))
-            s += c;
+        vector<bool> results(records.size(), false), valid(records.size(), false);
+        vector<BigNum> rs(records.size());
+        map<string, vector<size_t>> byModulus;
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            valid[i] = inRange(records[i]);
+            if (valid[i])
+                byModulus[records[i].p.toReversedHex()].push_back(i);
+        }
+
+        for (const auto &entry : byModulus)
+        {
+            const vector<size_t> &idx = entry.second;
+            const SignatureRecord &first = records[idx[0]];
+            const MontContext *mont = ops.group(first.p, first.g).getMont();
+            if (!mont)
+            {
+                for (size_t i : idx)
+                    rs[i] = BigNum::modPow(records[i].r, records[i].s, records[i].p);
+                continue;
+            }
 
-    reverse(s.begin(), s.end());
+            vector<BigNum> bases, exps, out(idx.size());
+            for (size_t i : idx)
+            {
+                bases.push_back(records[i].r);
+                exps.push_back(records[i].s);
+            }
+            MultiExp engine(*mont);
+            engine.pow(out.data(), bases.data(), exps.data(), idx.size());
+            for (size_t k = 0; k < idx.size(); k++)
+                rs[idx[k]] = out[k];
+        }
 
-    if (s.empty())
+        for (size_t i = 0; i < records.size(); i++)
+            if (valid[i])
+                results[i] = elgamalVerify(records[i], rs[i]);
+        return results;
+    }
+
+    // Verdicts for `batch` in place of the records read from the input
+    vector<bool> verifyBatch(vector<SignatureRecord> &batch)
     {
-        digits = {0};
-        return;
+        if (batch.empty())
+            return {};
+        records.swap(batch);
+        vector<bool> results = verifyAll();
+        records.swap(batch);
+        return results;
     }
-    if (s.size() % 2 != 0)
-        s = "0" + s;
 
-    digits.clear();
-    for (int i = static_cast<int>(s.size()) - 2; i >= 0; i -= 2)
+    // One result per line; a single record keeps the bare "1"/"0" output.
+    // A record file gets a verdict record file.
+    bool writeOutput(const string &output_path, const vector<bool> &results)
     {
-        char hi_c = s[i];
-        char lo_c = s[i + 1];
-        int hi = isdigit(static_cast<unsigned char>(hi_c)) ? (hi_c - '0')
-                                                           : (toupper(static_cast<unsigned char>(hi_c)) - 'A' + 10);
-        int lo = isdigit(static_cast<unsigned char>(lo_c)) ? (lo_c - '0')
-                                                           : (toupper(static_cast<unsigned char>(lo_c)) - 'A' + 10);
-        digits.push_back(((hi << 4) | lo) & 0xFF);
+        OutputWriter out;
+        if (!out.open(output_path))
+        {
+            cerr << "Error: Cannot open output file " << output_path << endl;
+            return false;
+        }
+
+        if (binary)
+        {
+            RecordWriter file(out, LAYOUT_VERDICT, results.size());
+            for (bool ok : results)
+                file.write(BigNum(ok ? 1 : 0));
+        }
+        else
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                if (i > 0)
+                    out.put('\n');
+                out.put(results[i] ? '1' : '0');
+            }
+        if (!out.close())
+        {
+            cerr << "Error: Cannot write output file " << output_path << endl;
+            return false;
+        }
+        return true;
     }
-    while (digits.size() > 1 && digits.back() == 0)
-        digits.pop_back();
-}
 
-string BigNum::toReversedHex() const
+    size_t recordCount() const { return records.size(); }
+    const SignerCache &getSignerCache() const { return ops.getSignerCache(); }
+};
+
+// ========================== Streaming ==========================
+
+// Verifies an unbounded stream of text records (stdin or a pipe) on one
+// worker per core, writing one verdict line per record, in order, as soon as
+// its batch is done. At most STREAM_IN_FLIGHT batches per worker are read
+// but not yet written; past that the reader stops reading, so a slow
+// consumer of the output slows the producer instead of growing memory. A
+// malformed record gets verdict 0 and a message on stderr, and the stream
+// goes on.
+class SignatureStream
 {
-    static const char HEX[] = "0123456789ABCDEF";
-    if (digits.empty())
-        return "00";
+private:
+    static const size_t STREAM_BATCH = 256;
+    static const size_t STREAM_IN_FLIGHT = 2;
+    static const size_t MAX_DIGITS = 1 << 16; // per value
 
-    string out;
-    for (int i = static_cast<int>(digits.size()) - 1; i >= 0; --i)
+    struct Batch
+    {
+        uint64_t seq;
+        uint64_t firstRecord; // numbered from 1
+        vector<SignatureRecord> records;
+        vector<bool> wellFormed;
+        vector<bool> results;
+    };
+
+    size_t cacheBytes;
+    unsigned threshold;
+    unsigned workers;
+
+    mutex lock;
+    condition_variable queued, finished, drained;
+    deque<unique_ptr<Batch>> pending;
+    map<uint64_t, unique_ptr<Batch>> done;
+    uint64_t submitted = 0;
+    size_t inFlight = 0;
+    bool closed = false;
+    bool writeFailed = false;
+
+    void submit(unique_ptr<Batch> batch);
+    void work();
+    void write(FILE *file);
+    static void verify(ElgamalVerifier &verifier, Batch &batch);
+
+public:
+    SignatureStream(size_t cacheBytes, unsigned threshold)
+        : cacheBytes(cacheBytes), threshold(threshold), workers(max(1u, thread::hardware_concurrency()))
     {
-        int b = digits[i];
-        out += HEX[(b >> 4) & 0xF];
-        out += HEX[b & 0xF];
     }
-    if (out.empty())
-        return "00";
-    size_t pos = out.find_first_not_of('0');
-    if (pos == string::npos)
-        return "00";
-    return out.substr(pos);
-}
 
-int BigNum::cmp(const BigNum &b) const
+    // False if the stream could not be read or the output written
+    bool run(FILE *in, FILE *out);
+};
+
+// Waits while the output is STREAM_IN_FLIGHT batches per worker behind
+void SignatureStream::submit(unique_ptr<Batch> batch)
 {
-    if (digits.size() != b.digits.size())
-        return digits.size() < b.digits.size() ? -1 : 1;
-    for (int i = digits.size() - 1; i >= 0; i--)
-        if (digits[i] != b.digits[i])
-            return digits[i] < b.digits[i] ? -1 : 1;
-    return 0;
+    unique_lock<mutex> guard(lock);
+    drained.wait(guard, [&] { return inFlight < STREAM_IN_FLIGHT * workers; });
+    batch->seq = submitted++;
+    pending.push_back(move(batch));
+    inFlight++;
+    queued.notify_one();
 }
 
-bool BigNum::isZero() const { return digits.empty() || digits.size() == 1 && digits[0] == 0; }
-bool BigNum::isOdd() const { return digits[0] & 1; }
-
-BigNum BigNum::div2() const
+// The well-formed records of the batch, together; one at a time if that
+// throws, so the record at fault fails alone
+void SignatureStream::verify(ElgamalVerifier &verifier, Batch &batch)
 {
-    BigNum r = *this;
-    int carry = 0;
-    for (int i = r.digits.size() - 1; i >= 0; i--)
+    vector<SignatureRecord> good;
+    vector<size_t> at;
+    for (size_t i = 0; i < batch.records.size(); i++)
+        if (batch.wellFormed[i])
+        {
+            good.push_back(batch.records[i]);
+            at.push_back(i);
+        }
+    batch.results.assign(batch.records.size(), false);
+    try
     {
-        int cur = r.digits[i] + carry * 256;
-        r.digits[i] = cur / 2;
-        carry = cur % 2;
+        vector<bool> results = verifier.verifyBatch(good);
+        for (size_t k = 0; k < at.size(); k++)
+            batch.results[at[k]] = results[k];
+        return;
     }
-    while (r.digits.size() > 1 && r.digits.back() == 0)
-        r.digits.pop_back();
-    return r;
-}
-
-BigNum BigNum::operator+(const BigNum &b) const
-{
-    BigNum r;
-    r.digits.assign(max(digits.size(), b.digits.size()) + 1, 0);
-    int carry = 0;
-    for (size_t i = 0; i < r.digits.size(); i++)
+    catch (const exception &)
     {
-        int sum = carry;
-        if (i < digits.size())
-            sum += digits[i];
-        if (i < b.digits.size())
-            sum += b.digits[i];
-        r.digits[i] = sum % 256;
-        carry = sum / 256;
     }
-    while (r.digits.size() > 1 && r.digits.back() == 0)
-        r.digits.pop_back();
-    return r;
-}
-
-BigNum BigNum::operator-(const BigNum &b) const
-{
-    BigNum r;
-    r.digits.assign(digits.size(), 0);
-    int borrow = 0;
-    for (size_t i = 0; i < digits.size(); i++)
+    for (size_t k = 0; k < at.size(); k++)
     {
-        int diff = digits[i] - (i < b.digits.size() ? b.digits[i] : 0) - borrow;
-        if (diff < 0)
+        vector<SignatureRecord> one = {good[k]};
+        try
         {
-            diff += 256;
-            borrow = 1;
+            batch.results[at[k]] = verifier.verifyBatch(one)[0];
+        }
+        catch (const exception &e)
+        {
+            cerr << "Error: record " << batch.firstRecord + at[k] << ": " << e.what() << endl;
         }
-        else
-            borrow = 0;
-        r.digits[i] = diff;
     }
-    while (r.digits.size() > 1 && r.digits.back() == 0)
-        r.digits.pop_back();
-    return r;
 }
 
-BigNum BigNum::operator*(const BigNum &b) const
+void SignatureStream::work()
 {
-    BigNum r;
-    r.digits.assign(digits.size() + b.digits.size(), 0);
-    for (size_t i = 0; i < digits.size(); i++)
+    ElgamalVerifier verifier(cacheBytes / workers, threshold);
+    verifier.setLog(cerr);
+    for (;;)
     {
-        int carry = 0;
-        for (size_t j = 0; j < b.digits.size() || carry; j++)
+        unique_ptr<Batch> batch;
         {
-            long long cur = r.digits[i + j] +
-                            (long long)digits[i] * (j < b.digits.size() ? b.digits[j] : 0) + carry;
-            r.digits[i + j] = cur % 256;
-            carry = cur / 256;
+            unique_lock<mutex> guard(lock);
+            queued.wait(guard, [&] { return !pending.empty() || closed; });
+            if (pending.empty())
+                return;
+            batch = move(pending.front());
+            pending.pop_front();
         }
+        verify(verifier, *batch);
+        lock_guard<mutex> guard(lock);
+        uint64_t seq = batch->seq;
+        done[seq] = move(batch);
+        finished.notify_all();
     }
-    while (r.digits.size() > 1 && r.digits.back() == 0)
-        r.digits.pop_back();
-    return r;
 }
 
-BigNum BigNum::operator%(const BigNum &m) const
+// Batches in order, each flushed as it is written
+void SignatureStream::write(FILE *file)
 {
-    if (m.isZero())
-        return BigNum(0);
-    if (this->cmp(m) < 0)
-        return *this;
-
-    BigNum dividend = *this;
-    BigNum divisor = m;
-    BigNum current(0);
-
-    for (int i = dividend.digits.size() - 1; i >= 0; i--)
+    OutputWriter out;
+    out.attach(file);
+    for (uint64_t next = 0;; next++)
     {
-        current = current * BigNum(256);
-        current = current + BigNum(dividend.digits[i]);
-        int x = 0, left = 0, right = 255;
-        while (left <= right)
+        unique_ptr<Batch> batch;
         {
-            int mid = (left + right) / 2;
-            BigNum t = divisor * BigNum(mid);
-            if (t.cmp(current) <= 0)
-            {
-                x = mid;
-                left = mid + 1;
-            }
-            else
-                right = mid - 1;
+            unique_lock<mutex> guard(lock);
+            finished.wait(guard, [&] { return done.count(next) || (closed && next == submitted); });
+            if (!done.count(next))
+                break;
+            batch = move(done[next]);
+            done.erase(next);
         }
-        current = current - divisor * BigNum(x);
+        for (bool ok : batch->results)
+            out.write(ok ? "1\n" : "0\n");
+        out.flush();
+        bool failed = fflush(file) != 0;
+        lock_guard<mutex> guard(lock);
+        writeFailed = writeFailed || failed;
+        inFlight--;
+        drained.notify_one();
     }
-    return current;
+    if (!out.close())
+        writeFailed = true;
 }
 
-BigNum BigNum::operator/(const BigNum &b) const
+bool SignatureStream::run(FILE *in, FILE *out)
 {
-    if (b.isZero())
-        throw runtime_error("Division by zero");
-
-    BigNum dividend = *this;
-    BigNum divisor = b;
-    BigNum quotient(0);
-    BigNum current(0);
-
-    for (int i = static_cast<int>(dividend.digits.size()) - 1; i >= 0; i--)
+    vector<thread> pool;
+    for (unsigned i = 0; i < workers; i++)
+        pool.emplace_back([this] { work(); });
+    thread writer([this, out] { write(out); });
+
+    StreamReader reader(in, MAX_DIGITS);
+    unique_ptr<Batch> batch(new Batch());
+    batch->firstRecord = 1;
+    SignatureRecord rec;
+    BigNum *fields[6] = {&rec.p, &rec.g, &rec.y, &rec.m, &rec.r, &rec.s};
+    size_t field = 0;
+    uint64_t recordNo = 0;
+    string error;
+    bool ok = true;
+    string_view token;
+    bool oversized;
+    for (;;)
     {
-        current = current * BigNum(256) + BigNum(dividend.digits[i]);
-        int x = 0, left = 0, right = 255;
-        while (left <= right)
+        // a partial batch goes out whenever the input pauses
+        if (!batch->records.empty() && !reader.ready())
         {
-            int mid = (left + right) / 2;
-            BigNum t = divisor * BigNum(mid);
-            if (t.cmp(current) <= 0)
-            {
-                x = mid;
-                left = mid + 1;
-            }
-            else
-            {
-                right = mid - 1;
-            }
+            submit(move(batch));
+            batch.reset(new Batch());
+            batch->firstRecord = recordNo + 1;
+        }
+        if (!reader.nextToken(token, oversized))
+            break;
+        if (recordNo == 0 && field == 0 && token.substr(0, sizeof(RECORD_MAGIC)) ==
+                                               string_view(RECORD_MAGIC, sizeof(RECORD_MAGIC)))
+        {
+            cerr << "Error: record files are not streamed; pass the file by name" << endl;
+            ok = false;
+            break;
         }
-        quotient.digits.insert(quotient.digits.begin(), x);
-        current = current - divisor * BigNum(x);
-    }
-    while (quotient.digits.size() > 1 && quotient.digits.back() == 0)
-        quotient.digits.pop_back();
-    return quotient;
-}
-
-BigNum BigNum::gcd(const BigNum &a, const BigNum &b)
-{
-    if (b.isZero())
-        return a;
-    return gcd(b, a % b);
-}
-
-BigNum BigNum::modInverse(const BigNum &a, const BigNum &m)
-{
-    if (m.isZero())
-        return BigNum(0);
-
-    BigNum aa = a;
-    BigNum mm = m;
-    BigNum m0 = m;
 
-    if (BigNum::gcd(aa, mm).cmp(BigNum(1)) != 0)
+        size_t bad;
+        if (error.empty() && oversized)
+            error = "value " + to_string(field + 1) + " is longer than " + to_string(MAX_DIGITS) + " digits";
+        else if (error.empty() && !fields[field]->parseReversedHex(token, &bad))
+            error = "invalid character at offset " + to_string(bad) + " of value " + to_string(field + 1);
+        if (++field < 6)
+            continue;
+
+        recordNo++;
+        if (!error.empty())
+            cerr << "Error: record " << recordNo << ": " << error << endl;
+        batch->records.push_back(rec);
+        batch->wellFormed.push_back(error.empty());
+        field = 0;
+        error.clear();
+        if (batch->records.size() == STREAM_BATCH)
+        {
+            submit(move(batch));
+            batch.reset(new Batch());
+            batch->firstRecord = recordNo + 1;
+        }
+    }
+    if (field > 0)
+        cerr << "Warning: ignoring incomplete record at the end of the stream" << endl;
+    if (reader.error())
     {
-        return BigNum(0);
+        cerr << "Error: cannot read the input stream" << endl;
+        ok = false;
     }
+    if (!batch->records.empty())
+        submit(move(batch));
 
-    BigNum x0(1), x1(0);
-
-    while (!mm.isZero())
     {
-        BigNum q = aa / mm;
-
-        BigNum t = mm;
-        mm = aa % mm;
-        aa = t;
-
-        BigNum qx1 = (q * x1) % m0;
-        BigNum newx = (x0 + m0 - qx1) % m0;
-
-        x0 = x1;
-        x1 = newx;
+        lock_guard<mutex> guard(lock);
+        closed = true;
+        queued.notify_all();
+        finished.notify_all();
     }
-
-    BigNum inv = x0 % m0;
-    return inv;
+    for (thread &t : pool)
+        t.join();
+    writer.join();
+    if (writeFailed)
+        cerr << "Error: cannot write the output stream" << endl;
+    return ok && !writeFailed;
 }
 
-BigNum BigNum::modPow(const BigNum &base, BigNum exp, const BigNum &mod)
+// Whole decimal number in [0, max], or -1 for anything else
+long long countOption(const char *text, long long max)
 {
-    BigNum result(1);
-    BigNum b = base % mod;
-    BigNum e = exp;
-
-    while (!e.isZero())
-    {
-        if (e.isOdd())
-            result = (result * b) % mod;
-        b = (b * b) % mod;
-        e = e.div2();
-    }
-    return result;
+    char *end;
+    errno = 0;
+    long long value = strtoll(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || value < 0 || value > max)
+        return -1;
+    return value;
 }
 
-class ElgamalVerifier
+int main(int argc, char *argv[])
 {
-private:
-    BigNum p, g, y;
-    BigNum m, r, s;
-
-public:
-    bool readInput(const string &input_path)
+    if (argc < 3)
     {
-        ifstream inputFile(input_path);
-        if (!inputFile.is_open())
-        {
-            cerr << "Error: Cannot open input file " << input_path << endl;
-            return false;
-        }
-
-        string p_hex, g_hex, y_hex, m_hex, r_hex, s_hex;
-        inputFile >> p_hex >> g_hex >> y_hex >> m_hex >> r_hex >> s_hex;
-        inputFile.close();
-
-        p = BigNum(p_hex);
-        g = BigNum(g_hex);
-        y = BigNum(y_hex);
-        m = BigNum(m_hex);
-        r = BigNum(r_hex);
-        s = BigNum(s_hex);
-
-        return true;
+        cerr << "Usage: " << argv[0]
+             << " <input_file> <output_file> [--stream] [--signer-cache-mb N] [--signer-threshold K] [--stats]" << endl
+             << "With --stream, or input -, records are read as they arrive; - is stdin / stdout" << endl;
+        return 1;
     }
 
-    bool elgamalVerify() const
+    size_t cacheMb = 64;
+    unsigned threshold = 2;
+    bool stats = false;  // --stats: counters and phase times as JSON on stderr
+    bool stream = string(argv[1]) == "-";
+    for (int i = 3; i < argc; i++)
     {
-        if (r.cmp(BigNum(0)) <= 0 || r.cmp(p) >= 0)
+        string opt = argv[i];
+        if (opt == "--stream")
+            stream = true;
+        else if ((opt == "--signer-cache-mb" || opt == "--signer-threshold") && i + 1 < argc)
         {
-            cout << "Invalid r value" << endl;
-            return false;
+            // 0 MB turns the table cache off; a threshold of 0 would mean nothing
+            bool mb = opt == "--signer-cache-mb";
+            long long value = countOption(argv[++i], mb ? (long long)min<size_t>(SIZE_MAX >> 20, LLONG_MAX) : UINT_MAX);
+            if (value < (mb ? 0 : 1))
+            {
+                cerr << opt << " needs a " << (mb ? "non-negative" : "positive") << " integer in range, not " << argv[i]
+                     << endl;
+                return 1;
+            }
+            if (mb)
+                cacheMb = (size_t)value;
+            else
+                threshold = (unsigned)value;
         }
-
-        if (s.cmp(BigNum(0)) <= 0 || s.cmp(p - BigNum(1)) >= 0)
+        else if (opt == "--stats")
+            stats = true;
+        else
         {
-            cout << "Invalid s value" << endl;
-            return false;
+            cerr << "Unknown option: " << opt << endl;
+            return 1;
         }
-
-        BigNum left = BigNum::modPow(g, m, p);
-        BigNum hr   = BigNum::modPow(y, r, p);
-        BigNum rs   = BigNum::modPow(r, s, p);
-        BigNum right = (hr * rs) % p;
-
-        return left.cmp(right) == 0;
     }
 
-    bool writeOutput(const string &output_path, bool result)
+    if (stream)
     {
-        ofstream outputFile(output_path);
-        if (!outputFile.is_open())
+        string inPath = argv[1], outPath = argv[2];
+        FILE *in = inPath == "-" ? stdin : fopen(inPath.c_str(), "rb");
+        FILE *out = outPath == "-" ? stdout : fopen(outPath.c_str(), "wb");
+        if (!in || !out)
         {
-            cerr << "Error: Cannot open output file " << output_path << endl;
-            return false;
+            cerr << "Error: Cannot open " << (in ? "output file " + outPath : "input file " + inPath) << endl;
+            return 1;
         }
-
-        outputFile << (result ? "1" : "0");
-        outputFile.close();
-        return true;
+        bool ok = SignatureStream(cacheMb << 20, threshold).run(in, out);
+        if (out != stdout && fclose(out) != 0)
+            ok = false;
+        if (stats)
+            cerr << statsJson("project4") << endl;
+        return ok ? 0 : 1;
     }
-};
 
-int main(int argc, char *argv[])
-{
-    if (argc != 3)
+    ElgamalVerifier verifier(cacheMb << 20, threshold);
+
     {
-        cerr << "Usage: " << argv[0] << " <input_file> <output_file>" << endl;
-        return 1;
+        STATS_PHASE(PARSE);
+        if (!verifier.readInput(argv[1]))
+            return 1;
     }
 
-    ElgamalVerifier verifier;
-
-    if (!verifier.readInput(argv[1]))
-        return 1;
+    vector<bool> results;
+    {
+        STATS_PHASE(EXPONENTIATE);
+        results = verifier.verifyAll();
+    }
 
-    bool result = verifier.elgamalVerify();
+    {
+        STATS_PHASE(FORMAT);
+        if (!verifier.writeOutput(argv[2], results))
+            return 1;
+    }
 
-    if (!verifier.writeOutput(argv[2], result))
-        return 1;
+    if (verifier.recordCount() > 1)
+    {
+        const SignerCache &cache = verifier.getSignerCache();
+        cout << "Signer cache: " << cache.getHits() << " hits, " << cache.getMisses() << " misses, "
+             << cache.getBuilds() << " tables built, " << cache.getEvictions() << " evicted" << endl;
+    }
 
+    if (stats)
+        cerr << statsJson("project4") << endl;
     return 0;
 }
-
@@ -10,6 +10,11 @@ BITS = 512# Độ lớn (bits).
 EXE_PATH = "./main"     # Đường dẫn file compiled C++ (Windows: "main.exe")
 INPUT_FILE = "input.txt"
 OUTPUT_FILE = "output.txt"
+# Socket of a running daemon (../daemon); when set, tests go to it instead of
+# spawning EXE_PATH for every case
+DAEMON_SOCKET = os.environ.get("BIGNUM_DAEMON")
+# Or the in-process library (../capi/bignum.py), loaded from this path
+BIGNUM_LIB = os.environ.get("BIGNUM_LIB")
 
 if os.name == 'nt' and not EXE_PATH.endswith('.exe'):
     EXE_PATH += ".exe"
@@ -82,6 +87,14 @@ def verify_signature(data):
 # ================= MAIN LOOP =================
 def run_tests():
     passed = 0
+    daemon = None
+    if DAEMON_SOCKET:
+        sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "daemon"))
+        from client import DaemonClient
+        daemon = DaemonClient(DAEMON_SOCKET)
+    elif BIGNUM_LIB:
+        sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "capi"))
+        import bignum as daemon
     print(f"[*] Running {NUM_TESTS} test cases (Logic: REVERSED HEX INPUT)...")
     print("-" * 60)
 
@@ -110,19 +123,27 @@ def run_tests():
             print(f"{to_reversed_hex(data['m'])}")
             print(f"{to_reversed_hex(data['r'])}")
             print(f"{to_reversed_hex(data['s'])}")
-        # Run the C++ program
-        try:
-            subprocess.run([EXE_PATH, INPUT_FILE, OUTPUT_FILE], check=True, capture_output=True)
-        except Exception as e:
-            print(f"[TEST {i}] Error running C++ file: {e}")
-            continue
-
-        # Read the result
-        try:
-            with open(OUTPUT_FILE, "r") as f:
-                result = f.read().strip()
-        except:
-            result = "Error reading output"
+        if daemon:
+            try:
+                ok = daemon.verify(data['p'], data['g'], data['y'], data['m'], data['r'], data['s'])
+                result = "1" if ok else "0"
+            except Exception as e:
+                print(f"[TEST {i}] Error from {'daemon' if DAEMON_SOCKET else 'library'}: {e}")
+                continue
+        else:
+            # Run the C++ program
+            try:
+                subprocess.run([EXE_PATH, INPUT_FILE, OUTPUT_FILE], check=True, capture_output=True)
+            except Exception as e:
+                print(f"[TEST {i}] Error running C++ file: {e}")
+                continue
+
+            # Read the result
+            try:
+                with open(OUTPUT_FILE, "r") as f:
+                    result = f.read().strip()
+            except:
+                result = "Error reading output"
 
         if result == "1":
             print(f"[TEST {i}] PASSED ✅")
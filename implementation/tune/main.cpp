@@ -0,0 +1,350 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <sys/stat.h>
+#include "../common/group_context.h"
+using namespace std;
+
+// Measures the machine-dependent choices of the arithmetic core on this host
+// and writes them as a tuning profile (common/tuning.h), which every tool
+// then reads on first use:
+//   ntt_mul_limbs      schoolbook against NTT products, by operand size
+//   newton_div_digits  long division against Newton reciprocals, by divisor size
+//   ntt_mont_limbs     montMul against NttMont modular products, by modulus size
+//   simd_kernel        which exponentiation kernel (vector or scalar) is
+//                      fastest, by modulus size
+//   pow_window         sliding-window width, by exponent size
+//   comb_window        fixed-base table window, by modulus size
+// Each candidate is timed a few times and the best time kept. A crossover is
+// the smallest size from which the second path wins at every larger size. A
+// window is the narrowest within a few percent of the fastest, and never
+// narrower than the one picked for the size below, so that timing noise does
+// not make the table zigzag (a wider fixed-base window also costs about 1.6x
+// the memory per step, so it must win by more).
+//   g++ -O2 -std=c++17 tune/main.cpp -o tune/tune -lpthread
+//   ./tune/tune [--output PATH | --output -] [--seconds S]
+// The default output is where the tools look (Tuning::profilePath()).
+
+double seconds = 0.05;
+
+// Best of three runs of f, each repeated for about `seconds`; ns per call
+template <class F>
+double timePerCall(F f)
+{
+    using clock = chrono::steady_clock;
+    double best = 0;
+    for (int run = 0; run < 3; run++)
+    {
+        size_t calls = 0, batch = 1;
+        auto start = clock::now();
+        double elapsed = 0;
+        while (elapsed < seconds / 3)
+        {
+            for (size_t i = 0; i < batch; i++)
+                f();
+            calls += batch;
+            batch *= 2;
+            elapsed = chrono::duration<double>(clock::now() - start).count();
+        }
+        double ns = elapsed * 1e9 / calls;
+        best = run == 0 ? ns : min(best, ns);
+    }
+    return best;
+}
+
+mt19937_64 rng(1);
+
+vector<limb_t> randomLimbs(size_t n)
+{
+    vector<limb_t> x(n);
+    for (limb_t &l : x)
+        l = (limb_t)rng();
+    x.back() |= limb_t(1) << 31;
+    return x;
+}
+
+BigNum randomBits(int bits)
+{
+    vector<limb_t> x = randomLimbs((bits + 31) / 32);
+    if (bits % 32)
+    {
+        x.back() &= (limb_t(1) << (bits % 32)) - 1;
+        x.back() |= limb_t(1) << (bits % 32 - 1);
+    }
+    return BigNum::fromLimbs(x.data(), x.size());
+}
+
+BigNum randomOdd(int bits)
+{
+    BigNum m = randomBits(bits);
+    return m.isOdd() ? m : m + BigNum(1);
+}
+
+// Smallest size from which `second` beats `first` at it and every larger
+// size; twice the largest size if it never settles
+size_t crossover(const vector<size_t> &sizes, const vector<double> &first, const vector<double> &second)
+{
+    size_t from = sizes.size();
+    for (size_t i = sizes.size(); i-- > 0 && second[i] < first[i];)
+        from = i;
+    return from < sizes.size() ? sizes[from] : 2 * sizes.back();
+}
+
+// Appends (size, value), merging runs of the same value into their largest size
+template <class T>
+void extend(vector<pair<size_t, T>> &table, size_t size, const T &value)
+{
+    if (!table.empty() && table.back().second == value)
+        table.back().first = size;
+    else
+        table.emplace_back(size, value);
+}
+
+// Narrowest window, from `floor` up, within `slack` of the fastest; times[i]
+// is the time of window first + i
+unsigned pickWindow(const vector<double> &times, unsigned first, unsigned floor, double slack)
+{
+    double fastest = 0;
+    for (size_t i = floor - first; i < times.size(); i++)
+        if (fastest == 0 || times[i] < fastest)
+            fastest = times[i];
+    for (size_t i = floor - first; i < times.size(); i++)
+        if (times[i] <= fastest * (1 + slack))
+            return first + (unsigned)i;
+    return floor;
+}
+
+// ========================== Measurements ==========================
+
+void tuneNttMul(Tuning &t)
+{
+#ifdef NTT_AVAILABLE
+    vector<size_t> sizes = {64, 96, 128, 160, 192, 256, 320, 384, 512, 768};
+    vector<double> plain, ntt;
+    cout << "products (ns): limbs schoolbook ntt\n";
+    for (size_t n : sizes)
+    {
+        vector<limb_t> a = randomLimbs(n), b = randomLimbs(n), out(2 * n);
+        t.nttMulLimbs = SIZE_MAX;
+        plain.push_back(timePerCall([&] { limbsMul(out.data(), a.data(), n, b.data(), n); }));
+        t.nttMulLimbs = 1;
+        ntt.push_back(timePerCall([&] { limbsMul(out.data(), a.data(), n, b.data(), n); }));
+        printf("  %5zu %12.0f %12.0f\n", n, plain.back(), ntt.back());
+    }
+    t.nttMulLimbs = crossover(sizes, plain, ntt);
+#else
+    (void)t;
+#endif
+}
+
+void tuneNewtonDiv(Tuning &t)
+{
+    vector<size_t> sizes = {8, 16, 24, 32, 48, 64, 96, 128, 256};
+    vector<double> longDiv, newton;
+    cout << "divisions (ns): divisor bytes long newton\n";
+    for (size_t digits : sizes)
+    {
+        BigNum m = randomOdd(8 * digits), wide = randomBits(16 * digits), q, r;
+        t.newtonDivDigits = SIZE_MAX;
+        longDiv.push_back(timePerCall([&] { wide.divideInto(q, r, m); }));
+        t.newtonDivDigits = 1;
+        newton.push_back(timePerCall([&] { wide.divideInto(q, r, m); }));
+        printf("  %5zu %12.0f %12.0f\n", digits, longDiv.back(), newton.back());
+    }
+    t.newtonDivDigits = crossover(sizes, longDiv, newton);
+}
+
+void tuneNttMont(Tuning &t)
+{
+#ifdef NTT_AVAILABLE
+    vector<size_t> sizes = {160, 192, 256, 384, 512, 768, 1024};
+    vector<double> plain, ntt;
+    cout << "modular products (ns): limbs montMul nttMont\n";
+    for (size_t n : sizes)
+    {
+        BigNum m = randomOdd(32 * (int)n);
+        vector<limb_t> a(n), b(n), tmp(n + 2);
+        auto time = [&](size_t threshold) {
+            t.nttMontLimbs = threshold;
+            MontContext ctx(m, false);
+            ctx.toMont(randomBits(32 * (int)n - 1), a.data());
+            ctx.toMont(randomBits(32 * (int)n - 1), b.data());
+            return timePerCall([&] { ctx.mul(a.data(), a.data(), b.data(), tmp.data()); });
+        };
+        plain.push_back(time(SIZE_MAX));
+        ntt.push_back(time(1));
+        printf("  %5zu %12.0f %12.0f\n", n, plain.back(), ntt.back());
+    }
+    t.nttMontLimbs = crossover(sizes, plain, ntt);
+#else
+    (void)t;
+#endif
+}
+
+// Kernel per modulus size; "scalar" leaves MontContext's own multiplication
+// (fixed-width, montMul or NttMont) to run the exponentiation
+void tuneKernels(Tuning &t)
+{
+    vector<string> kernels = {"scalar"};
+    if (simdKernel() >= SimdKernel::Avx2)
+        kernels.push_back("avx2");
+    if (simdKernel() >= SimdKernel::Ifma)
+        kernels.push_back("ifma");
+
+    vector<pair<size_t, string>> table;
+    cout << "exponentiations (us): limbs";
+    for (const string &k : kernels)
+        cout << " " << k;
+    cout << "\n";
+    for (size_t n : {8, 12, 16, 24, 32, 48, 64, 96, 128})
+    {
+        BigNum m = randomOdd(32 * (int)n), base = randomBits(32 * (int)n - 1), e = randomBits(32 * (int)n);
+        string best = "scalar";
+        double bestTime = 0;
+        printf("  %5zu", n);
+        for (const string &k : kernels)
+        {
+            t.simdKernels = {{n, k}};
+            MontContext ctx(m);
+            const VecMont *vec = ctx.vector();
+            if (k != "scalar" && (!vec || simdKernelName(vec->getKind()) != k))
+            {
+                printf(" %10s", "-");
+                continue;
+            }
+            double us = timePerCall([&] { ctx.pow(base, e); }) / 1000;
+            printf(" %10.1f", us);
+            if (bestTime == 0 || us < bestTime)
+                best = k, bestTime = us;
+        }
+        printf("\n");
+        extend(table, n, best);
+    }
+    t.simdKernels = table;
+}
+
+void tunePowWindows(Tuning &t)
+{
+    cout << "sliding window (us): exponent bits, w = 1 .. 7\n";
+    Tuning::SizeTable table;
+    for (int bits : {16, 24, 32, 64, 128, 256, 512, 1024, 2048, 4096})
+    {
+        int modBits = min(max(bits, 512), 2048);
+        BigNum m = randomOdd(modBits), base = randomBits(modBits - 1), e = randomBits(bits);
+        MontContext ctx(m);
+        vector<double> times;
+        printf("  %5d", bits);
+        for (unsigned w = 1; w <= 7; w++)
+        {
+            t.powWindows = {{(size_t)bits, w}};
+            times.push_back(timePerCall([&] { ctx.pow(base, e); }) / 1000);
+            printf(" %8.1f", times.back());
+        }
+        printf("\n");
+        extend(table, (size_t)bits, pickWindow(times, 1, table.empty() ? 1 : table.back().second, 0.03));
+    }
+    t.powWindows = table;
+}
+
+void tuneCombWindows(Tuning &t)
+{
+    cout << "fixed-base table (us): modulus bits, w = 2 .. " << Tuning::MAX_COMB_WINDOW << "\n";
+    Tuning::SizeTable table;
+    for (int bits : {512, 1024, 2048, 3072, 4096})
+    {
+        BigNum m = randomOdd(bits), g = randomBits(bits - 1), e = randomBits(bits);
+        MontContext ctx(m);
+        vector<double> times;
+        printf("  %5d", bits);
+        for (unsigned w = 2; w <= Tuning::MAX_COMB_WINDOW; w++)
+        {
+            t.combWindows = {{(size_t)bits, w}};
+            FixedBaseTable fixed;
+            fixed.build(ctx, g, bits);
+            times.push_back(timePerCall([&] { fixed.pow(e); }) / 1000);
+            printf(" %8.1f", times.back());
+        }
+        printf("\n");
+        extend(table, (size_t)bits, pickWindow(times, 2, table.empty() ? 2 : table.back().second, 0.05));
+    }
+    t.combWindows = table;
+}
+
+string cpuName()
+{
+    string name = "unknown CPU";
+    if (FILE *f = fopen("/proc/cpuinfo", "r"))
+    {
+        char line[256];
+        while (fgets(line, sizeof(line), f))
+        {
+            string s = line;
+            if (s.compare(0, 10, "model name") == 0 && s.find(':') != string::npos)
+            {
+                name = s.substr(s.find(':') + 2);
+                name.erase(name.find_last_not_of("\n ") + 1);
+                break;
+            }
+        }
+        fclose(f);
+    }
+    return name;
+}
+
+// ========================== MAIN FUNCTION ==========================
+
+int main(int argc, char *argv[])
+{
+    string output = Tuning::profilePath();
+    for (int i = 1; i < argc; i++)
+    {
+        string opt = argv[i];
+        if (opt == "--output" && i + 1 < argc)
+            output = argv[++i];
+        else if (opt == "--seconds" && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--output PATH | --output -] [--seconds S]\n";
+            return 1;
+        }
+    }
+    if (output.empty())
+    {
+        cerr << "No profile path: set BIGNUM_TUNING, BIGNUM_CACHE_DIR or HOME, or pass --output\n";
+        return 1;
+    }
+
+    // measure from the defaults, not from an earlier profile, and keep each
+    // result for the measurements after it (division uses products, the
+    // window searches use the chosen kernels)
+    Tuning &t = Tuning::current();
+    t = Tuning();
+    tuneNttMul(t);
+    tuneNewtonDiv(t);
+    tuneNttMont(t);
+    tuneKernels(t);
+    tunePowWindows(t);
+    tuneCombWindows(t);
+
+    string comment = "tune on " + cpuName() + ", best vector kernel " + simdKernelName(simdKernel());
+    if (output == "-")
+    {
+        cout << t.format(comment);
+        return 0;
+    }
+    string dir = output.substr(0, output.rfind('/'));
+    if (output.find('/') != string::npos && !dir.empty())
+        mkdir(dir.c_str(), 0755);
+    if (!t.save(output, comment))
+    {
+        cerr << "Cannot write " << output << "\n";
+        return 1;
+    }
+    cout << "Profile written to " << output << "\n";
+    return 0;
+}